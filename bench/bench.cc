@@ -0,0 +1,607 @@
+// Scene-scaling benchmark: runs the demo scenes at increasing sizes and reports
+// the per-phase timings of World::step as JSON.
+// In regression mode, compares the timings against a stored baseline instead.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <string>
+#include <vector>
+#include "profiler.h"
+#include "scenes.h"
+#include "settings.h"
+#include "utils.h"
+#include "world.h"
+#include "config.h"
+
+namespace {
+    struct Workload {
+        std::string name;
+        std::string parameter;          // Meaning of the size of the workload
+        std::vector<unsigned> sizes;    // Scaling curve
+        std::vector<unsigned> regression_sizes;
+        std::function<void(World&, Settings&, unsigned)> build;
+    };
+
+    struct Options {
+        std::vector<std::string> workloads;
+        std::vector<unsigned> sizes;
+        unsigned frames = 60;
+        unsigned warmup = 10;
+        double dt = 1.0 / 60.0;
+        int substeps = 20;
+        double max_seconds = 30;
+        unsigned seed = 0;
+        BroadPhaseType broad_phase = BROAD_PHASE_SAP;
+        std::string output;
+
+        // Regression mode
+        std::string baseline;           // Baseline to compare against
+        std::string save_baseline;      // Baseline to write
+        unsigned repeats = 5;
+        double threshold = 0.15;        // Relative slowdown tolerated
+        double min_us = 5;              // Phases faster than this are not gated
+    };
+
+    // Profiler zones of World::step reported by the benchmark, inclusive of their children.
+    // The narrow phase is split into the collision kernels of the shape pairs (see
+    // get_collide_kernel).
+    const std::vector<std::string> phase_names({
+        "step", "broad_phase", "forces", "integration", "collisions", "narrow_phase",
+        "circle_circle", "circle_polygon", "polygon_circle", "polygon_polygon", "response", "walls"
+    });
+
+    // Per-step average of each phase, in microseconds
+    typedef std::vector<double> PhaseTimes;
+
+    void accumulate(PhaseTimes& phases) {
+        for (size_t i(0); i < phases.size(); ++i) {
+            phases[i] += profiler().get_last(phase_names[i]);
+        }
+    }
+
+    struct Run {
+        unsigned size = 0;
+        unsigned bodies = 0;
+        unsigned frames = 0;
+        double total_ms = 0;
+        double step_mean_us = 0;
+        double step_p50_us = 0;
+        double step_p99_us = 0;
+        PhaseTimes phases = PhaseTimes(phase_names.size(), 0);
+    };
+
+    // Robust summary of repeated measurements of a phase
+    struct Estimate {
+        double median = 0;
+        double mad = 0;     // Median absolute deviation
+    };
+
+    // Key of a baseline entry: workload, size and phase
+    typedef std::tuple<std::string, unsigned, std::string> BaselineKey;
+    typedef std::map<BaselineKey, Estimate> Baseline;
+
+    std::vector<Workload> make_workloads() {
+        return {
+            {"collision", "balls", {400, 1600, 6400, 25600, 102400}, {100, 400},
+                [](World& world, Settings& settings, unsigned n) { demo_collision(world, settings, n); }},
+            {"stacking", "rows (9 columns)", {5, 15, 30, 60}, {5},
+                [](World& world, Settings& settings, unsigned n) { demo_stacking(world, settings, 9, n); }},
+            {"stacking_wide", "columns (15 rows)", {9, 27, 81}, {},
+                [](World& world, Settings& settings, unsigned n) { demo_stacking(world, settings, n, 15); }},
+            {"rigidbody", "none", {1}, {1},
+                [](World& world, Settings& settings, unsigned) { demo_rigidbody(world, settings); }},
+            {"spring_chains", "chains (10 links)", {10, 40, 160}, {10},
+                [](World& world, Settings& settings, unsigned n) { demo_spring_chains(world, settings, n, 10); }},
+            {"mixed_sizes", "bodies", {400, 1600, 6400, 25600}, {},
+                [](World& world, Settings& settings, unsigned n) { demo_mixed_sizes(world, settings, n); }},
+        };
+    }
+
+    std::vector<unsigned> parse_list(const std::string& list) {
+        std::vector<unsigned> values;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            values.push_back(std::strtoul(item.c_str(), nullptr, 10));
+        }
+        return values;
+    }
+
+    Estimate estimate(std::vector<double> samples) {
+        Estimate result;
+        if (samples.empty()) {
+            return result;
+        }
+
+        auto median = [](std::vector<double>& v) {
+            std::sort(v.begin(), v.end());
+            const size_t n(v.size());
+            return n % 2 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+        };
+
+        result.median = median(samples);
+        for (auto& sample : samples) {
+            sample = std::abs(sample - result.median);
+        }
+        result.mad = median(samples);
+        return result;
+    }
+
+    void print_usage(const char* program) {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "  --workload <name>      Workload to run, can be repeated (default: all)\n"
+                  << "  --sizes <a,b,...>      Override the sizes of the scaling curve\n"
+                  << "  --frames <n>           Measured frames per run (default: 60)\n"
+                  << "  --warmup <n>           Unmeasured frames before measuring (default: 10)\n"
+                  << "  --dt <seconds>         Time step of a frame (default: 1/60)\n"
+                  << "  --substeps <n>         Substeps per frame (default: 20)\n"
+                  << "  --max-seconds <s>      Stop a scaling curve once a run exceeds this time (default: 30)\n"
+                  << "  --seed <n>             Seed of the scene random generator (default: 0)\n"
+                  << "  --broad-phase <name>   Broad phase: sap (default), tree, incremental_sap,\n"
+                  << "                         spatial_hash, hierarchical_grid or auto\n"
+                  << "  --output <path>        Write the JSON report to a file instead of stdout\n"
+                  << "  --list                 List the workloads\n"
+                  << "Regression mode (runs the regression sizes of each workload):\n"
+                  << "  --save-baseline <path> Measure and write a baseline\n"
+                  << "  --baseline <path>      Measure and compare against a baseline, fails on regression\n"
+                  << "  --repeats <n>          Measurements per run, summarized by median/MAD (default: 5)\n"
+                  << "  --threshold <ratio>    Tolerated slowdown of a phase median (default: 0.15)\n"
+                  << "  --min-us <us>          Phases faster than this are not gated (default: 5)\n";
+    }
+
+    int parse_options(int argc, char* argv[], Options& options, const std::vector<Workload>& workloads) {
+        for (int i(1); i < argc; ++i) {
+            const std::string arg(argv[i]);
+            const bool has_value(i + 1 < argc);
+
+            if (arg == "--help" || arg == "-h") {
+                print_usage(argv[0]);
+                return -1;
+            }else if (arg == "--list") {
+                for (const auto& workload : workloads) {
+                    std::cout << workload.name << " (" << workload.parameter << ")\n";
+                }
+                return -1;
+            }else if (arg == "--workload" && has_value) {
+                options.workloads.push_back(argv[++i]);
+            }else if (arg == "--sizes" && has_value) {
+                options.sizes = parse_list(argv[++i]);
+            }else if (arg == "--frames" && has_value) {
+                options.frames = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--warmup" && has_value) {
+                options.warmup = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--dt" && has_value) {
+                options.dt = std::strtod(argv[++i], nullptr);
+            }else if (arg == "--substeps" && has_value) {
+                options.substeps = std::atoi(argv[++i]);
+            }else if (arg == "--max-seconds" && has_value) {
+                options.max_seconds = std::strtod(argv[++i], nullptr);
+            }else if (arg == "--seed" && has_value) {
+                options.seed = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--broad-phase" && has_value) {
+                const std::string name(argv[++i]);
+                unsigned type(0);
+                while (type < BROAD_PHASE_COUNT && name != broad_phase_names[type]) {
+                    ++type;
+                }
+                if (type == BROAD_PHASE_COUNT) {
+                    std::cerr << "Unknown broad phase: " << name << "\n";
+                    return 1;
+                }
+                options.broad_phase = static_cast<BroadPhaseType>(type);
+            }else if (arg == "--output" && has_value) {
+                options.output = argv[++i];
+            }else if (arg == "--baseline" && has_value) {
+                options.baseline = argv[++i];
+            }else if (arg == "--save-baseline" && has_value) {
+                options.save_baseline = argv[++i];
+            }else if (arg == "--repeats" && has_value) {
+                options.repeats = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--threshold" && has_value) {
+                options.threshold = std::strtod(argv[++i], nullptr);
+            }else if (arg == "--min-us" && has_value) {
+                options.min_us = std::strtod(argv[++i], nullptr);
+            }else {
+                std::cerr << "Unknown or incomplete option: " << arg << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        for (const auto& name : options.workloads) {
+            const bool found(std::any_of(workloads.begin(), workloads.end(),
+                        [&](const Workload& w) { return w.name == name; }));
+            if (!found) {
+                std::cerr << "Unknown workload: " << name << " (see --list)\n";
+                return 1;
+            }
+        }
+
+        if (options.frames == 0 || options.dt <= 0 || options.dt > max_time_step
+         || options.substeps < (int)min_substeps || options.substeps > (int)max_substeps) {
+            std::cerr << "Invalid simulation parameters: frames > 0, 0 < dt <= " << max_time_step
+                      << ", " << min_substeps << " <= substeps <= " << max_substeps << "\n";
+            return 1;
+        }
+
+        if (options.repeats == 0 || options.threshold < 0) {
+            std::cerr << "Invalid regression parameters: repeats > 0, threshold >= 0\n";
+            return 1;
+        }
+
+        return 0;
+    }
+
+    bool selected(const Workload& workload, const Options& options) {
+        return options.workloads.empty() || std::find(options.workloads.begin(),
+                options.workloads.end(), workload.name) != options.workloads.end();
+    }
+
+    Run run_workload(const Workload& workload, const unsigned size, const Options& options) {
+        srand(options.seed);
+
+        World world;
+        Settings settings;
+        workload.build(world, settings, size);
+        world.set_gravity(g * settings.enable_gravity);
+        world.set_broad_phase(options.broad_phase);
+
+        for (unsigned i(0); i < options.warmup; ++i) {
+            world.step(options.dt, options.substeps, settings);
+        }
+        profiler().reset();
+
+        Run run;
+        run.size = size;
+        run.bodies = world.get_body_count();
+        run.frames = options.frames;
+
+        std::vector<double> step_times;
+        step_times.reserve(options.frames);
+
+        Timer total_timer;
+        for (unsigned i(0); i < options.frames; ++i) {
+            world.step(options.dt, options.substeps, settings);
+            step_times.push_back(profiler().get_last("step"));
+            accumulate(run.phases);
+        }
+        run.total_ms = total_timer.get_milliseconds();
+
+        // Per-step averages
+        const size_t n(step_times.size());
+        for (auto& phase : run.phases) {
+            phase /= n;
+        }
+
+        std::sort(step_times.begin(), step_times.end());
+        run.step_mean_us = run.phases[0];
+        run.step_p50_us = step_times[n / 2];
+        run.step_p99_us = step_times[std::min(n - 1, (size_t)(0.99 * n))];
+
+        return run;
+    }
+
+    void write_run(std::ostream& out, const Run& run) {
+        const double ns_per_body_step(run.bodies ? run.step_mean_us * 1e3 / run.bodies : 0);
+        out << "        {\"size\": " << run.size
+            << ", \"bodies\": " << run.bodies
+            << ", \"frames\": " << run.frames
+            << ", \"total_ms\": " << run.total_ms
+            << ", \"ns_per_body_step\": " << ns_per_body_step
+            << ",\n         \"step_us\": {\"mean\": " << run.step_mean_us
+            << ", \"p50\": " << run.step_p50_us
+            << ", \"p99\": " << run.step_p99_us << "}"
+            << ",\n         \"phases_us\": {";
+        for (size_t i(1); i < phase_names.size(); ++i) {
+            out << (i > 1 ? ", " : "") << "\"" << phase_names[i] << "\": " << run.phases[i];
+        }
+        out << "}}";
+    }
+
+    int run_scaling(const std::vector<Workload>& workloads, const Options& options) {
+        std::ofstream file;
+        if (!options.output.empty()) {
+            file.open(options.output);
+            if (!file) {
+                std::cerr << "Could not open " << options.output << "\n";
+                return 1;
+            }
+        }
+        std::ostream& out(options.output.empty() ? std::cout : file);
+
+        out << "{\n  \"benchmark\": \"physics2d_bench\",\n"
+            << "  \"frames\": " << options.frames << ", \"warmup\": " << options.warmup
+            << ", \"dt\": " << options.dt << ", \"substeps\": " << options.substeps
+            << ", \"seed\": " << options.seed
+            << ", \"broad_phase\": \"" << broad_phase_names[options.broad_phase] << "\",\n"
+            << "  \"workloads\": [";
+
+        bool first_workload(true);
+        for (const auto& workload : workloads) {
+            if (!selected(workload, options)) {
+                continue;
+            }
+
+            out << (first_workload ? "\n" : ",\n")
+                << "    {\"name\": \"" << workload.name << "\", \"parameter\": \"" << workload.parameter
+                << "\", \"runs\": [";
+            first_workload = false;
+
+            const std::vector<unsigned>& sizes(options.sizes.empty() ? workload.sizes : options.sizes);
+            bool first_run(true);
+            for (unsigned size : sizes) {
+                std::cerr << workload.name << " " << size << "..." << std::flush;
+                const Run run(run_workload(workload, size, options));
+                std::cerr << " " << run.step_mean_us << " us/step\n";
+
+                out << (first_run ? "\n" : ",\n");
+                write_run(out, run);
+                first_run = false;
+
+                if (run.total_ms * 1e-3 > options.max_seconds) {
+                    std::cerr << workload.name << ": stopping the scaling curve, last run took more than "
+                              << options.max_seconds << " s\n";
+                    break;
+                }
+            }
+            out << "\n    ]}";
+        }
+        out << "\n  ]\n}\n";
+
+        return 0;
+    }
+
+    /**
+     * @brief Measures every phase of the regression runs several times. The repetitions are
+     * interleaved across runs so that slow drifts of the machine (frequency, other loads) spread
+     * over all the runs instead of biasing one of them.
+     * @return The median and MAD of each phase, per workload and size
+     */
+    Baseline measure_baseline(const std::vector<Workload>& workloads, const Options& options) {
+        std::vector<std::pair<const Workload*, unsigned>> runs;
+        for (const auto& workload : workloads) {
+            if (!selected(workload, options)) {
+                continue;
+            }
+            const std::vector<unsigned>& sizes(options.sizes.empty() ? workload.regression_sizes : options.sizes);
+            for (unsigned size : sizes) {
+                runs.push_back({&workload, size});
+            }
+        }
+
+        std::vector<std::vector<PhaseTimes>> samples(runs.size());
+        for (unsigned r(0); r < options.repeats; ++r) {
+            std::cerr << "Pass " << r + 1 << "/" << options.repeats << "\n";
+            for (size_t i(0); i < runs.size(); ++i) {
+                samples[i].push_back(run_workload(*runs[i].first, runs[i].second, options).phases);
+            }
+        }
+
+        Baseline result;
+        for (size_t i(0); i < runs.size(); ++i) {
+            for (size_t j(0); j < phase_names.size(); ++j) {
+                std::vector<double> phase_samples;
+                for (const auto& sample : samples[i]) {
+                    phase_samples.push_back(sample[j]);
+                }
+                result[BaselineKey(runs[i].first->name, runs[i].second, phase_names[j])] = estimate(phase_samples);
+            }
+        }
+        return result;
+    }
+
+    bool save_baseline(const std::string& path, const Baseline& baseline, const Options& options) {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Could not open " << path << "\n";
+            return false;
+        }
+
+        out << "{\n  \"benchmark\": \"physics2d_bench\",\n"
+            << "  \"frames\": " << options.frames << ", \"warmup\": " << options.warmup
+            << ", \"dt\": " << options.dt << ", \"substeps\": " << options.substeps
+            << ", \"seed\": " << options.seed << ", \"repeats\": " << options.repeats << ",\n"
+            << "  \"entries\": [";
+
+        bool first(true);
+        for (const auto& entry : baseline) {
+            out << (first ? "\n" : ",\n")
+                << "    {\"workload\": \"" << std::get<0>(entry.first) << "\""
+                << ", \"size\": " << std::get<1>(entry.first)
+                << ", \"phase\": \"" << std::get<2>(entry.first) << "\""
+                << ", \"median_us\": " << entry.second.median
+                << ", \"mad_us\": " << entry.second.mad << "}";
+            first = false;
+        }
+        out << "\n  ]\n}\n";
+
+        return true;
+    }
+
+    /**
+     * @brief Reads the entries of a baseline written by save_baseline. Only handles flat objects
+     * made of string and number values inside the "entries" array.
+     */
+    bool load_baseline(const std::string& path, Baseline& baseline, const Options& options) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Could not open " << path << "\n";
+            return false;
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        const std::string text(buffer.str());
+
+        size_t pos(text.find("\"entries\""));
+        if (pos == std::string::npos) {
+            std::cerr << path << ": no \"entries\" array\n";
+            return false;
+        }
+
+        // Timings are only comparable for the same simulation parameters
+        auto header_value = [&](const std::string& key) {
+            const size_t key_pos(text.find("\"" + key + "\":"));
+            return key_pos < pos ? std::strtod(text.c_str() + key_pos + key.size() + 3, nullptr) : -1;
+        };
+        if (header_value("frames") != options.frames || header_value("substeps") != options.substeps
+         || std::abs(header_value("dt") - options.dt) > 1e-6) {
+            std::cerr << "Warning: " << path << " was measured with different frames/dt/substeps\n";
+        }
+
+        while ((pos = text.find('{', pos)) != std::string::npos) {
+            const size_t end(text.find('}', pos));
+            if (end == std::string::npos) {
+                std::cerr << path << ": unterminated entry\n";
+                return false;
+            }
+
+            // "key": value pairs
+            std::map<std::string, std::string> fields;
+            size_t cursor(pos + 1);
+            while (true) {
+                const size_t key_begin(text.find('"', cursor));
+                if (key_begin == std::string::npos || key_begin > end) {
+                    break;
+                }
+                const size_t key_end(text.find('"', key_begin + 1));
+                const size_t colon(text.find(':', key_end));
+                size_t value_begin(text.find_first_not_of(" \t\r\n", colon + 1));
+                size_t value_end;
+                if (text[value_begin] == '"') {
+                    ++value_begin;
+                    value_end = text.find('"', value_begin);
+                    cursor = value_end + 1;
+                }else {
+                    value_end = text.find_first_of(",}", value_begin);
+                    cursor = value_end;
+                }
+                fields[text.substr(key_begin + 1, key_end - key_begin - 1)] =
+                    text.substr(value_begin, value_end - value_begin);
+            }
+
+            if (!fields.count("workload") || !fields.count("size") || !fields.count("phase")
+             || !fields.count("median_us") || !fields.count("mad_us")) {
+                std::cerr << path << ": incomplete entry at offset " << pos << "\n";
+                return false;
+            }
+
+            Estimate e;
+            e.median = std::strtod(fields["median_us"].c_str(), nullptr);
+            e.mad = std::strtod(fields["mad_us"].c_str(), nullptr);
+            baseline[BaselineKey(fields["workload"], std::strtoul(fields["size"].c_str(), nullptr, 10),
+                                 fields["phase"])] = e;
+            pos = end + 1;
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Compares the current measurements to the baseline. A phase regresses when its median
+     * is slower than the baseline median by more than the threshold, and by more than the noise
+     * of both measurements (3 scaled MADs). A phase of the baseline that the run did not
+     * measure, or no longer entered, fails as well: the gate would not see it regress.
+     * @return The number of regressed or missing phases
+     */
+    unsigned compare_baseline(const Baseline& baseline, const Baseline& current, const Options& options) {
+        // Scales the MAD to the standard deviation of a normal distribution
+        constexpr double mad_to_sigma(1.4826);
+        constexpr double noise_sigmas(3);
+
+        unsigned regressions(0);
+        std::cout << "workload\tsize\tphase\tbaseline us\tcurrent us\tchange\n";
+        for (const auto& entry : baseline) {
+            // Only the workloads and sizes of this run
+            const BaselineKey run(std::get<0>(entry.first), std::get<1>(entry.first), phase_names[0]);
+            if (!current.count(run) || entry.second.median < options.min_us) {
+                continue;
+            }
+            const auto measured(current.find(entry.first));
+            if (measured == current.end() || measured->second.median == 0) {
+                std::cout << std::get<0>(entry.first) << "\t" << std::get<1>(entry.first) << "\t"
+                          << std::get<2>(entry.first) << "\t" << truncate_to_string(entry.second.median)
+                          << "\t-\t" << (measured == current.end() ? "MISSING from the run" : "MISSING, never entered")
+                          << "\n";
+                ++regressions;
+            }
+        }
+
+        for (const auto& entry : current) {
+            const auto reference(baseline.find(entry.first));
+            if (reference == baseline.end()) {
+                std::cout << std::get<0>(entry.first) << "\t" << std::get<1>(entry.first) << "\t"
+                          << std::get<2>(entry.first) << "\t-\t" << truncate_to_string(entry.second.median)
+                          << "\tnot in baseline\n";
+                continue;
+            }
+
+            const Estimate& base(reference->second);
+            const Estimate& now(entry.second);
+            if (std::max(base.median, now.median) < options.min_us) {
+                continue;
+            }
+
+            const double change(base.median > 0 ? now.median / base.median - 1 : 0);
+            const double noise(noise_sigmas * mad_to_sigma * std::max(base.mad, now.mad));
+            const bool regressed(change > options.threshold && now.median - base.median > noise);
+            regressions += regressed;
+
+            std::cout << std::get<0>(entry.first) << "\t" << std::get<1>(entry.first) << "\t"
+                      << std::get<2>(entry.first) << "\t" << truncate_to_string(base.median)
+                      << "\t" << truncate_to_string(now.median) << "\t"
+                      << (change >= 0 ? "+" : "") << truncate_to_string(change * 100, 10) << "%"
+                      << (regressed ? "\tREGRESSION" : "") << "\n";
+        }
+
+        return regressions;
+    }
+
+    int run_regression(const std::vector<Workload>& workloads, const Options& options) {
+        Baseline baseline;
+        if (!options.baseline.empty() && !load_baseline(options.baseline, baseline, options)) {
+            return 1;
+        }
+
+        const Baseline current(measure_baseline(workloads, options));
+
+        if (!options.save_baseline.empty() && !save_baseline(options.save_baseline, current, options)) {
+            return 1;
+        }
+
+        if (options.baseline.empty()) {
+            return 0;
+        }
+
+        const unsigned regressions(compare_baseline(baseline, current, options));
+        if (regressions) {
+            std::cout << regressions << " phase(s) missing or regressed by more than "
+                      << truncate_to_string(options.threshold * 100, 10) << "%\n";
+            return 2;
+        }
+        std::cout << "No regression\n";
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::vector<Workload> workloads(make_workloads());
+
+    Options options;
+    const int status(parse_options(argc, argv, options, workloads));
+    if (status != 0) {
+        return status < 0 ? 0 : status;
+    }
+
+    if (!options.baseline.empty() || !options.save_baseline.empty()) {
+        return run_regression(workloads, options);
+    }
+
+    return run_scaling(workloads, options);
+}
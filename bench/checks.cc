@@ -0,0 +1,620 @@
+// Correctness checks, run by ctest: each one compares a fast path of the engine against a
+// slower reference on random shapes or on the demo scenes, and fails on any disagreement
+// beyond the tolerances below.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include "broad_phase.h"
+#include "dynamic_tree.h"
+#include "hierarchical_grid.h"
+#include "incremental_sap.h"
+#include "narrow_phase.h"
+#include "rigid_body.h"
+#include "scenes.h"
+#include "settings.h"
+#include "shape.h"
+#include "spatial_hash.h"
+#include "world.h"
+#include "config.h"
+
+namespace {
+    // Depth agreement between two ways of computing the same penetration
+    constexpr double depth_tolerance(1e-4);
+    // Exact computations (closed forms against the distance to the edges, the same query on
+    // the bodies found by the broad phase and on all the bodies)
+    constexpr double exact_tolerance(1e-9);
+    // Pairs closer than this to touching may be reported either way
+    constexpr double contact_tolerance(1e-6);
+    // Extra translation that separates two shapes once pushed by the penetration depth
+    constexpr double separation_slop(1e-7);
+
+    struct Options {
+        std::vector<std::string> checks;
+        unsigned pairs = 200000;    // Random pairs of the narrow phase checks
+        unsigned frames = 120;      // Frames of the scene checks
+        unsigned seed = 0;
+    };
+
+    struct Check {
+        std::string name;
+        std::string description;
+        std::function<unsigned(const Options&)> run;     // Returns the number of failures
+    };
+
+    /**
+     * @brief Creates a random convex polygon of 3 to 8 vertices, centered on its centroid
+     */
+    Polygon random_polygon(std::mt19937& rng, const double min_radius, const double max_radius) {
+        std::uniform_int_distribution<int> count_dist(3, shape_max_vertices);
+        std::uniform_real_distribution<double> radius_dist(min_radius, max_radius);
+        std::uniform_real_distribution<double> jitter_dist(-0.15, 0.15);
+
+        // Points around a circle, at jittered angles so that none is collinear
+        const int count(count_dist(rng));
+        const double radius(radius_dist(rng));
+        std::vector<Vector2> points;
+        for (int i(0); i < count; ++i) {
+            const double angle((i + jitter_dist(rng)) * 2 * PI / count);
+            points.push_back(Vector2(std::cos(angle), std::sin(angle)) * radius);
+        }
+
+        Polygon polygon(compute_hull(points));
+        polygon.compute_mass_properties(1);
+        return polygon;
+    }
+
+    double segment_distance(const Vector2 p, const Vector2 a, const Vector2 b) {
+        const Vector2 ab(b - a);
+        const double t(std::max(0.0, std::min(1.0, dot2(p - a, ab) / dot2(ab, ab))));
+        return (p - (a + ab * t)).norm();
+    }
+
+    unsigned report(const std::string& name, const unsigned cases, const unsigned failures, const std::string& details) {
+        std::cout << name << ": " << cases << " cases, " << failures << " failures (" << details << ")\n";
+        return failures;
+    }
+
+    /**
+     * @brief The SAT kernel of polygon pairs against GJK and EPA: same hits, same depth,
+     * and pushing the pair apart by the depth along the normal separates it
+     */
+    unsigned check_sat(const Options& options) {
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<double> unit(0, 1);
+
+        unsigned hits(0), hit_mismatch(0), depth_mismatch(0), not_separated(0);
+        double max_depth_error(0);
+        for (unsigned k(0); k < options.pairs; ++k) {
+            Polygon a(random_polygon(rng, 0.2, 1.2));
+            Polygon b(random_polygon(rng, 0.2, 1.2));
+            a.transform(Vector2(unit(rng), unit(rng)), 6 * unit(rng));
+            b.transform(Vector2(3 * unit(rng) - 1, 3 * unit(rng) - 1), 6 * unit(rng));
+
+            const Manifold sat(collide_polygon_polygon(&a, &b));
+            const Manifold epa(collide_convex(&a, &b));
+            if (sat.intersecting != epa.intersecting) {
+                hit_mismatch += (sat.intersecting ? sat.depth : epa.depth) > contact_tolerance;
+                continue;
+            }
+            if (!sat.intersecting) {
+                continue;
+            }
+
+            ++hits;
+            const double error(std::abs(sat.depth - epa.depth));
+            max_depth_error = std::max(max_depth_error, error);
+            depth_mismatch += error > depth_tolerance;
+
+            b.translate(sat.normal * (sat.depth + separation_slop));
+            not_separated += collide_polygon_polygon(&a, &b).intersecting;
+        }
+
+        return report("sat", options.pairs, hit_mismatch + depth_mismatch + not_separated,
+                      std::to_string(hits) + " hits, " + std::to_string(hit_mismatch) + " hit mismatches, "
+                      + std::to_string(depth_mismatch) + " depth mismatches (max error "
+                      + std::to_string(max_depth_error) + "), " + std::to_string(not_separated) + " not separated");
+    }
+
+    /**
+     * @brief The circle/polygon kernel against the exact distance from the center to the edges,
+     * in both argument orders
+     */
+    unsigned check_circle_polygon(const Options& options) {
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<double> unit(0, 1);
+
+        unsigned hits(0), hit_mismatch(0), depth_mismatch(0), not_separated(0), asymmetric(0);
+        double max_depth_error(0);
+        for (unsigned k(0); k < options.pairs; ++k) {
+            Polygon polygon(random_polygon(rng, 0.5, 1.5));
+            Circle circle(0.05 + unit(rng));
+            circle.compute_mass_properties(1);
+            polygon.transform(Vector2(unit(rng), unit(rng)), 6 * unit(rng));
+            circle.transform(Vector2(5 * unit(rng) - 2, 4 * unit(rng) - 2), 0);
+
+            const Vector2 center(circle.get_centroid());
+            const Vertices vertices(polygon.get_vertices());
+            const int count(polygon.get_count());
+            double distance(INFINITY);
+            for (int i(0); i < count; ++i) {
+                distance = std::min(distance, segment_distance(center, vertices[i], vertices[(i + 1) % count]));
+            }
+            const bool inside(polygon.contains_point(center));
+            const double radius(circle.get_radius());
+            const bool intersecting(inside || distance <= radius);
+            const double depth(inside ? radius + distance : radius - distance);
+
+            const Manifold manifold(collide_circle_polygon(&circle, &polygon));
+            if (manifold.intersecting != intersecting) {
+                hit_mismatch += std::abs(distance - radius) > exact_tolerance;
+                continue;
+            }
+            if (!intersecting) {
+                continue;
+            }
+
+            ++hits;
+            const double error(std::abs(manifold.depth - depth));
+            max_depth_error = std::max(max_depth_error, error);
+            depth_mismatch += error > exact_tolerance;
+
+            const Manifold flipped(collide_polygon_circle(&polygon, &circle));
+            asymmetric += (flipped.normal + manifold.normal).norm() > exact_tolerance
+                       || std::abs(flipped.depth - manifold.depth) > exact_tolerance;
+
+            polygon.translate(manifold.normal * (manifold.depth + separation_slop));
+            not_separated += collide_circle_polygon(&circle, &polygon).intersecting;
+        }
+
+        return report("circle_polygon", options.pairs, hit_mismatch + depth_mismatch + not_separated + asymmetric,
+                      std::to_string(hits) + " hits, " + std::to_string(hit_mismatch) + " hit mismatches, "
+                      + std::to_string(depth_mismatch) + " depth mismatches (max error "
+                      + std::to_string(max_depth_error) + "), " + std::to_string(not_separated) + " not separated, "
+                      + std::to_string(asymmetric) + " asymmetric");
+    }
+
+    /**
+     * @brief GJK and the distance query warm started from the simplex of the last frame
+     * against cold ones, on pairs moved a little at each frame as in a step
+     */
+    unsigned check_warm_start(const Options& options) {
+        constexpr unsigned frames(20);
+        std::mt19937 rng(options.seed);
+        std::uniform_real_distribution<double> symmetric(-1, 1);
+
+        const unsigned sequences(std::max(1u, options.pairs / (4 * frames)));
+        unsigned intersections(0), distances(0), hit_mismatch(0), depth_mismatch(0), distance_mismatch(0);
+        double max_depth_error(0), max_distance_error(0);
+        const uint64_t warm_starts(narrow_phase_stats().gjk_warm_starts);
+        for (unsigned k(0); k < sequences; ++k) {
+            Polygon a(random_polygon(rng, 0.5, 0.5));
+            Polygon b(random_polygon(rng, 0.4, 0.4));
+            b.translate(Vector2(symmetric(rng), symmetric(rng)) * 1.2);
+
+            SimplexCache intersection_cache;
+            SimplexCache distance_cache;
+            for (unsigned f(0); f < frames; ++f) {
+                a.translate(Vector2(symmetric(rng), symmetric(rng)) * 0.02);
+                a.rotate(0.05 * symmetric(rng));
+
+                const Manifold cold(collide_convex(&a, &b));
+                const Manifold warm(collide_convex(&a, &b, &intersection_cache));
+                if (cold.intersecting != warm.intersecting) {
+                    ++hit_mismatch;
+                }else if (cold.intersecting) {
+                    ++intersections;
+                    const double error(std::abs(cold.depth - warm.depth));
+                    max_depth_error = std::max(max_depth_error, error);
+                    depth_mismatch += error > depth_tolerance;
+                }else {
+                    ++distances;
+                    const double error(std::abs(ditance_convex(&a, &b).distance
+                                                - ditance_convex(&a, &b, &distance_cache).distance));
+                    max_distance_error = std::max(max_distance_error, error);
+                    distance_mismatch += error > exact_tolerance;
+                }
+            }
+        }
+
+        // A cache that is never used would pass trivially
+        const bool never_warm(narrow_phase_stats().gjk_warm_starts == warm_starts);
+        return report("warm_start", sequences * frames, hit_mismatch + depth_mismatch + distance_mismatch + never_warm,
+                      std::to_string(intersections) + " intersections, " + std::to_string(distances) + " distances, "
+                      + std::to_string(hit_mismatch) + " hit mismatches, " + std::to_string(depth_mismatch)
+                      + " depth mismatches (max error " + std::to_string(max_depth_error) + "), "
+                      + std::to_string(distance_mismatch) + " distance mismatches (max error "
+                      + std::to_string(max_distance_error) + ")" + (never_warm ? ", never warm started" : ""));
+    }
+
+    /**
+     * @brief Every broad phase against all the pairs of bodies, on the swept boxes the world
+     * left on the bodies: no overlapping pair is missed, and no pair is reported twice, of two
+     * static bodies, with a disabled body or filtered out. The bodies change every 50 frames,
+     * and a static body moves.
+     */
+    unsigned check_broad_phases(const Options& options) {
+        const std::vector<std::string> scenes({"collision", "stacking", "springs", "mixed_sizes"});
+        const std::vector<std::pair<std::string, std::function<BroadPhase*()>>> broad_phases({
+            {"sap", [] { return new SweepAndPrune(); }},
+            {"tree", [] { return new DynamicTree(); }},
+            {"incremental_sap", [] { return new IncrementalSweepAndPrune(); }},
+            {"spatial_hash", [] { return new SpatialHash(); }},
+            {"hierarchical_grid", [] { return new HierarchicalGrid(); }},
+        });
+
+        unsigned cases(0), failures(0);
+        std::string details;
+        for (const auto& scene : scenes) {
+            for (const auto& broad_phase_entry : broad_phases) {
+                srand(options.seed);
+                World world;
+                Settings settings;
+                load_scene(scene, world, settings);
+                world.set_gravity(g * settings.enable_gravity);
+
+                std::unique_ptr<BroadPhase> broad_phase(broad_phase_entry.second());
+                std::vector<RigidBody*> bodies;
+                for (unsigned i(0); i < world.get_body_count(); ++i) {
+                    bodies.push_back(world.get_body_at(i));
+                    broad_phase->add_body(bodies.back());
+                }
+
+                unsigned missed(0), invalid(0);
+                std::vector<BodyPair> pairs;
+                // By address, the ids of the world repeat once bodies are destroyed
+                std::vector<std::pair<RigidBody*, RigidBody*>> found;
+                auto ordered = [](RigidBody* a, RigidBody* b) { return std::make_pair(std::min(a, b), std::max(a, b)); };
+                for (unsigned f(0); f < options.frames; ++f) {
+                    world.step(max_time_step, 8, settings);
+                    broad_phase->process(pairs);
+                    ++cases;
+
+                    found.clear();
+                    for (const auto& pair : pairs) {
+                        found.push_back(ordered(pair[0], pair[1]));
+                        invalid += !pair[0]->is_enabled() || !pair[1]->is_enabled()
+                                || (pair[0]->is_static() && pair[1]->is_static())
+                                || !should_collide(pair[0]->get_filter(), pair[1]->get_filter());
+                    }
+                    std::sort(found.begin(), found.end());
+                    invalid += std::adjacent_find(found.begin(), found.end()) != found.end();
+
+                    for (size_t i(0); i < bodies.size(); ++i) {
+                        for (size_t j(i + 1); j < bodies.size(); ++j) {
+                            RigidBody* a(bodies[i]);
+                            RigidBody* b(bodies[j]);
+                            if (!a->is_enabled() || !b->is_enabled() || (a->is_static() && b->is_static())
+                             || !should_collide(a->get_filter(), b->get_filter())
+                             || !AABB_overlap(a->get_swept_aabb(), b->get_swept_aabb())) {
+                                continue;
+                            }
+                            missed += !std::binary_search(found.begin(), found.end(), ordered(a, b));
+                        }
+                    }
+
+                    // Moved static body
+                    if (f % 50 == 24) {
+                        const auto body(std::find_if(bodies.begin(), bodies.end(),
+                                        [](const RigidBody* body) { return body->is_static(); }));
+                        if (body != bodies.end()) {
+                            (*body)->rotate(0.3);
+                            (*body)->move(Vector2(0.2, 0.1));
+                            broad_phase->update_body(*body);
+                        }
+                    }
+
+                    // Removed and added bodies
+                    if (f % 50 == 49 && bodies.size() > 10) {
+                        for (unsigned k(0); k < 3; ++k) {
+                            RigidBody* body(bodies[3 + k]);
+                            broad_phase->remove_body(body);
+                            world.destroy_body(body);
+                            bodies.erase(bodies.begin() + 3 + k);
+                        }
+                        RigidBodyDef def;
+                        def.position = {0.5 * world.get_scene_width(), 0.8 * world.get_scene_height()};
+                        def.filter.group = -1;  // Not with each other
+                        const Circle circle(0.2);
+                        for (unsigned k(0); k < 2; ++k) {
+                            def.position.x += 0.5;
+                            bodies.push_back(world.add_body(def, circle));
+                            broad_phase->add_body(bodies.back());
+                        }
+                    }
+                }
+
+                if (missed || invalid) {
+                    details += (details.empty() ? "" : ", ") + scene + "/" + broad_phase_entry.first + ": "
+                             + std::to_string(missed) + " missed, " + std::to_string(invalid) + " invalid";
+                }
+                failures += missed + invalid;
+            }
+        }
+
+        return report("broad_phases", cases, failures, details.empty() ? "every scene and broad phase" : details);
+    }
+
+    /**
+     * @brief The begin and end events of the incremental sweep and prune against the changes
+     * of its pairs. While the bodies move one after the other, a pair may begin and end within
+     * the same process: only the difference of the events is checked. An inserted body must
+     * only begin its own pairs. Removed bodies drop their pairs without an event.
+     */
+    unsigned check_sap_events(const Options& options) {
+        typedef std::pair<RigidBody*, RigidBody*> Key;
+        const std::vector<std::string> scenes({"collision", "stacking", "springs", "mixed_sizes"});
+        auto ordered = [](const BodyPair& pair) { return Key(std::min(pair[0], pair[1]), std::max(pair[0], pair[1])); };
+        auto sorted_keys = [&ordered](const std::vector<BodyPair>& pairs, std::vector<Key>& keys) {
+            keys.clear();
+            for (const auto& pair : pairs) {
+                keys.push_back(ordered(pair));
+            }
+            std::sort(keys.begin(), keys.end());
+        };
+
+        unsigned cases(0), failures(0);
+        std::string details;
+        for (const auto& scene : scenes) {
+            srand(options.seed);
+            World world;
+            Settings settings;
+            load_scene(scene, world, settings);
+            world.set_gravity(g * settings.enable_gravity);
+
+            std::mt19937 rng(options.seed);
+            std::uniform_real_distribution<double> x_dist(0, world.get_scene_width());
+            std::uniform_real_distribution<double> y_dist(0, world.get_scene_height());
+
+            IncrementalSweepAndPrune sap;
+            std::vector<RigidBody*> bodies;
+            for (unsigned i(0); i < world.get_body_count(); ++i) {
+                bodies.push_back(world.get_body_at(i));
+                sap.add_body(bodies.back());
+            }
+
+            unsigned wrong_steps(0), wrong_insertions(0);
+            std::vector<BodyPair> pairs;
+            std::vector<Key> previous;
+            std::vector<Key> current;
+            std::vector<Key> begins;
+            std::vector<Key> ends;
+            std::vector<Key> changes;
+            for (unsigned f(0); f < options.frames; ++f) {
+                world.step(max_time_step, 8, settings);
+                sap.process(pairs);
+                ++cases;
+
+                // Begins not cancelled by an end are the new pairs, and the other way round
+                sorted_keys(pairs, current);
+                sorted_keys(sap.get_begin_events(), begins);
+                sorted_keys(sap.get_end_events(), ends);
+                changes.clear();
+                std::set_difference(begins.begin(), begins.end(), ends.begin(), ends.end(), std::back_inserter(changes));
+                std::vector<Key> expected;
+                std::set_difference(current.begin(), current.end(), previous.begin(), previous.end(), std::back_inserter(expected));
+                wrong_steps += changes != expected;
+                changes.clear();
+                std::set_difference(ends.begin(), ends.end(), begins.begin(), begins.end(), std::back_inserter(changes));
+                expected.clear();
+                std::set_difference(previous.begin(), previous.end(), current.begin(), current.end(), std::back_inserter(expected));
+                wrong_steps += changes != expected;
+                previous = current;
+
+                if (f % 10 == 9 && bodies.size() > 10) {
+                    RigidBody* body(bodies[3]);
+                    sap.remove_body(body);
+                    world.destroy_body(body);
+                    bodies.erase(bodies.begin() + 3);
+
+                    RigidBodyDef def;
+                    def.position = {x_dist(rng), y_dist(rng)};
+                    body = world.add_body(def, Circle(0.3));
+                    bodies.push_back(body);
+                    sap.add_body(body);
+                    ++cases;
+
+                    // Nothing moved: the events are those of the insertion alone
+                    sap.process(pairs);
+                    sorted_keys(pairs, current);
+                    expected.clear();
+                    for (const auto& key : current) {
+                        if (key.first == body || key.second == body) {
+                            expected.push_back(key);
+                        }
+                    }
+                    sorted_keys(sap.get_begin_events(), begins);
+                    wrong_insertions += begins != expected || !sap.get_end_events().empty();
+                    previous = current;
+                }
+            }
+
+            if (wrong_steps || wrong_insertions) {
+                details += (details.empty() ? "" : ", ") + scene + ": " + std::to_string(wrong_steps)
+                         + " wrong steps, " + std::to_string(wrong_insertions) + " wrong insertions";
+            }
+            failures += wrong_steps + wrong_insertions;
+        }
+
+        return report("sap_events", cases, failures, details.empty() ? "every scene" : details);
+    }
+
+    /**
+     * @brief The spatial queries of the world against all the bodies, under each broad phase
+     */
+    unsigned check_queries(const Options& options) {
+        const std::vector<std::string> scenes({"collision", "stacking", "mixed_sizes"});
+        auto by_id = [](const RigidBody* a, const RigidBody* b) { return a->get_id() < b->get_id(); };
+
+        unsigned cases(0), failures(0);
+        std::string details;
+        for (const auto& scene : scenes) {
+            for (unsigned type(0); type < BROAD_PHASE_COUNT; ++type) {
+                srand(options.seed);
+                World world;
+                Settings settings;
+                load_scene(scene, world, settings);
+                world.set_gravity(g * settings.enable_gravity);
+                world.set_broad_phase(static_cast<BroadPhaseType>(type));
+
+                std::mt19937 rng(options.seed);
+                std::uniform_real_distribution<double> x_dist(0, world.get_scene_width());
+                std::uniform_real_distribution<double> y_dist(0, world.get_scene_height());
+
+                unsigned wrong(0);
+                std::vector<RigidBody*> found;
+                std::vector<RigidBody*> expected;
+                for (unsigned f(0); f < options.frames; ++f) {
+                    for (unsigned q(0); q < 10; ++q) {
+                        const Vector2 p1(x_dist(rng), y_dist(rng));
+                        const Vector2 p2(x_dist(rng), y_dist(rng));
+                        cases += 4;
+
+                        const AABB aabb{{std::min(p1.x, p2.x), std::min(p1.y, p2.y)},
+                                        {std::max(p1.x, p2.x), std::max(p1.y, p2.y)}};
+                        world.query_aabb(aabb, found);
+                        expected.clear();
+                        for (unsigned i(0); i < world.get_body_count(); ++i) {
+                            RigidBody* body(world.get_body_at(i));
+                            if (AABB_overlap(body->get_shape()->get_aabb(), aabb)) {
+                                expected.push_back(body);
+                            }
+                        }
+                        std::sort(expected.begin(), expected.end(), by_id);
+                        wrong += found != expected;
+
+                        world.query_point(p1, found);
+                        expected.clear();
+                        for (unsigned i(0); i < world.get_body_count(); ++i) {
+                            RigidBody* body(world.get_body_at(i));
+                            if (body->get_shape()->contains_point(p1)) {
+                                expected.push_back(body);
+                            }
+                        }
+                        std::sort(expected.begin(), expected.end(), by_id);
+                        wrong += found != expected;
+
+                        World::CastHit hit;
+                        const bool ray_hit(world.raycast(p1, p2, hit));
+                        double fraction(2);
+                        CastOutput output;
+                        for (unsigned i(0); i < world.get_body_count(); ++i) {
+                            if (raycast(world.get_body_at(i)->get_shape(), p1, p2, output)) {
+                                fraction = std::min(fraction, output.fraction);
+                            }
+                        }
+                        wrong += ray_hit != (fraction <= 1)
+                              || (ray_hit && std::abs(hit.fraction - fraction) > exact_tolerance);
+
+                        Circle circle(0.3);
+                        circle.transform(p1, 0);
+                        const bool cast_hit(world.shape_cast(circle, p2 - p1, hit));
+                        fraction = 2;
+                        for (unsigned i(0); i < world.get_body_count(); ++i) {
+                            if (shape_cast(&circle, p2 - p1, world.get_body_at(i)->get_shape(), output)) {
+                                fraction = std::min(fraction, output.fraction);
+                            }
+                        }
+                        wrong += cast_hit != (fraction <= 1)
+                              || (cast_hit && std::abs(hit.fraction - fraction) > exact_tolerance);
+                    }
+                    world.step(max_time_step, 8, settings);
+                }
+
+                if (wrong) {
+                    details += (details.empty() ? "" : ", ") + scene + "/" + broad_phase_names[type] + ": "
+                             + std::to_string(wrong) + " wrong";
+                }
+                failures += wrong;
+            }
+        }
+
+        return report("queries", cases, failures, details.empty() ? "every scene and broad phase" : details);
+    }
+
+    std::vector<Check> make_checks() {
+        return {
+            {"sat", "SAT polygon/polygon kernel against GJK + EPA", check_sat},
+            {"circle_polygon", "Circle/polygon kernel against the exact edge distance", check_circle_polygon},
+            {"warm_start", "Warm started GJK and distance against cold ones", check_warm_start},
+            {"broad_phases", "Broad phases against all the pairs of bodies", check_broad_phases},
+            {"sap_events", "Incremental sweep and prune events against its pair set", check_sap_events},
+            {"queries", "World queries against all the bodies", check_queries},
+        };
+    }
+
+    void print_usage(const char* program) {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "  --check <name>    Check to run, can be repeated (default: all)\n"
+                  << "  --pairs <n>       Random pairs of the narrow phase checks (default: 200000)\n"
+                  << "  --frames <n>      Frames of the scene checks (default: 120)\n"
+                  << "  --seed <n>        Seed of the random generators (default: 0)\n"
+                  << "  --list            List the checks\n";
+    }
+
+    int parse_options(int argc, char* argv[], Options& options, const std::vector<Check>& checks) {
+        for (int i(1); i < argc; ++i) {
+            const std::string arg(argv[i]);
+            const bool has_value(i + 1 < argc);
+
+            if (arg == "--help" || arg == "-h") {
+                print_usage(argv[0]);
+                return -1;
+            }else if (arg == "--list") {
+                for (const auto& check : checks) {
+                    std::cout << check.name << " : " << check.description << "\n";
+                }
+                return -1;
+            }else if (arg == "--check" && has_value) {
+                options.checks.push_back(argv[++i]);
+            }else if (arg == "--pairs" && has_value) {
+                options.pairs = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--frames" && has_value) {
+                options.frames = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--seed" && has_value) {
+                options.seed = std::strtoul(argv[++i], nullptr, 10);
+            }else {
+                std::cerr << "Unknown or incomplete option: " << arg << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        for (const auto& name : options.checks) {
+            const bool found(std::any_of(checks.begin(), checks.end(),
+                        [&](const Check& check) { return check.name == name; }));
+            if (!found) {
+                std::cerr << "Unknown check: " << name << " (see --list)\n";
+                return 1;
+            }
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const std::vector<Check> checks(make_checks());
+
+    Options options;
+    const int status(parse_options(argc, argv, options, checks));
+    if (status != 0) {
+        return status < 0 ? 0 : status;
+    }
+
+    unsigned failures(0);
+    for (const auto& check : checks) {
+        if (options.checks.empty() || std::find(options.checks.begin(), options.checks.end(),
+                                                check.name) != options.checks.end()) {
+            failures += check.run(options);
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,408 @@
+// Narrow phase micro-benchmarks: times the collision kernels on large pre-generated
+// sets of randomized shape pairs, outside of World::step
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "narrow_phase.h"
+#include "shape.h"
+#include "utils.h"
+#include "vector2.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    const char* counter_unit("cycles");
+
+    inline uint64_t read_counter() {
+        return __rdtsc();
+    }
+#else
+    const char* counter_unit("ns");
+
+    inline uint64_t read_counter() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+#endif
+
+    struct Options {
+        unsigned pairs = 20000;
+        unsigned repeats = 7;
+        unsigned seed = 0;
+    };
+
+    // A set of shape pairs placed at the same signed overlap along their separating axis
+    struct PairSet {
+        std::string name;
+        double overlap = 0; // > 0: penetration depth, < 0: distance
+        std::vector<std::unique_ptr<Shape>> a;
+        std::vector<std::unique_ptr<Shape>> b;
+    };
+
+    // Keeps the results of the kernels alive
+    volatile double sink(0);
+
+    /**
+     * @brief Creates a random convex polygon of 3 to 8 vertices, centered on its centroid
+     */
+    std::unique_ptr<Shape> random_polygon(std::mt19937& rng) {
+        std::uniform_int_distribution<int> count_dist(3, shape_max_vertices);
+        std::uniform_real_distribution<double> radius_dist(0.5, 1.0);
+        std::uniform_real_distribution<double> jitter_dist(-0.3, 0.3);
+
+        // Points around a circle, at jittered angles so that none is collinear
+        const int count(count_dist(rng));
+        const double radius(radius_dist(rng));
+        std::vector<Vector2> points;
+        for (int i(0); i < count; ++i) {
+            const double angle((i + jitter_dist(rng)) * 2 * PI / count);
+            points.push_back(Vector2(std::cos(angle), std::sin(angle)) * radius);
+        }
+
+        std::unique_ptr<Shape> shape(new Polygon(compute_hull(points)));
+        shape->compute_mass_properties(1);
+        return shape;
+    }
+
+    std::unique_ptr<Shape> random_circle(std::mt19937& rng) {
+        std::uniform_real_distribution<double> radius_dist(0.5, 1.0);
+        std::unique_ptr<Shape> shape(new Circle(radius_dist(rng)));
+        shape->compute_mass_properties(1);
+        return shape;
+    }
+
+    /**
+     * @brief Places B in a random direction from A, then moves it along their separating axis
+     * so that they are at the given distance (overlap < 0) or penetrate by the given depth along that axis (overlap > 0)
+     */
+    void place_pair(Shape* a, Shape* b, const double overlap, std::mt19937& rng) {
+        std::uniform_real_distribution<double> angle_dist(0, 2 * PI);
+
+        const double theta_b(angle_dist(rng));
+        a->transform(vector2_zero, angle_dist(rng));
+        b->transform(vector2_zero, theta_b);
+
+        // Separate the shapes by one unit along a random axis
+        const double axis_angle(angle_dist(rng));
+        const Vector2 n(std::cos(axis_angle), std::sin(axis_angle));
+        const double extent(dot2(support(a, n), n) - dot2(support(b, -n), n));
+        b->transform(n * (extent + 1), theta_b);
+
+        const DistanceInfo info(ditance_convex(a, b));
+        const Vector2 u((info.points.closest_b - info.points.closest_a) / info.distance);
+        b->transform(b->get_centroid() - u * (info.distance + overlap), theta_b);
+    }
+
+    std::unique_ptr<Shape> random_shape(const ShapeType type, std::mt19937& rng) {
+        return type == CIRCLE ? random_circle(rng) : random_polygon(rng);
+    }
+
+    PairSet make_pair_set(const std::string& name, const double overlap, const ShapeType type_a,
+                          const ShapeType type_b, const unsigned count, std::mt19937& rng) {
+        PairSet set;
+        set.name = name;
+        set.overlap = overlap;
+        for (unsigned i(0); i < count; ++i) {
+            set.a.push_back(random_shape(type_a, rng));
+            set.b.push_back(random_shape(type_b, rng));
+            place_pair(set.a.back().get(), set.b.back().get(), overlap, rng);
+        }
+        return set;
+    }
+
+    /**
+     * @brief Runs a kernel over a whole set several times, and keeps the fastest pass
+     * @return The counter ticks per call of the fastest pass
+     */
+    template <typename Kernel>
+    double measure(const unsigned calls, const unsigned repeats, Kernel kernel) {
+        uint64_t best(UINT64_MAX);
+        for (unsigned r(0); r < repeats; ++r) {
+            const uint64_t start(read_counter());
+            kernel();
+            best = std::min(best, read_counter() - start);
+        }
+        return (double)best / calls;
+    }
+
+    void print_row(const std::string& kernel, const std::string& set, const double ticks,
+                   const double iterations = -1, const double epa_iterations = -1, const double hits = -1) {
+        std::cout << kernel << "\t" << set << "\t" << truncate_to_string(ticks, 10);
+        std::cout << "\t" << (iterations >= 0 ? truncate_to_string(iterations) : "-");
+        std::cout << "\t" << (epa_iterations >= 0 ? truncate_to_string(epa_iterations) : "-");
+        std::cout << "\t" << (hits >= 0 ? truncate_to_string(hits * 100, 10) + "%" : "-") << "\n";
+    }
+
+    void print_usage(const char* program) {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "  --pairs <n>     Pairs per set (default: 20000)\n"
+                  << "  --repeats <n>   Passes over each set, the fastest is kept (default: 7)\n"
+                  << "  --seed <n>      Seed of the shape generator (default: 0)\n";
+    }
+
+    int parse_options(int argc, char* argv[], Options& options) {
+        for (int i(1); i < argc; ++i) {
+            const std::string arg(argv[i]);
+            const bool has_value(i + 1 < argc);
+
+            if (arg == "--help" || arg == "-h") {
+                print_usage(argv[0]);
+                return -1;
+            }else if (arg == "--pairs" && has_value) {
+                options.pairs = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--repeats" && has_value) {
+                options.repeats = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--seed" && has_value) {
+                options.seed = std::strtoul(argv[++i], nullptr, 10);
+            }else {
+                std::cerr << "Unknown or incomplete option: " << arg << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (options.pairs == 0 || options.repeats == 0) {
+            std::cerr << "--pairs and --repeats must be positive\n";
+            return 1;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    const int status(parse_options(argc, argv, options));
+    if (status != 0) {
+        return status < 0 ? 0 : status;
+    }
+
+    std::mt19937 rng(options.seed);
+    const unsigned n(options.pairs);
+
+    std::vector<PairSet> polygon_sets;
+    polygon_sets.push_back(make_pair_set("overlap_0.01", 0.01, POLYGON, POLYGON, n, rng));
+    polygon_sets.push_back(make_pair_set("overlap_0.1", 0.1, POLYGON, POLYGON, n, rng));
+    polygon_sets.push_back(make_pair_set("overlap_0.5", 0.5, POLYGON, POLYGON, n, rng));
+    polygon_sets.push_back(make_pair_set("gap_0.01", -0.01, POLYGON, POLYGON, n, rng));
+    polygon_sets.push_back(make_pair_set("gap_1", -1.0, POLYGON, POLYGON, n, rng));
+
+    std::vector<PairSet> circle_sets;
+    circle_sets.push_back(make_pair_set("overlap_0.1", 0.1, CIRCLE, CIRCLE, n, rng));
+    circle_sets.push_back(make_pair_set("gap_0.1", -0.1, CIRCLE, CIRCLE, n, rng));
+
+    // Random point clouds: hull candidates on a circle plus interior points
+    std::vector<std::vector<Vector2>> clouds(n);
+    {
+        std::uniform_int_distribution<int> count_dist(3, shape_max_vertices);
+        std::uniform_real_distribution<double> unit_dist(0, 1);
+        for (auto& cloud : clouds) {
+            const int count(count_dist(rng));
+            for (int i(0); i < count; ++i) {
+                const double angle((i + 0.5 * unit_dist(rng)) * 2 * PI / count);
+                cloud.push_back(Vector2(std::cos(angle), std::sin(angle)));
+            }
+            for (int i(0); i < count; ++i) {
+                const double angle(unit_dist(rng) * 2 * PI);
+                cloud.push_back(Vector2(std::cos(angle), std::sin(angle)) * 0.5 * unit_dist(rng));
+            }
+            std::shuffle(cloud.begin(), cloud.end(), rng);
+        }
+    }
+
+    std::vector<Vector2> directions(n);
+    {
+        std::uniform_real_distribution<double> angle_dist(0, 2 * PI);
+        for (auto& d : directions) {
+            const double angle(angle_dist(rng));
+            d = Vector2(std::cos(angle), std::sin(angle));
+        }
+    }
+
+    // Circles against polygons, drawn last so that the sets above do not change
+    std::vector<PairSet> circle_polygon_sets;
+    circle_polygon_sets.push_back(make_pair_set("circle_overlap_0.1", 0.1, CIRCLE, POLYGON, n, rng));
+    circle_polygon_sets.push_back(make_pair_set("circle_gap_0.1", -0.1, CIRCLE, POLYGON, n, rng));
+
+    std::cout << "Pairs per set: " << n << ", repeats: " << options.repeats
+              << ", unit: " << counter_unit << "/pair\n"
+              << "kernel\tset\t" << counter_unit << "\tGJK it.\tEPA it.\thits\n";
+
+    NarrowPhaseStats& stats(narrow_phase_stats());
+
+    // support
+    {
+        const PairSet& set(polygon_sets.front());
+        const double ticks(measure(n, options.repeats, [&]() {
+            double sum(0);
+            for (unsigned i(0); i < n; ++i) {
+                sum += support(set.a[i].get(), directions[i]).x;
+            }
+            sink = sink + sum;
+        }));
+        print_row("support", "polygon", ticks);
+    }
+
+    // collide_circle_circle
+    for (const auto& set : circle_sets) {
+        unsigned hits(0);
+        const double ticks(measure(n, options.repeats, [&]() {
+            hits = 0;
+            for (unsigned i(0); i < n; ++i) {
+                hits += collide_circle_circle(set.a[i].get(), set.b[i].get()).intersecting;
+            }
+        }));
+        print_row("collide_circle_circle", set.name, ticks, -1, -1, (double)hits / n);
+    }
+
+    // collide_circle_polygon, then the GJK + EPA path on the same pairs
+    for (const auto& set : circle_polygon_sets) {
+        unsigned hits(0);
+        const double ticks(measure(n, options.repeats, [&]() {
+            hits = 0;
+            for (unsigned i(0); i < n; ++i) {
+                hits += collide_circle_polygon(set.a[i].get(), set.b[i].get()).intersecting;
+            }
+        }));
+        print_row("collide_circle_polygon", set.name, ticks, -1, -1, (double)hits / n);
+    }
+    for (const auto& set : circle_polygon_sets) {
+        unsigned hits(0);
+        stats.reset();
+        const double ticks(measure(n, options.repeats, [&]() {
+            hits = 0;
+            for (unsigned i(0); i < n; ++i) {
+                hits += collide_convex(set.a[i].get(), set.b[i].get()).intersecting;
+            }
+        }));
+        const double calls((double)n * options.repeats);
+        print_row("collide_convex", set.name, ticks, stats.gjk_iterations / calls,
+                  stats.epa_calls ? (double)stats.epa_iterations / stats.epa_calls : 0, (double)hits / n);
+    }
+
+    // collide_polygon_polygon, SAT + clip
+    for (const auto& set : polygon_sets) {
+        unsigned hits(0);
+        const double ticks(measure(n, options.repeats, [&]() {
+            hits = 0;
+            for (unsigned i(0); i < n; ++i) {
+                hits += collide_polygon_polygon(set.a[i].get(), set.b[i].get()).intersecting;
+            }
+        }));
+        print_row("collide_polygon_polygon", set.name, ticks, -1, -1, (double)hits / n);
+    }
+
+    // collide_convex, GJK + EPA + clip
+    for (const auto& set : polygon_sets) {
+        unsigned hits(0);
+        stats.reset();
+        const double ticks(measure(n, options.repeats, [&]() {
+            hits = 0;
+            for (unsigned i(0); i < n; ++i) {
+                hits += collide_convex(set.a[i].get(), set.b[i].get()).intersecting;
+            }
+        }));
+        const double calls((double)n * options.repeats);
+        print_row("collide_convex", set.name, ticks, stats.gjk_iterations / calls,
+                  stats.epa_calls ? (double)stats.epa_iterations / stats.epa_calls : 0, (double)hits / n);
+    }
+
+    // ditance_convex, only defined for separated shapes
+    for (const auto& set : polygon_sets) {
+        if (set.overlap > 0) {
+            continue;
+        }
+        stats.reset();
+        const double ticks(measure(n, options.repeats, [&]() {
+            double sum(0);
+            for (unsigned i(0); i < n; ++i) {
+                sum += ditance_convex(set.a[i].get(), set.b[i].get()).distance;
+            }
+            sink = sink + sum;
+        }));
+        print_row("ditance_convex", set.name, ticks, (double)stats.distance_iterations / stats.distance_calls);
+    }
+
+    // Both GJK queries again, each pair starting from the simplex its previous query left
+    // in its cache: the case of a resting pair
+    std::vector<SimplexCache> caches(n);
+    for (const auto& set : polygon_sets) {
+        unsigned hits(0);
+        std::fill(caches.begin(), caches.end(), SimplexCache());
+        for (unsigned i(0); i < n; ++i) {
+            collide_convex(set.a[i].get(), set.b[i].get(), &caches[i]);
+        }
+        stats.reset();
+        const double ticks(measure(n, options.repeats, [&]() {
+            hits = 0;
+            for (unsigned i(0); i < n; ++i) {
+                hits += collide_convex(set.a[i].get(), set.b[i].get(), &caches[i]).intersecting;
+            }
+        }));
+        const double calls((double)n * options.repeats);
+        print_row("collide_convex warm", set.name, ticks, stats.gjk_iterations / calls,
+                  stats.epa_calls ? (double)stats.epa_iterations / stats.epa_calls : 0, (double)hits / n);
+    }
+    for (const auto& set : polygon_sets) {
+        if (set.overlap > 0) {
+            continue;
+        }
+        std::fill(caches.begin(), caches.end(), SimplexCache());
+        for (unsigned i(0); i < n; ++i) {
+            ditance_convex(set.a[i].get(), set.b[i].get(), &caches[i]);
+        }
+        stats.reset();
+        const double ticks(measure(n, options.repeats, [&]() {
+            double sum(0);
+            for (unsigned i(0); i < n; ++i) {
+                sum += ditance_convex(set.a[i].get(), set.b[i].get(), &caches[i]).distance;
+            }
+            sink = sink + sum;
+        }));
+        print_row("ditance_convex warm", set.name, ticks, (double)stats.distance_iterations / stats.distance_calls);
+    }
+
+    // Polygon::transform, as done after each move of a body. After the kernels since it
+    // moves the shapes of the set, to a new angle on each pass.
+    {
+        PairSet& set(polygon_sets.front());
+        double angle(0);
+        const double ticks(measure(n, options.repeats, [&]() {
+            double sum(0);
+            angle += 0.1;
+            for (unsigned i(0); i < n; ++i) {
+                set.a[i]->transform(directions[i], angle + directions[i].x);
+                sum += set.a[i]->get_aabb().max.x;
+            }
+            sink = sink + sum;
+        }));
+        print_row("transform", "polygon", ticks);
+    }
+
+    // compute_hull
+    {
+        const double ticks(measure(n, options.repeats, [&]() {
+            unsigned sum(0);
+            for (const auto& cloud : clouds) {
+                sum += compute_hull(cloud).count;
+            }
+            sink = sink + sum;
+        }));
+        print_row("compute_hull", "3-8 vertices", ticks);
+    }
+
+    return 0;
+}
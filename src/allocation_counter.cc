@@ -0,0 +1,73 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "allocation_counter.h"
+#include "config.h"
+
+namespace {
+    std::atomic<uint64_t> count(0);
+    std::atomic<uint64_t> bytes(0);
+
+#ifdef ALLOCATION_COUNTER
+    void* counted_malloc(const std::size_t size) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(size, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+#endif
+}
+
+uint64_t allocation_count() {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint64_t allocated_bytes() {
+    return bytes.load(std::memory_order_relaxed);
+}
+
+#ifdef ALLOCATION_COUNTER
+// The aligned overloads are left to the standard library, they allocate and free on their own
+void* operator new(std::size_t size) {
+    void* ptr(counted_malloc(size));
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return counted_malloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+#endif
@@ -0,0 +1,24 @@
+// Heap allocation counter
+//
+// Replaces the global operator new and delete to count the allocations of the whole
+// program, so that World::step can report how many it made (see World::Counters).
+// Allocations made directly with malloc (SDL, C libraries) are not seen.
+// ALLOCATION_COUNTER is defined in Debug builds and by the PHYSICS2D_ALLOCATION_COUNTER
+// option of CMake, the counts stay at zero without it.
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+/**
+ * @brief Number of calls to operator new since the program started
+ */
+uint64_t allocation_count();
+
+/**
+ * @brief Bytes requested from operator new since the program started
+ */
+uint64_t allocated_bytes();
+
+#endif /* ALLOCATION_COUNTER_H */
@@ -13,6 +13,8 @@
 #include "rigid_body.h"
 #include "shape.h"
 #include "link.h"
+#include "profiler.h"
+#include "scenes.h"
 #include "utils.h"
 #include "control.h"
 #include "render.h"
@@ -21,6 +23,7 @@
 #include "config.h"
 
 constexpr unsigned sim_substeps(20);
+constexpr const char* trace_file("physics2d_trace.json");
 
 Application::Application(SDL_Window* window, SDL_Renderer* renderer, double w, double h)
 :   m_window(window),
@@ -50,6 +53,7 @@ Application::Application(SDL_Window* window, SDL_Renderer* renderer, double w, d
     camera::translate_screen_y(SCREEN_HEIGHT * 0.5);
     m_editor.update_grid();
 
+    m_world.set_scene_size(SCENE_WIDTH, SCENE_HEIGHT);
     create_scene_walls();
 
     SDL_SetCursor(m_crosshair_cursor);
@@ -148,6 +152,12 @@ int Application::run() {
         if (m_settings.plot_phase_plane) {
             show_osc_dynamics_plot(spring_ptr);
         }
+        if (m_settings.plot_counters) {
+            show_counters_plot();
+        }
+        if (m_world.is_cost_attribution_enabled()) {
+            show_cost_attribution();
+        }
         body_id_changed = 0;
         ImGui::Render();
 
@@ -235,32 +245,33 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
         case SDLK_0:
             m_world.destroy_all();
             spring_ptr = nullptr;
-            demo_stacking();
+            demo_stacking(m_world, m_settings);
             break;
         case SDLK_9:
             m_world.destroy_all();
             spring_ptr = nullptr;
-            demo_collision();
+            demo_collision(m_world, m_settings);
             break;
         case SDLK_8:
             m_world.destroy_all();
             spring_ptr = nullptr;
-            demo_double_pendulum();
+            demo_double_pendulum(m_world, m_settings);
+            body_id_changed = 1;
             break;
         case SDLK_7:
             m_world.destroy_all();
             spring_ptr = nullptr;
-            demo_springs();
+            demo_springs(m_world, m_settings);
             break;
         case SDLK_6:
             m_world.destroy_all();
             spring_ptr = nullptr;
-            demo_simple_pendulum();
+            demo_simple_pendulum(m_world, m_settings);
             break;
         case SDLK_5:
             m_world.destroy_all();
             spring_ptr = nullptr;
-            demo_rigidbody();
+            demo_rigidbody(m_world, m_settings);
             break;
         case SDLK_1:
             m_ctrl.editor.active = false;
@@ -279,6 +290,14 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 m_world.step(time_step, sim_substeps, m_settings);
             }
             break;
+        case SDLK_t:
+            // Record the profiled zones, streamed to a Chrome trace until stopped
+            if (!profiler().is_tracing()) {
+                profiler().start_trace(trace_file);
+            }else if (profiler().stop_trace()) {
+                std::cout << "Trace written to " << trace_file << "\n";
+            }
+            break;
         case SDLK_g:
             m_settings.enable_gravity = !m_settings.enable_gravity;
             m_world.set_gravity(g * m_settings.enable_gravity);
@@ -326,6 +345,7 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 RigidBody* body(m_world.get_focused_body());
                 if (body) {
                     body->move({0, DIV / 5});
+                    m_world.update_body(body);
                 }
             }
             break;
@@ -334,6 +354,7 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 RigidBody* body(m_world.get_focused_body());
                 if (body) {
                     body->move({0, -DIV / 5});
+                    m_world.update_body(body);
                 }
             }
             break;
@@ -342,6 +363,7 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 RigidBody* body(m_world.get_focused_body());
                 if (body) {
                     body->move({-DIV / 5, 0});
+                    m_world.update_body(body);
                 }
             }
             break;
@@ -350,6 +372,7 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 RigidBody* body(m_world.get_focused_body());
                 if (body) {
                     body->move({DIV / 5, 0});
+                    m_world.update_body(body);
                 }
             }
             break;
@@ -358,6 +381,7 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 RigidBody* body(m_world.get_focused_body());
                 if (body) {
                     body->rotate(deg2rad(-5));
+                    m_world.update_body(body);
                 }
             }
             break;
@@ -366,6 +390,7 @@ void Application::parse_keybd_event(SDL_Event& keybd_event) {
                 RigidBody* body(m_world.get_focused_body());
                 if (body) {
                     body->rotate(deg2rad(5));
+                    m_world.update_body(body);
                 }
             }
             break;
@@ -518,341 +543,6 @@ void Application::create_scene_walls() {
     m_world.add_body(def, v_wall_box);
 }
 
-void Application::demo_collision() {
-    RigidBodyDef body_def;
-    body_def.position = {SCENE_WIDTH * 0.1, SCENE_HEIGHT * 0.5};
-    body_def.velocity = {3, 0};
-    Polygon collider(create_box(0.125, 0.125));
-    m_world.add_body(body_def, collider);
-
-    body_def.velocity = vector2_zero;
-    for (unsigned i(0); i < 400; ++i) {
-        body_def.position = {SCENE_WIDTH * 0.25 + 0.001 * (rand() % 500),
-                            SCENE_HEIGHT * 0.5 - 0.125 + 0.001 * (rand() % 250)};
-        Circle ball(0.01);
-        m_world.add_body(body_def, ball);
-    }
-
-    m_world.disable_walls();
-    m_world.set_gravity(0);
-    m_settings.enable_gravity = 0;
-    m_settings.draw_body_trajectory = 0;
-}
-
-void Application::demo_stacking() {
-    RigidBodyDef body_def;
-    body_def.position = {SCENE_WIDTH * 0.5, 0.5};
-    body_def.type = STATIC;
-
-    const double block_size(0.1);
-    Polygon ground_box(create_box(block_size * 40, 0.1));
-    RigidBody* ground(m_world.add_body(body_def, ground_box));
-
-    body_def.type = DYNAMIC;
-    for (int i(0); i < 9; ++i) {
-        for (unsigned j(0); j < 15; ++j) {
-            const double x(ground->get_p().x - 2*block_size * (i % 2 == 0 ? i : -i - 1));
-            body_def.position = {x, 1.5 + j};
-            Polygon square_box(create_square(block_size));
-            m_world.add_body(body_def, square_box);
-        }
-    }
-    m_world.disable_walls();
-    m_world.set_gravity(g);
-    m_settings.enable_gravity = 1;
-    m_settings.draw_body_trajectory = 0;
-}
-
-void Application::demo_rigidbody() {
-    const double ground_height(0.25);
-    const double ground_width(SCENE_WIDTH * 2);
-    RigidBodyDef def;
-    def.type = STATIC;
-    def.position = {ground_width * 0.75, -ground_height};
-    Polygon ground_box(create_box(ground_width, ground_height));
-    m_world.add_body(def, ground_box);
-
-    // Cubes and lever
-    const double cube_size(2);
-    Polygon cube(create_square(cube_size));
-    def.type = DYNAMIC;
-    def.position = {cube_size * 2, cube_size};
-    RigidBody* massive_cube(m_world.add_body(def, cube));
-
-    const double bar_height(0.125);
-    const double bar_length(cube_size * 2);
-    Polygon thin_bar(create_box(bar_length, bar_height));
-    def.position = {cube_size * 3, cube_size * 2 + bar_height};
-    RigidBody* lever(m_world.add_body(def, thin_bar));
-
-    const double small_cube_size(2 * bar_height);
-    const Vector2 placeholder(massive_cube->get_p() + Vector2(0, cube_size + 2 * bar_height));
-    cube = create_square(small_cube_size);
-    def.position = placeholder + Vector2(-small_cube_size, small_cube_size);
-    m_world.add_body(def, cube);
-    def.position = placeholder + Vector2(small_cube_size, small_cube_size);
-    m_world.add_body(def, cube);
-    for (int i (0); i < 4; ++i) {
-        def.position = placeholder + Vector2(0, (3 + 2 * i) * small_cube_size);
-        m_world.add_body(def, cube);
-    }
-
-    cube = create_square(cube_size * 0.5);
-    def.position = lever->get_p() + Vector2(bar_length - cube_size * 0.5, cube_size * 4);
-    m_world.add_body(def, cube);
-
-
-    // Seesaw
-    Circle pivot(0.5);
-    const double seesaw_pos(SCENE_WIDTH * 1.25);
-    def.position = {seesaw_pos, 0.5};
-    def.type = STATIC;
-    m_world.add_body(def, pivot);
-
-    const double seesaw_height(bar_height);
-    const double seesaw_length(bar_length);
-    Polygon seesaw(create_box(seesaw_length, seesaw_height));
-    def.position = {seesaw_pos, 1 + seesaw_height};
-    def.type = DYNAMIC;
-    m_world.add_body(def, seesaw);
-
-    const double r_cube_size(cube_size * 0.5);
-    cube = create_square(r_cube_size);
-    def.position = {seesaw_pos + seesaw_length - r_cube_size, 1 + seesaw_height * 2 + r_cube_size};
-    def.friction = {steel_static_friction * 0.25, steel_dynamic_friction * 0.25};
-    m_world.add_body(def, cube);
-
-    cube = create_square(small_cube_size);
-    def.position = {seesaw_pos - seesaw_length + small_cube_size, 1 + seesaw_height * 2 + small_cube_size};
-    def.friction = steel_friction;
-    m_world.add_body(def, cube);
-
-
-    // Dominos
-    double dominos_pos(SCENE_WIDTH * 1.8);
-    double prev_domino_height(0);
-    double domino_width(5e-3);
-    for (int i(0); i < 13; ++i) {
-        RigidBodyDef domino_def;
-        const double domino_height(domino_width * 7);
-        domino_def.position = {dominos_pos + prev_domino_height * 2, domino_height};
-        if (i == 0) {
-            domino_def.position.x += domino_height;
-            domino_def.rotation = -deg2rad(10);
-        }
-        Polygon domino(create_box(domino_width, domino_height));
-        m_world.add_body(domino_def, domino);
-        dominos_pos += prev_domino_height;
-        prev_domino_height = domino_height;
-        domino_width *= 1.5;
-    }
-
-
-    // // Balls collision propagation
-    // Circle ball(0.25);
-    // const double mark(SCENE_WIDTH * 3);
-    // for (int i(0); i < 10; ++i) {
-    //     def.position = {mark + 0.5 * i, 0.25};
-    //     m_world.add_body(def, ball);
-    // }
-    // def.position = {mark - 20 * 0.25, 0.25};
-    // def.velocity = {10, 0};
-    // m_world.add_body(def, ball);
-    //
-    //
-    // // Newton pendulums
-    // for (int i(0); i < 10; ++i) {
-    //     RigidBodyDef body_def;
-    //     body_def.position = {mark + 0.5 * i, SCENE_HEIGHT * 0.5};
-    //     body_def.type = STATIC;
-    //     body_def.enabled = false;
-    //     Polygon anchor_box(create_box(0.5, 0.25));
-    //     RigidBody* anchor(m_world.add_body(body_def, anchor_box));
-    //
-    //     const double length(3);
-    //     if (i == 0) {
-    //         body_def.position = anchor->get_p() + Vector2(-length, 0);
-    //         const double max_angle(PI / 2);
-    //         body_def.velocity = {0, -(1 - cos(max_angle)) * sqrt(2*g*length)};
-    //     }else {
-    //         body_def.position = anchor->get_p() + Vector2(0, -length);
-    //     }
-    //     body_def.type = DYNAMIC;
-    //     body_def.enabled = true;
-    //     Circle circle(0.25);
-    //     RigidBody* body_1(m_world.add_body(body_def, circle));
-    //
-    //     m_world.add_spring(anchor->get_p(), body_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
-    // }
-
-    m_world.set_gravity(g);
-    m_settings.enable_gravity = 1;
-    // camera::fit_width(ground_width * 2);
-    // camera::set_position({ground_width, 75 * ground_height});
-}
-
-void Application::demo_double_pendulum() {
-    const double arm_length(3.0);
-    // System 1
-    RigidBodyDef body_def;
-    body_def.position = {SCENE_WIDTH * 0.5, SCENE_HEIGHT * 0.5};
-    body_def.type = STATIC;
-    body_def.enabled = false;
-    Polygon anchor_box(create_box(0.5, 0.25));
-    RigidBody* anchor(m_world.add_body(body_def, anchor_box));
-
-    body_def.position = anchor->get_p() + vector2_x * arm_length;
-    body_def.type = DYNAMIC;
-    body_def.enabled = true;
-    Circle circle(0.2);
-    RigidBody* body_1(m_world.add_body(body_def, circle));
-    body_def.position = anchor->get_p() + vector2_xy * arm_length;
-    RigidBody* body_2(m_world.add_body(body_def, circle));
-
-    m_world.add_spring(anchor->get_p(), body_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
-    m_world.add_spring(body_1->get_p(), body_2->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
-
-    // System 2
-    body_def.position = anchor->get_p() + vector2_x * 4 * arm_length;
-    body_def.type = STATIC;
-    body_def.enabled = false;
-    RigidBody* anchor_2(m_world.add_body(body_def, anchor_box));
-
-    body_def.position = anchor_2->get_p() + vector2_x * arm_length;
-    body_def.type = DYNAMIC;
-    body_def.enabled = true;
-    RigidBody* body_2_1(m_world.add_body(body_def, circle));
-    body_def.position = anchor_2->get_p() + transform2((vector2_xy * arm_length), vector2_zero, deg2rad(0.1));
-    RigidBody* body_2_2(m_world.add_body(body_def, circle));
-
-    m_world.add_spring(anchor_2->get_p(), body_2_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
-    m_world.add_spring(body_2_1->get_p(), body_2_2->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
-
-    m_world.disable_walls();
-    m_world.focus_body(body_2);
-    body_id_changed = 1;
-    m_world.set_body_trail(body_2->get_id(), true);
-    m_world.set_body_trail(body_2_2->get_id(), true);
-    m_world.set_gravity(g);
-    m_settings.enable_gravity = 1;
-    m_settings.draw_body_trajectory = 1;
-}
-
-void Application::demo_simple_pendulum() {
-    RigidBodyDef body_def;
-    body_def.position = {SCENE_WIDTH * 0.5, SCENE_HEIGHT * 0.5};
-    body_def.type = STATIC;
-    body_def.enabled = false;
-    Polygon anchor_box(create_box(0.5, 0.25));
-    RigidBody* anchor(m_world.add_body(body_def, anchor_box));
-
-    const double length(3);
-    body_def.position = anchor->get_p() + Vector2(0, -length);
-    const double max_angle(PI / 2);
-    body_def.velocity = {(1 - cos(max_angle)) * sqrt(2*g*length), 0};
-    body_def.type = DYNAMIC;
-    body_def.enabled = true;
-    Circle circle(0.2);
-    RigidBody* body_1(m_world.add_body(body_def, circle));
-
-    m_world.add_spring(anchor->get_p(), body_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
-
-    m_world.disable_walls();
-    m_world.focus_on_position(body_1->get_p());
-    m_world.set_gravity(g);
-    m_settings.enable_gravity = 1;
-    m_settings.draw_body_trajectory = 1;
-}
-
-void Application::demo_springs() {
-    RigidBodyDef bodydef;
-    bodydef.type = STATIC;
-
-    const double block_width(0.5);
-    const double block_height(0.25);
-    Polygon box(create_box(block_width, block_height));
-    Circle ball(0.25);
-
-    // Horizontal mass-spring systems
-    for (unsigned i(0); i < 4; ++i) {
-        Vector2 placeholder(0.6 * SCENE_WIDTH, 0.75 * SCENE_HEIGHT - block_height * i * 8);
-        bodydef.type = STATIC;
-        for (unsigned j(1); j < 6; ++j) {
-            bodydef.position = placeholder + vector2_x * block_width * 2 * j;
-            m_world.add_body(bodydef, box);
-        }
-
-        bodydef.position = placeholder + vector2_y * block_height * 2;
-        RigidBody* anchor(m_world.add_body(bodydef, box));
-
-        bodydef.position = anchor->get_p() + vector2_x * block_width * 6;
-        bodydef.type = DYNAMIC;
-        RigidBody* mobile_mass;
-        if (i < 3) {
-            mobile_mass = m_world.add_body(bodydef, ball);
-        }else {
-            mobile_mass = m_world.add_body(bodydef, create_square(block_height));
-        }
-        // Produce a natural frequency of 1 Hz
-        float stiffness(4 * PI * PI * mobile_mass->get_mass());
-        stiffness *= (1 + 10*(i-1));
-        if (i == 0) {
-            stiffness = spring_stiffness_default;
-        }else if (i == 3) {
-            stiffness = spring_stiffness_default * 5;
-        }
-        m_world.add_spring(anchor->get_p(), mobile_mass->get_p(), Spring::UNDAMPED, stiffness);
-        const Vector2 x_offset(-vector2_x * 4 * block_width);
-        mobile_mass->move(x_offset);
-    }
-
-
-    // Vertical mass-spring systems
-    for (unsigned i(0); i < 4; ++i) {
-        bodydef.position = {0.4 * SCENE_WIDTH - i * block_width * 4, 0.75 * SCENE_HEIGHT};
-        bodydef.type = STATIC;
-        RigidBody* vert_anchor(m_world.add_body(bodydef, box));
-
-        bodydef.position = vert_anchor->get_p() - vector2_y * 0.25 * SCENE_HEIGHT;
-        bodydef.type = DYNAMIC;
-        Polygon hanging_box(create_square(block_height));
-        RigidBody* hanging_mass(m_world.add_body(bodydef, hanging_box));
-
-        // Produce a natural frequency of 1 Hz
-        float stiffness(4 * PI * PI * hanging_mass->get_mass());
-        const Spring::DampingType damping((Spring::DampingType)(3 - i));
-        m_world.add_spring(vert_anchor->get_p(), hanging_mass->get_p(), damping, stiffness);
-        // Pre-load the system by pulling down the spring
-        hanging_mass->move(-vector2_y * 0.1 * SCENE_HEIGHT);
-    }
-
-
-    // Stick-and-slip
-    for (int i(-20); i < 20; ++i) {
-        Vector2 placeholder(0.5 * SCENE_WIDTH + 2 * block_width * i, 4 * block_height);
-        bodydef.position = placeholder;
-        bodydef.type = STATIC;
-        m_world.add_body(bodydef, box);
-    }
-
-    bodydef.position = {0.5 * SCENE_WIDTH + 2 * 17 * block_width, 6 * block_height};
-    bodydef.type = KINEMATIC;
-    bodydef.velocity = {-0.5, 0};
-    RigidBody* tractor(m_world.add_body(bodydef, box));
-
-    bodydef.position = {0.5 * SCENE_WIDTH + 2 * 19 * block_width, tractor->get_p().y};
-    bodydef.type = DYNAMIC;
-    bodydef.velocity = vector2_zero;
-    RigidBody* pulled_mass(m_world.add_body(bodydef, box));
-
-    m_world.add_spring(tractor->get_p(), pulled_mass->get_p(), Spring::UNDAMPED, spring_stiffness_default);
-
-    m_world.disable_walls();
-    m_world.set_gravity(g);
-    m_settings.enable_gravity = 1;
-    m_settings.draw_body_trajectory = 0;
-}
-
 void Application::show_menubar() {
     if (ImGui::BeginMainMenuBar()) {
         if (ImGui::BeginMenu("Menu")) {
@@ -1095,6 +785,7 @@ bool Application::show_placeholder_object(RigidBody* obj) {
                         const char* items_body_type("STATIC\0KINEMATIC\0DYNAMIC\0");
                         if (ImGui::Combo("##Type", &new_body_type, items_body_type)) {
                             obj->set_type(static_cast<BodyType>(new_body_type));
+                            m_world.update_body(obj);
                         }
                     }
                     break;
@@ -1112,6 +803,7 @@ bool Application::show_placeholder_object(RigidBody* obj) {
             obj->rotate(deg2rad(values[7]) - obj->get_theta());
             obj->set_linear_vel(Vector2(values[5], values[6]));
             obj->set_angular_vel(values[8]);
+            m_world.update_body(obj);
         }
 
         ImGui::TreePop();
@@ -1300,6 +992,147 @@ void Application::show_osc_dynamics_plot(const Spring* osc) {
     ImGui::End();
 }
 
+void Application::show_counters_plot() {
+    if (!ImGui::Begin("Engine Counters")) {
+        ImGui::End();
+        return;
+    }
+
+    // Per-step values of the last steps
+    constexpr unsigned history(600);
+    enum { SAP_PAIRS, AABB_OVERLAPS, SAT_CALLS, CLIP_ONE, CLIP_FAILED, CONTACTS, WALL_HITS,
+           ALLOCATIONS, COUNT };
+    static const char* labels[COUNT] = {
+        "Broad phase pairs", "AABB overlaps", "SAT calls", "Clipped to one point",
+        "Clipping failed", "Contacts", "Wall hits", "Heap allocations"
+    };
+    static std::vector<float> values[COUNT];
+    static unsigned offset(0);
+
+    const World::Counters& counters(m_world.get_counters());
+    const NarrowPhaseStats& narrow(counters.narrow_phase);
+    if (m_ctrl.simulation.running) {
+        const float sample[COUNT] = {
+            (float)counters.broad_phase_pairs,
+            (float)counters.aabb_overlaps,
+            (float)narrow.sat_calls,
+            (float)narrow.clip_one,
+            (float)narrow.clip_failed,
+            (float)counters.contacts,
+            (float)counters.wall_hits,
+            (float)counters.allocations
+        };
+        for (unsigned i(0); i < COUNT; ++i) {
+            if (values[i].size() < history) {
+                values[i].push_back(sample[i]);
+            }else {
+                values[i][offset] = sample[i];
+            }
+        }
+        offset = values[0].size() < history ? 0 : (offset + 1) % history;
+    }
+
+    ImGui::Text("Last step: %u broad phase pairs, %u AABB tests, %u overlaps, %u collisions",
+                counters.broad_phase_pairs, counters.aabb_tests, counters.aabb_overlaps, counters.collisions);
+    ImGui::Text("GJK: %lu calls, %lu it. | EPA: %lu calls, %lu it. (max %lu), %lu watchdog",
+                (unsigned long)narrow.gjk_calls, (unsigned long)narrow.gjk_iterations,
+                (unsigned long)narrow.epa_calls, (unsigned long)narrow.epa_iterations,
+                (unsigned long)narrow.epa_max_iterations, (unsigned long)narrow.epa_watchdog);
+    ImGui::Text("Clip: %lu two, %lu one, %lu failed, %lu curved | %u contacts, %u wall hits",
+                (unsigned long)narrow.clip_two, (unsigned long)narrow.clip_one,
+                (unsigned long)narrow.clip_failed, (unsigned long)narrow.clip_curved,
+                counters.contacts, counters.wall_hits);
+    ImGui::Text("Heap allocations: %lu | Frame arena: %lu / %lu KB",
+                (unsigned long)counters.allocations, (unsigned long)m_world.get_frame_arena().get_peak() / 1024,
+                (unsigned long)m_world.get_frame_arena().get_capacity() / 1024);
+
+    for (unsigned i(0); i < COUNT; ++i) {
+        if (values[i].empty()) {
+            continue;
+        }
+        if (ImPlot::BeginPlot(labels[i], ImVec2(-1, 120))) {
+            ImPlot::SetupAxes(nullptr, "steps", ImPlotAxisFlags_AutoFit, ImPlotAxisFlags_AutoFit);
+            ImPlot::PlotHistogram(labels[i], values[i].data(), values[i].size());
+            ImPlot::EndPlot();
+        }
+    }
+
+    ImGui::End();
+}
+
+void Application::show_cost_attribution() {
+    if (!ImGui::Begin("Expensive Pairs")) {
+        ImGui::End();
+        return;
+    }
+
+    CostAttribution& costs(m_world.get_cost_attribution());
+    if (ImGui::Button("Reset")) {
+        costs.reset();
+    }
+
+    auto shape_name = [](const ShapeType type, const unsigned vertices) {
+        return type == CIRCLE ? std::string("circle") : std::to_string(vertices) + "-gon";
+    };
+
+    const ImGuiTableFlags flags(ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg);
+    ImGui::SeparatorText("Pairs (worst step)");
+    if (ImGui::BeginTable("##pairs", 9, flags)) {
+        for (const char* header : {"Bodies", "Shapes", "Time (us)", "Calls", "SAT", "Clip two", "Clip one",
+                                   "Clip failed", "Step"}) {
+            ImGui::TableSetupColumn(header);
+        }
+        ImGui::TableHeadersRow();
+        for (const auto& cost : costs.get_top_pairs()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%u - %u", cost.id_a, cost.id_b);
+            ImGui::TableNextColumn();
+            ImGui::Text("%s / %s", shape_name(cost.type_a, cost.vertices_a).c_str(),
+                                   shape_name(cost.type_b, cost.vertices_b).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", cost.time);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.sat_calls);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.clip_two);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.clip_one);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.clip_failed);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.step);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::SeparatorText("Bodies (worst step)");
+    if (ImGui::BeginTable("##bodies", 5, flags)) {
+        for (const char* header : {"Body", "Shape", "Time (us)", "Pairs", "Step"}) {
+            ImGui::TableSetupColumn(header);
+        }
+        ImGui::TableHeadersRow();
+        for (const auto& cost : costs.get_top_bodies()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.id);
+            ImGui::TableNextColumn();
+            ImGui::Text("%s", shape_name(cost.type, cost.vertices).c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f", cost.time);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.pairs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", cost.step);
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
 void Application::show_settings_panel() {
     ImGui::Begin("Settings");
     ImGui::BeginGroup();
@@ -1318,6 +1151,18 @@ void Application::show_settings_panel() {
     ImGui::Checkbox("Plot Position", &m_settings.plot_position);
     ImGui::Checkbox("Plot Velocity", &m_settings.plot_velocity);
     ImGui::Checkbox("Plot phase plane", &m_settings.plot_phase_plane);
+    ImGui::Checkbox("Plot engine counters", &m_settings.plot_counters);
+    int broad_phase(m_world.get_broad_phase());
+    ImGui::SetNextItemWidth(80);
+    if (ImGui::Combo("Broad phase", &broad_phase, broad_phase_names, BROAD_PHASE_COUNT)) {
+        m_world.set_broad_phase(static_cast<BroadPhaseType>(broad_phase));
+    }
+    bool attribution(m_world.is_cost_attribution_enabled());
+    if (ImGui::Checkbox("Attribute pair costs", &attribution)) {
+        m_world.enable_cost_attribution(attribution);
+        m_world.get_cost_attribution().reset();
+    }
+    ImGui::Checkbox("Highlight expensive pairs", &m_settings.highlight_expensive);
     ImGui::EndGroup();
     ImGui::End();
 }
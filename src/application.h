@@ -47,14 +47,6 @@ private:
 
     void create_scene_walls();
 
-    // Demos
-    void demo_collision();
-    void demo_stacking();
-    void demo_rigidbody();
-    void demo_double_pendulum();
-    void demo_springs();
-    void demo_simple_pendulum();
-
     // GUI
     void show_menubar();
     void show_main_overlay(const float avg_fps);
@@ -63,6 +55,8 @@ private:
     void show_property_editor();
     void show_obj_dynamics_plot(const RigidBody* obj);
     void show_osc_dynamics_plot(const Spring* osc);
+    void show_counters_plot();
+    void show_cost_attribution();
     void show_settings_panel();
     void show_help_panel();
 };  
@@ -1,86 +1,321 @@
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 #include "broad_phase.h"
 #include "rigid_body.h"
 #include "shape.h"
+#include "config.h"
 
-std::vector<BodyPair> SweepAndPrune::process() {
-    std::vector<BodyPair> possible_collisions;
-    std::vector<RigidBody*> active_intervall;
+#if defined(SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#   define SAP_SSE2
+#   include <emmintrin.h>
+#endif
 
-    if (1/*m_var_x >= m_var_y*/) {
-        sort_ascending_x(m_list);
-        for (unsigned i(0); i < m_list.size(); ++i) {
-            // Skip if the body is disabled
-            if (!m_list[i]->is_enabled()) {
+namespace {
+    constexpr size_t sap_padding(4);    // Width of the overlap tests of the sweep
+    // The sweep axis changes when the variance across it is this many times larger: a
+    // change sorts the static bodies again
+    constexpr double sap_axis_switch_ratio(1.2);
+
+    // Outward rounding: the float boxes contain the double ones
+    float round_down(const double x) {
+        const float f(x);
+        return f > x ? std::nextafter(f, -INFINITY) : f;
+    }
+
+    float round_up(const double x) {
+        const float f(x);
+        return f < x ? std::nextafter(f, INFINITY) : f;
+    }
+
+    // Integer with the same order as the float
+    uint32_t radix_key(const float f) {
+        uint32_t bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        return bits & 0x80000000u ? ~bits : bits | 0x80000000u;
+    }
+
+    /**
+     * @brief Least significant digit radix sort of the indices by key, 3 passes of 11 bits
+     */
+    void radix_sort(std::vector<uint32_t>& keys, std::vector<uint32_t>& indices,
+                    std::vector<uint32_t>& keys_tmp, std::vector<uint32_t>& indices_tmp) {
+        constexpr unsigned bits(11);
+        constexpr unsigned buckets(1 << bits);
+        const size_t n(keys.size());
+        keys_tmp.resize(n);
+        indices_tmp.resize(n);
+
+        uint32_t histograms[3][buckets] = {};
+        for (auto key : keys) {
+            for (unsigned pass(0); pass < 3; ++pass) {
+                ++histograms[pass][key >> (pass * bits) & (buckets - 1)];
+            }
+        }
+
+        for (unsigned pass(0); pass < 3; ++pass) {
+            uint32_t* histogram(histograms[pass]);
+            const unsigned shift(pass * bits);
+            // Same digit everywhere, nothing to do
+            if (n == 0 || histogram[keys[0] >> shift & (buckets - 1)] == n) {
                 continue;
             }
 
-            for (unsigned j(0); j < active_intervall.size(); ++j) {
-                if (m_list[i]->get_shape()->get_aabb().min.x > active_intervall[j]->get_shape()->get_aabb().max.x) {
-                    active_intervall.erase(active_intervall.begin() +j);
-                    --j;
-                }else {
-                    possible_collisions.push_back({m_list[i], active_intervall[j]});
-                }
+            uint32_t sum(0);
+            for (unsigned b(0); b < buckets; ++b) {
+                const uint32_t count(histogram[b]);
+                histogram[b] = sum;
+                sum += count;
+            }
+            for (size_t i(0); i < n; ++i) {
+                const uint32_t position(histogram[keys[i] >> shift & (buckets - 1)]++);
+                keys_tmp[position] = keys[i];
+                indices_tmp[position] = indices[i];
             }
-            active_intervall.push_back(m_list[i]);
+            keys.swap(keys_tmp);
+            indices.swap(indices_tmp);
+        }
+    }
+}
+
+void SweepAndPrune::update() {
+    // The bodies are read once, in the order of the list
+    m_aabbs.resize(m_list.size());
+    m_filters.resize(m_list.size());
+    for (size_t i(0); i < m_list.size(); ++i) {
+        m_aabbs[i] = m_list[i]->get_swept_aabb();
+        m_filters[i] = m_list[i]->get_filter();
+    }
+    choose_axis();
+
+    if (m_static_changed) {
+        m_static_aabbs.resize(m_static.size());
+        m_static_filters.resize(m_static.size());
+        for (size_t i(0); i < m_static.size(); ++i) {
+            m_static_aabbs[i] = m_static[i]->get_swept_aabb();
+            m_static_filters[i] = m_static[i]->get_filter();
         }
+        sort_boxes(m_static, m_static_aabbs, m_static_filters, m_static_boxes);
+        m_static_changed = 0;
+    }
+    sort_boxes(m_list, m_aabbs, m_filters, m_boxes);
+}
+
+void SweepAndPrune::process(std::vector<BodyPair>& possible_collisions) {
+    possible_collisions.clear();
+    update();
+
+    const Boxes& moving(m_boxes);
+    const Boxes& fixed(m_static_boxes);
+
+    // Moving against moving
+    for (size_t i(0); i < moving.count; ++i) {
+        sweep(moving, i, moving, i + 1, possible_collisions);
+    }
+
+    // Moving against the static boxes starting at the same place or after, and static
+    // against the moving boxes starting strictly after: each pair is found once
+    size_t k(0);
+    for (size_t i(0); i < moving.count; ++i) {
+        while (k < fixed.count && fixed.lower[k] < moving.lower[i]) {
+            ++k;
+        }
+        sweep(moving, i, fixed, k, possible_collisions);
+    }
+    k = 0;
+    for (size_t i(0); i < fixed.count; ++i) {
+        while (k < moving.count && moving.lower[k] <= fixed.lower[i]) {
+            ++k;
+        }
+        sweep(fixed, i, moving, k, possible_collisions);
+    }
+}
+
+void SweepAndPrune::query(const AABB& aabb, std::vector<RigidBody*>& bodies) const {
+    // Sweep axis first, rounded outwards like the boxes
+    const std::array<float, 4> bounds = {
+        round_down(m_axis ? aabb.min.y : aabb.min.x),
+        round_up(m_axis ? aabb.max.y : aabb.max.x),
+        round_down(m_axis ? aabb.min.x : aabb.min.y),
+        round_up(m_axis ? aabb.max.x : aabb.max.y)
+    };
+    query(m_boxes, bounds, bodies);
+    query(m_static_boxes, bounds, bodies);
+}
+
+void SweepAndPrune::add_body(RigidBody* body) {
+    if (!body->is_enabled()) {
+        return;
+    }
+    if (body->is_static()) {
+        m_static.push_back(body);
+        m_static_changed = 1;
     }else {
-        // TODO: Fix Y-axis causing weird behavior during collision resolution
-        sort_ascending_y(m_list);
-        for (unsigned i(0); i < m_list.size(); ++i) {
-            // Skip if the body is disabled
-            if (!m_list[i]->is_enabled()) {
-                continue;
-            }
-                
-            for (unsigned j(0); j < active_intervall.size(); ++j) {
-                if (m_list[i]->get_shape()->get_aabb().min.y > active_intervall[j]->get_shape()->get_aabb().max.y) {
-                    active_intervall.erase(active_intervall.begin() +j);
-                    --j;
-                }else {
-                    possible_collisions.push_back({m_list[i], active_intervall[j]});
+        m_list.push_back(body);
+    }
+}
+
+void SweepAndPrune::remove_body(RigidBody* body) {
+    auto it(std::find(m_list.begin(), m_list.end(), body));
+    if (it != m_list.end()) {
+        m_list.erase(it);
+        return;
+    }
+    it = std::find(m_static.begin(), m_static.end(), body);
+    if (it != m_static.end()) {
+        m_static.erase(it);
+        m_static_changed = 1;
+    }
+}
+
+void SweepAndPrune::clear() {
+    m_list.clear();
+    m_static.clear();
+    m_static_changed = 1;
+}
+
+void SweepAndPrune::sort_boxes(const std::vector<RigidBody*>& list, const std::vector<AABB>& aabbs,
+                               const std::vector<CollisionFilter>& filters, Boxes& boxes) {
+    const unsigned axis(m_axis);
+    const size_t n(list.size());
+    m_keys.resize(n);
+    m_indices.resize(n);
+    for (size_t i(0); i < n; ++i) {
+        m_keys[i] = radix_key(round_down(axis ? aabbs[i].min.y : aabbs[i].min.x));
+        m_indices[i] = i;
+    }
+    radix_sort(m_keys, m_indices, m_keys_tmp, m_indices_tmp);
+
+    boxes.count = n;
+    boxes.lower.resize(n + sap_padding);
+    boxes.upper.resize(n + sap_padding);
+    boxes.cross_lower.resize(n + sap_padding);
+    boxes.cross_upper.resize(n + sap_padding);
+    boxes.filters.resize(n + sap_padding);
+    boxes.bodies.resize(n + sap_padding);
+    for (size_t i(0); i < n; ++i) {
+        const AABB& aabb(aabbs[m_indices[i]]);
+        boxes.lower[i] = round_down(axis ? aabb.min.y : aabb.min.x);
+        boxes.upper[i] = round_up(axis ? aabb.max.y : aabb.max.x);
+        boxes.cross_lower[i] = round_down(axis ? aabb.min.x : aabb.min.y);
+        boxes.cross_upper[i] = round_up(axis ? aabb.max.x : aabb.max.y);
+        boxes.filters[i] = filters[m_indices[i]];
+        boxes.bodies[i] = list[m_indices[i]];
+    }
+    boxes.max_extent = 0;
+    for (size_t i(0); i < n; ++i) {
+        boxes.max_extent = std::max(boxes.max_extent, boxes.upper[i] - boxes.lower[i]);
+    }
+    for (size_t i(n); i < n + sap_padding; ++i) {
+        boxes.lower[i] = INFINITY;
+        boxes.upper[i] = -INFINITY;
+        boxes.cross_lower[i] = INFINITY;
+        boxes.cross_upper[i] = -INFINITY;
+        boxes.bodies[i] = nullptr;
+    }
+}
+
+void SweepAndPrune::sweep(const Boxes& a, const size_t i, const Boxes& b, size_t j,
+                          std::vector<BodyPair>& pairs) {
+    // The boxes of b from j on start after box i on the sweep axis: they overlap it on this
+    // axis as long as they start before its end, the sweep stops at the first one after
+#ifdef SAP_SSE2
+    const __m128 upper(_mm_set1_ps(a.upper[i]));
+    const __m128 cross_lower(_mm_set1_ps(a.cross_lower[i]));
+    const __m128 cross_upper(_mm_set1_ps(a.cross_upper[i]));
+    while (true) {
+        const int in_sweep(_mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&b.lower[j]), upper)));
+        if (!in_sweep) {
+            break;
+        }
+        const __m128 in_cross(_mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&b.cross_lower[j]), cross_upper),
+                                     _mm_cmple_ps(cross_lower, _mm_loadu_ps(&b.cross_upper[j]))));
+        const int mask(in_sweep & _mm_movemask_ps(in_cross));
+        if (mask) {
+            for (unsigned k(0); k < sap_padding; ++k) {
+                if (mask & (1 << k) && should_collide(a.filters[i], b.filters[j + k])) {
+                    pairs.push_back({a.bodies[i], b.bodies[j + k]});
                 }
             }
-            active_intervall.push_back(m_list[i]);
         }
+        if (in_sweep != 0xF) {
+            break;
+        }
+        j += sap_padding;
     }
-        
-    return possible_collisions;
+#else
+    for (; b.lower[j] <= a.upper[i]; ++j) {
+        if (b.cross_lower[j] <= a.cross_upper[i] && a.cross_lower[i] <= b.cross_upper[j]
+         && should_collide(a.filters[i], b.filters[j])) {
+            pairs.push_back({a.bodies[i], b.bodies[j]});
+        }
+    }
+#endif
 }
 
-void SweepAndPrune::update_list(const std::vector<RigidBody*>& list) {
-    m_list = list;
+void SweepAndPrune::query(const Boxes& boxes, const std::array<float, 4>& bounds,
+                          std::vector<RigidBody*>& bodies) {
+    // The boxes overlapping the bounds start at most max_extent before them
+    const auto end(boxes.lower.begin() + boxes.count);
+    size_t j(std::lower_bound(boxes.lower.begin(), end, bounds[0] - boxes.max_extent) - boxes.lower.begin());
+    for (; j < boxes.count && boxes.lower[j] <= bounds[1]; ++j) {
+        if (bounds[0] <= boxes.upper[j] && boxes.cross_lower[j] <= bounds[3] && bounds[2] <= boxes.cross_upper[j]) {
+            bodies.push_back(boxes.bodies[j]);
+        }
+    }
 }
 
 void SweepAndPrune::choose_axis() {
     m_var_x = 0;
     m_var_y = 0;
+    if (m_aabbs.empty()) {
+        return;
+    }
 
     double sum_x(0), sum_y(0);
-    for (auto body : m_list) {
-        sum_x += body->get_p().x;
-        sum_y += body->get_p().y;
+    for (const auto& aabb : m_aabbs) {
+        sum_x += aabb.min.x + aabb.max.x;
+        sum_y += aabb.min.y + aabb.max.y;
     }
-    double mean_x(sum_x / m_list.size());
-    double mean_y(sum_y / m_list.size());
-    for (auto body : m_list) {
-        m_var_x += pow(body->get_p().x - mean_x, 2);
-        m_var_y += pow(body->get_p().y - mean_y, 2);
+    double mean_x(0.5 * sum_x / m_aabbs.size());
+    double mean_y(0.5 * sum_y / m_aabbs.size());
+    for (const auto& aabb : m_aabbs) {
+        m_var_x += pow(0.5 * (aabb.min.x + aabb.max.x) - mean_x, 2);
+        m_var_y += pow(0.5 * (aabb.min.y + aabb.max.y) - mean_y, 2);
     }
-}
 
-void SweepAndPrune::sort_ascending_x(std::vector<RigidBody*>& list) {
-    std::sort(list.begin(), list.end(), [=](RigidBody* a, RigidBody* b)->bool {
-        return a->get_shape()->get_aabb().min.x < b->get_shape()->get_aabb().min.x;
-    }); 
+    const double var_sweep(m_axis ? m_var_y : m_var_x);
+    const double var_cross(m_axis ? m_var_x : m_var_y);
+    if (var_cross > sap_axis_switch_ratio * var_sweep) {
+        m_axis = 1 - m_axis;
+        m_static_changed = 1;
+    }
 }
 
-void SweepAndPrune::sort_ascending_y(std::vector<RigidBody*>& list) {
-    std::sort(list.begin(), list.end(), [=](RigidBody* a, RigidBody* b)->bool {
-        return a->get_shape()->get_aabb().min.y < b->get_shape()->get_aabb().min.y;
-    }); 
+// The contacts are resolved one after the other, in the order of the pairs
+void PairSorter::sort(std::vector<BodyPair>& pairs) {
+    const size_t n(pairs.size());
+    m_keys.resize(n);
+    m_indices.resize(n);
+    for (size_t i(0); i < n; ++i) {
+        if (pairs[i][0]->get_id() > pairs[i][1]->get_id()) {
+            std::swap(pairs[i][0], pairs[i][1]);
+        }
+        m_keys[i] = pairs[i][1]->get_id();
+        m_indices[i] = i;
+    }
+    // Stable: by the second id, then by the first one
+    radix_sort(m_keys, m_indices, m_keys_tmp, m_indices_tmp);
+    for (size_t i(0); i < n; ++i) {
+        m_keys[i] = pairs[m_indices[i]][0]->get_id();
+    }
+    radix_sort(m_keys, m_indices, m_keys_tmp, m_indices_tmp);
+
+    m_sorted_pairs.resize(n);
+    for (size_t i(0); i < n; ++i) {
+        m_sorted_pairs[i] = pairs[m_indices[i]];
+    }
+    pairs.swap(m_sorted_pairs);
 }
 
 
@@ -92,3 +327,26 @@ bool AABB_overlap(const AABB& a, const AABB& b) {
 
     return !(d1x > 0.0 || d1y > 0.0 || d2x > 0.0 || d2y > 0.0);
 }
+
+BroadPhaseType choose_broad_phase(const std::vector<RigidBody*>& bodies) {
+    if (bodies.size() < spatial_hash_min_bodies) {
+        return BROAD_PHASE_INCREMENTAL_SAP;
+    }
+
+    std::vector<double> sizes;
+    sizes.reserve(bodies.size());
+    for (auto body : bodies) {
+        const AABB aabb(body->get_shape()->get_aabb());
+        sizes.push_back(std::max(aabb.max.x - aabb.min.x, aabb.max.y - aabb.min.y));
+    }
+    std::vector<double>::iterator median(sizes.begin() + sizes.size() / 2);
+    std::nth_element(sizes.begin(), median, sizes.end());
+
+    const double median_size(*median);
+    const size_t uniform(std::count_if(sizes.begin(), sizes.end(), [=](double size)->bool {
+        return size >= 0.5 * median_size && size <= 2 * median_size;
+    }));
+
+    return uniform >= spatial_hash_uniform_fraction * sizes.size()
+        ? BROAD_PHASE_SPATIAL_HASH : BROAD_PHASE_INCREMENTAL_SAP;
+}
@@ -1,33 +1,177 @@
 #ifndef BROAD_PHASE_H
 #define BROAD_PHASE_H
 
+#include <cstdint>
 #include <vector>
 #include <array>
+#include "rigid_body.h" // CollisionFilter
+#include "shape.h"   // AABB
 #include "vector2.h"
 
-struct AABB;
 class RigidBody;
 
 typedef std::array<RigidBody*, 2> BodyPair;
 
-class SweepAndPrune {
+enum BroadPhaseType {
+    BROAD_PHASE_SAP,
+    BROAD_PHASE_TREE,
+    BROAD_PHASE_INCREMENTAL_SAP,
+    BROAD_PHASE_SPATIAL_HASH,
+    BROAD_PHASE_HIERARCHICAL_GRID,
+    BROAD_PHASE_AUTO,           // One of the above, chosen from the body sizes
+    BROAD_PHASE_COUNT
+};
+
+// Names of the broad phases, as given on the command line of the tools
+constexpr const char* broad_phase_names[BROAD_PHASE_COUNT] = {
+    "sap", "tree", "incremental_sap", "spatial_hash", "hierarchical_grid", "auto"
+};
+
+// Bodies larger than this many times the median size are kept out of the spatial hash grid
+constexpr double spatial_hash_large_ratio(4);
+// The spatial hash is chosen automatically from this many bodies...
+constexpr unsigned spatial_hash_min_bodies(256);
+// ...when this fraction of them is within a factor 2 of the median size
+constexpr double spatial_hash_uniform_fraction(0.9);
+// Growth of the swept bounding boxes (meters) for the small velocity changes of a frame
+// that gravity and the force fields do not account for. Larger ones, from contacts and
+// springs, take the bodies out of their boxes and make World::step pair them again.
+constexpr double swept_aabb_margin(0.01);
+
+class BroadPhase {
 public:
-    SweepAndPrune() : m_var_x(0), m_var_y(0) {}
-    virtual ~SweepAndPrune() {}
+    virtual ~BroadPhase() {}
 
-    void choose_axis();
-    std::vector<BodyPair> process();
-    void update_list(const std::vector<RigidBody*>& list);
+    /**
+     * @brief Finds the pairs of bodies whose bounding boxes may overlap, after an update.
+     * The bounding boxes are swept over the frame (see RigidBody::sweep), so that the pairs
+     * hold for the substeps until a body leaves its box
+     * @param pairs Cleared then filled, its capacity is reused from one step to the next
+     */
+    virtual void process(std::vector<BodyPair>& pairs) = 0;
+    /**
+     * @brief Brings the structure to the current bounds of the bodies, without pairing them
+     */
+    virtual void update() = 0;
+    /**
+     * @brief Appends the bodies whose bounding boxes may overlap the box, as of the last update
+     */
+    virtual void query(const AABB& aabb, std::vector<RigidBody*>& bodies) const = 0;
+
+    /**
+     * @brief Starts pairing a body. Static bodies are never paired together, and disabled
+     * bodies are not paired at all
+     */
+    virtual void add_body(RigidBody* body) = 0;
+    /**
+     * @brief Stops pairing a body, must be called before the body is destroyed
+     */
+    virtual void remove_body(RigidBody* body) = 0;
+    /**
+     * @brief Takes a change of type of a body, or a move of a static body outside of the
+     * step, into account: the static bodies are only sorted again when they change
+     */
+    virtual void update_body(RigidBody* body) { remove_body(body); add_body(body); }
+    virtual void clear() = 0;
+};
+
+/**
+ * @brief Sweep and prune on packed arrays.
+ * The bounds of the bodies are copied into structure of arrays, in float rounded outwards,
+ * and radix sorted by lower bound on the axis where the bodies spread the most. Each box
+ * is then swept forward against the boxes starting within its extent, testing the overlap
+ * across the axis of several of them at once.
+ */
+class SweepAndPrune : public BroadPhase {
+public:
+    SweepAndPrune() : m_var_x(0), m_var_y(0), m_axis(0), m_static_changed(1) {}
+
+    /**
+     * @brief Finds the pairs of bodies whose bounding boxes overlap, the static bodies
+     * are swept against the moving ones without being paired together
+     */
+    void process(std::vector<BodyPair>& pairs) override;
+    void update() override;
+    void query(const AABB& aabb, std::vector<RigidBody*>& bodies) const override;
+    void add_body(RigidBody* body) override;
+    void remove_body(RigidBody* body) override;
+    void clear() override;
+
+    // Sweep axis of the last process, 0 for x and 1 for y
+    unsigned get_axis() const { return m_axis; }
 private:
-    std::vector<RigidBody*> m_list;
+    // Bounds on the sweep axis and across it, sorted by lower bound and followed by
+    // sap_padding boxes overlapping nothing
+    struct Boxes {
+        std::vector<float> lower;
+        std::vector<float> upper;
+        std::vector<float> cross_lower;
+        std::vector<float> cross_upper;
+        std::vector<CollisionFilter> filters;
+        std::vector<RigidBody*> bodies;
+        size_t count = 0;
+        float max_extent = 0;           // Largest upper - lower
+    };
+
+    std::vector<RigidBody*> m_list;     // Moving bodies
+    std::vector<RigidBody*> m_static;
+    Boxes m_boxes;                      // Sorted every step
+    Boxes m_static_boxes;               // Sorted when the static bodies or the axis change only
     double m_var_x;
     double m_var_y;
+    unsigned m_axis;
+    bool m_static_changed;
+
+    // Scratch buffers, kept for their capacity
+    std::vector<AABB> m_aabbs;
+    std::vector<AABB> m_static_aabbs;
+    std::vector<CollisionFilter> m_filters;
+    std::vector<CollisionFilter> m_static_filters;
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_indices;
+    std::vector<uint32_t> m_keys_tmp;
+    std::vector<uint32_t> m_indices_tmp;
+
+    /**
+     * @brief Picks the axis of largest variance of the centers of the moving bodies
+     */
+    void choose_axis();
+    void sort_boxes(const std::vector<RigidBody*>& list, const std::vector<AABB>& aabbs,
+                    const std::vector<CollisionFilter>& filters, Boxes& boxes);
+    /**
+     * @brief Pairs box i of a with the boxes of b from j on that overlap it and pass the
+     * collision filters, the boxes of b must start after box i on the sweep axis
+     */
+    static void sweep(const Boxes& a, const size_t i, const Boxes& b, size_t j,
+                      std::vector<BodyPair>& pairs);
+    static void query(const Boxes& boxes, const std::array<float, 4>& bounds,
+                      std::vector<RigidBody*>& bodies);
+};
 
-    void sort_ascending_x(std::vector<RigidBody*>& list);
-    void sort_ascending_y(std::vector<RigidBody*>& list);
+/**
+ * @brief Sorts the broad phase pairs by body ids, so that the order in which the contacts
+ * are resolved does not depend on the broad phase in use
+ */
+class PairSorter {
+public:
+    // Lower id first in each pair, pairs by ascending ids
+    void sort(std::vector<BodyPair>& pairs);
+private:
+    // Scratch buffers, kept for their capacity
+    std::vector<uint32_t> m_keys;
+    std::vector<uint32_t> m_indices;
+    std::vector<uint32_t> m_keys_tmp;
+    std::vector<uint32_t> m_indices_tmp;
+    std::vector<BodyPair> m_sorted_pairs;
 };
 
 bool AABB_overlap(const AABB& a, const AABB& b);
 
+/**
+ * @brief Chooses the broad phase for BROAD_PHASE_AUTO: the spatial hash for many bodies of
+ * about the same size, the incremental sweep and prune otherwise
+ */
+BroadPhaseType choose_broad_phase(const std::vector<RigidBody*>& bodies);
+
 
 #endif /* BROADPHASE_H */
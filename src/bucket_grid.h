@@ -0,0 +1,64 @@
+// Cells of a spatial hash
+//
+// Storage shared by the grid broad phases: every build counting sorts the entries by the
+// bucket of their cell, so the entries of a cell are contiguous and a cell is looked up by
+// scanning its bucket. Several cells may share a bucket, the callers compare the cells.
+
+#ifndef BUCKET_GRID_H
+#define BUCKET_GRID_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief Entries sorted by bucket, Entry having an unsigned bucket member
+ */
+template <typename Entry>
+struct BucketGrid {
+    unsigned mask = 0;
+    std::vector<Entry> cells;       // Entries sorted by bucket
+    std::vector<unsigned> starts;   // First entry of each bucket in cells, and the end
+
+    /**
+     * @brief Counting sorts the entries into twice as many buckets
+     * @param entries Their bucket is set
+     * @param bucket_of Bucket of an entry, hashed with the mask of the grid already set
+     */
+    template <typename BucketFunction>
+    void build(std::vector<Entry>& entries, BucketFunction bucket_of) {
+        unsigned bucket_count(1);
+        while (bucket_count < 2 * entries.size()) {
+            bucket_count <<= 1;
+        }
+        mask = bucket_count - 1;
+        starts.assign(bucket_count + 1, 0);
+        for (auto& entry : entries) {
+            entry.bucket = bucket_of(entry);
+            ++starts[entry.bucket + 1];
+        }
+        for (unsigned b(0); b < bucket_count; ++b) {
+            starts[b + 1] += starts[b];
+        }
+        cells.resize(entries.size());
+        for (const auto& entry : entries) {
+            // starts[b] ends as the end of bucket b - 1, before being shifted back below
+            cells[starts[entry.bucket]++] = entry;
+        }
+        for (unsigned b(bucket_count); b > 0; --b) {
+            starts[b] = starts[b - 1];
+        }
+        starts[0] = 0;
+    }
+
+    /**
+     * @brief Calls f on the entries of a bucket from position first on
+     */
+    template <typename F>
+    void for_each_in_bucket(const unsigned bucket, const unsigned first, F f) const {
+        for (unsigned k(std::max(first, starts[bucket])); k < starts[bucket + 1]; ++k) {
+            f(cells[k]);
+        }
+    }
+};
+
+#endif /* BUCKET_GRID_H */
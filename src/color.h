@@ -0,0 +1,21 @@
+#ifndef COLOR_H
+#define COLOR_H
+
+#include <cstdint>
+
+// RGBA color, layout compatible with SDL_Color so the engine stays renderer agnostic
+struct Color {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+const Color static_body_color({255, 255, 255, 255});
+const Color kinematic_body_color({189, 183, 107, 255});
+const Color dynamic_body_color({255, 180, 180, 255});
+const Color focus_color({255, 0, 255, 255});
+const Color spring_color({160, 160, 160, 255});
+const Color expensive_color({255, 64, 0, 255});
+
+#endif /* COLOR_H */
@@ -8,7 +8,18 @@
 
 #define IM_EULER
 
+// Hierarchical zone profiler (see profiler.h), compiled out when undefined
+#define PROFILER
+
+// SSE2 overlap tests in the sweep and prune, scalar when undefined or unavailable
+#define SIMD
+
 #ifdef DEBUG
+// Counts the heap allocations made during each step (see allocation_counter.h), also set by
+// the PHYSICS2D_ALLOCATION_COUNTER option of CMake for the other builds
+#   ifndef ALLOCATION_COUNTER
+#       define ALLOCATION_COUNTER
+#   endif
 #   ifdef FRICTION
 #       define DEBUG_FRICTION
 #   endif
@@ -19,6 +30,10 @@ constexpr unsigned min_substeps(1);
 constexpr unsigned max_substeps(50);
 constexpr double max_time_step(1.0 / 60.0);
 
+// Default simulation area (meters), the demo application fits it to the screen
+constexpr double scene_width_default(25);
+constexpr double scene_height_default(scene_width_default * 9.0 / 16.0);
+
 constexpr double g(9.81);
 constexpr double air_viscosity(1.48e-5);
 
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include "cost_attribution.h"
+#include "profiler.h"
+#include "rigid_body.h"
+
+namespace {
+    template <typename T>
+    bool more_expensive(const T& a, const T& b) {
+        return a.time > b.time;
+    }
+
+    uint64_t pair_key(const BodyPair& pair) {
+        return (uint64_t)pair[0]->get_id() << 32 | pair[1]->get_id();
+    }
+
+    /**
+     * @brief Inserts a cost in a top-N table, or replaces the entry with the same key if cheaper
+     */
+    template <typename T, typename SameKey>
+    void insert_top(std::vector<T>& table, const T& cost, SameKey same_key) {
+        auto entry(std::find_if(table.begin(), table.end(), same_key));
+        if (entry != table.end()) {
+            if (cost.time <= entry->time) {
+                return;
+            }
+            table.erase(entry);
+        }else if (table.size() >= cost_top_count) {
+            if (cost.time <= table.back().time) {
+                return;
+            }
+            table.pop_back();
+        }
+        table.insert(std::upper_bound(table.begin(), table.end(), cost, more_expensive<T>), cost);
+    }
+}
+
+CostAttribution::CostAttribution()
+:   m_steps(0)
+{}
+
+void CostAttribution::begin_step(const std::vector<BodyPair>& pairs) {
+    m_samples.assign(pairs.size(), Sample());
+    for (size_t i(0); i < pairs.size(); ++i) {
+        m_samples[i].pair = pairs[i];
+    }
+}
+
+void CostAttribution::rebase(const std::vector<BodyPair>& pairs) {
+    // The dropped samples at the end are out of order
+    m_previous.swap(m_samples);
+    std::sort(m_previous.begin(), m_previous.end(), [](const Sample& a, const Sample& b) {
+        return pair_key(a.pair) < pair_key(b.pair);
+    });
+    begin_step(pairs);
+
+    // Merge of the two sorted lists
+    size_t j(0);
+    for (size_t i(0); i < pairs.size(); ++i) {
+        const uint64_t key(pair_key(pairs[i]));
+        for (; j < m_previous.size() && pair_key(m_previous[j].pair) < key; ++j) {
+            if (m_previous[j].calls) {
+                m_samples.push_back(m_previous[j]);
+            }
+        }
+        if (j < m_previous.size() && pair_key(m_previous[j].pair) == key) {
+            m_samples[i] = m_previous[j++];
+        }
+    }
+    for (; j < m_previous.size(); ++j) {
+        if (m_previous[j].calls) {
+            m_samples.push_back(m_previous[j]);
+        }
+    }
+}
+
+void CostAttribution::end_step() {
+    const double us_per_tick(profiler().get_us_per_tick());
+    m_bodies.clear();
+
+    m_last_pairs.clear();
+    for (const Sample& sample : m_samples) {
+        if (sample.calls == 0) {
+            continue;
+        }
+
+        const BodyPair& pair(sample.pair);
+        const Shape* shape_a(pair[0]->get_shape());
+        const Shape* shape_b(pair[1]->get_shape());
+
+        PairCost cost;
+        cost.id_a = pair[0]->get_id();
+        cost.id_b = pair[1]->get_id();
+        cost.type_a = shape_a->get_type();
+        cost.type_b = shape_b->get_type();
+        cost.vertices_a = shape_a->get_count();
+        cost.vertices_b = shape_b->get_count();
+        cost.time = sample.ticks * us_per_tick;
+        cost.calls = sample.calls;
+        cost.sat_calls = sample.sat_calls;
+        cost.clip_two = sample.clip_two;
+        cost.clip_one = sample.clip_one;
+        cost.clip_failed = sample.clip_failed;
+        cost.step = m_steps;
+
+        insert_top(m_last_pairs, cost, [](const PairCost&) { return false; });
+        insert_top(m_top_pairs, cost, [&](const PairCost& entry) {
+            return entry.id_a == cost.id_a && entry.id_b == cost.id_b;
+        });
+
+        // Both bodies are charged the full cost of the pair
+        for (unsigned k(0); k < 2; ++k) {
+            BodyCost body;
+            body.id = k ? cost.id_b : cost.id_a;
+            body.type = k ? cost.type_b : cost.type_a;
+            body.vertices = k ? cost.vertices_b : cost.vertices_a;
+            body.time = cost.time;
+            body.pairs = 1;
+            body.step = m_steps;
+            m_bodies.push_back(body);
+        }
+    }
+
+    // Sum the costs of each body
+    std::sort(m_bodies.begin(), m_bodies.end(), [](const BodyCost& a, const BodyCost& b) {
+        return a.id < b.id;
+    });
+    for (size_t i(0); i < m_bodies.size();) {
+        BodyCost cost(m_bodies[i]);
+        for (++i; i < m_bodies.size() && m_bodies[i].id == cost.id; ++i) {
+            cost.time += m_bodies[i].time;
+            ++cost.pairs;
+        }
+        insert_top(m_top_bodies, cost, [&](const BodyCost& other) { return other.id == cost.id; });
+    }
+
+    ++m_steps;
+}
+
+void CostAttribution::reset() {
+    m_samples.clear();
+    m_previous.clear();
+    m_bodies.clear();
+    m_last_pairs.clear();
+    m_top_pairs.clear();
+    m_top_bodies.clear();
+    m_steps = 0;
+}
@@ -0,0 +1,107 @@
+#ifndef COST_ATTRIBUTION_H
+#define COST_ATTRIBUTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "broad_phase.h" // BodyPair
+#include "narrow_phase.h" // NarrowPhaseStats
+#include "shape.h"       // ShapeType
+
+constexpr unsigned cost_top_count(10);
+
+// Narrow phase and response cost of a body pair during one step
+struct PairCost {
+    unsigned id_a = 0;
+    unsigned id_b = 0;
+    ShapeType type_a = CIRCLE;
+    ShapeType type_b = CIRCLE;
+    unsigned vertices_a = 0;
+    unsigned vertices_b = 0;
+    double time = 0;                // Microseconds, summed over the substeps
+    unsigned calls = 0;             // Narrow phase calls
+    unsigned sat_calls = 0;         // Polygon/polygon calls
+    unsigned clip_two = 0;          // Outcomes of the contact points computation, a degenerate
+    unsigned clip_one = 0;          // pair keeps failing or finding a single point
+    unsigned clip_failed = 0;
+    unsigned step = 0;              // Step in which the cost was measured
+};
+
+// Cost of the pairs of a body during one step
+struct BodyCost {
+    unsigned id = 0;
+    ShapeType type = CIRCLE;
+    unsigned vertices = 0;
+    double time = 0;                // Microseconds
+    unsigned pairs = 0;             // Pairs that reached the narrow phase
+    unsigned step = 0;
+};
+
+/**
+ * @brief Attributes the narrow phase and response time of a step to body pairs and bodies,
+ * and keeps the most expensive ones in top-N tables.
+ * The samples are indexed by the position of the pair in the broad phase output, sorted
+ * by body ids. When the broad phase runs again during the step, the samples are moved to
+ * the new positions of their pairs (see rebase).
+ */
+class CostAttribution {
+public:
+    CostAttribution();
+
+    void begin_step(const std::vector<BodyPair>& pairs);
+    /**
+     * @brief Follows the pairs to their positions in a new broad phase output of the step.
+     * The samples of the pairs no longer in it are kept for end_step.
+     * @param pairs The new broad phase output, sorted by body ids
+     */
+    void rebase(const std::vector<BodyPair>& pairs);
+
+    /**
+     * @brief Charges a narrow phase call to a pair
+     * @param before, after The narrow phase counters around the call
+     */
+    inline void add(const size_t pair_index, const uint64_t ticks, const NarrowPhaseStats& before,
+                    const NarrowPhaseStats& after) {
+        Sample& sample(m_samples[pair_index]);
+        sample.ticks += ticks;
+        ++sample.calls;
+        sample.sat_calls += after.sat_calls - before.sat_calls;
+        sample.clip_two += after.clip_two - before.clip_two;
+        sample.clip_one += after.clip_one - before.clip_one;
+        sample.clip_failed += after.clip_failed - before.clip_failed;
+    }
+
+    /**
+     * @brief Converts the samples of the step into costs and updates the tables
+     */
+    void end_step();
+
+    void reset();
+
+    // Most expensive pairs of the last step, most expensive first
+    const std::vector<PairCost>& get_last_pairs() const { return m_last_pairs; }
+    // Most expensive single-step costs since the last reset, one entry per pair
+    const std::vector<PairCost>& get_top_pairs() const { return m_top_pairs; }
+    // Same for bodies
+    const std::vector<BodyCost>& get_top_bodies() const { return m_top_bodies; }
+private:
+    struct Sample {
+        BodyPair pair{};
+        uint64_t ticks = 0;
+        unsigned calls = 0;
+        unsigned sat_calls = 0;
+        unsigned clip_two = 0;
+        unsigned clip_one = 0;
+        unsigned clip_failed = 0;
+    };
+
+    std::vector<Sample> m_samples;      // Of the pairs of the broad phase, then the dropped ones
+    std::vector<Sample> m_previous;     // Scratch buffer of rebase
+    std::vector<BodyCost> m_bodies;     // One entry per body of each sampled pair
+    std::vector<PairCost> m_last_pairs;
+    std::vector<PairCost> m_top_pairs;
+    std::vector<BodyCost> m_top_bodies;
+    unsigned m_steps;
+};
+
+#endif /* COST_ATTRIBUTION_H */
@@ -0,0 +1,261 @@
+#include <SDL_render.h>
+#include <cmath>
+#include "world.h"
+#include "rigid_body.h"
+#include "shape.h"
+#include "link.h"
+#include "narrow_phase.h"
+#include "settings.h"
+#include "transform2.h"
+#include "render.h"
+#include "vector2.h"
+
+/*
+ * Rendering of the engine objects. The physics core does not depend on SDL,
+ * so these members are only defined (and linked) by the demo application.
+ */
+
+void World::render(SDL_Renderer* renderer, bool running, Settings& settings) {
+    // Draw world boundaries
+    if (walls_enabled) {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 127);
+        render_line(renderer, {0, m_scene_height}, {0, 0});
+        render_line(renderer, {0, 0}, {m_scene_width, 0});
+        render_line(renderer, {m_scene_width, 0}, {m_scene_width, m_scene_height});
+        render_line(renderer, {m_scene_width, m_scene_height}, {0, m_scene_height});
+    }
+
+    if (body_count > 0 && focus >= 0) {
+        m_bodies[focus]->colorize(focus_color);
+        if (settings.draw_body_trajectory) {
+            m_bodies[focus]->draw_trail(renderer, running);
+        }
+    }
+    for (auto id : m_trail_register_id) {
+        if (id == focus) {
+            continue;
+        }
+        RigidBody* body(get_body(id));
+        if (body) {
+            body->draw_trail(renderer, running);
+        }
+    }
+
+    for (auto& body : m_bodies) {
+        body->draw(renderer);
+        body->reset_color();
+    }
+
+    if (settings.draw_center_of_mass) {
+        for (auto body :m_bodies) {
+            body->draw_com(renderer);
+        }
+    }
+
+    if (settings.draw_bounding_boxes) {
+        SDL_SetRenderDrawColor(renderer, 178, 102, 255, 255);
+        for (auto body : m_bodies) {
+            body->draw_bounding_box(renderer);
+        }
+    }
+
+    if (settings.draw_contact_points) {
+        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+        for (auto contact : m_contacts) {
+            for (unsigned i(0); i < contact->count; ++i) {
+                const auto point(contact->contact_points[i]);
+                render_circle_fill_raster(renderer, point, 3.5 / RENDER_SCALE);
+            }
+        }
+    }
+
+    if (settings.draw_collision_normal) {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
+        for (auto contact : m_contacts) {
+            for (unsigned i(0); i < contact->count; ++i) {
+                const auto point(contact->contact_points[i]);
+                render_line(renderer, point, point + contact->normal / RENDER_SCALE * 20);
+            }
+        }
+    }
+
+    if (settings.draw_distance_proxys) {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+        for (auto prox : m_proxys) {
+            render_line(renderer, prox->points.closest_a, prox->points.closest_b);
+        }
+    }
+
+    for (auto spring : m_springs) {
+        spring->draw(renderer);
+    }
+}
+
+void RigidBody::draw(SDL_Renderer* renderer) {
+    if (!trail.empty()) {
+        if (trail.back() != m_pos) {
+            trail.clear();
+        }
+    }
+
+    auto aabb(m_shape->get_aabb());
+    const Vector2 world_min(camera::screen_to_world(0, 0));
+    const Vector2 world_max(camera::screen_to_world(SCREEN_WIDTH, SCREEN_HEIGHT));
+    if (aabb.max.x < world_min.x || aabb.max.y < world_max.y ||
+        aabb.min.x > world_max.x || aabb.min.y > world_min.y) {
+        return;
+    }
+
+    Color color;
+    color.r = m_color.r * 0.5;
+    color.g = m_color.g * 0.5;
+    color.b = m_color.b * 0.5;
+    color.a = m_color.a * 0.5;
+
+    if (m_shape->get_type() == CIRCLE) {
+        const double r(m_shape->get_radius());
+
+        if (m_type != STATIC && m_enabled) {
+            render_shape(renderer, m_shape, color, true);
+            color = m_color;
+            render_shape(renderer, m_shape, color, false);
+
+            const Vector2 indicator(m_pos.x + r * cos(m_theta), m_pos.y + r * sin(m_theta));
+            render_line(renderer, m_pos, indicator);
+        }else {
+            if (m_enabled) {
+                color = m_color;
+                // SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a);
+            }else {
+                color = m_color;
+                color.a *= 0.5;
+                // SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a * 0.5);
+            }
+            render_shape(renderer, m_shape, color, false);
+            if (m_type == STATIC) {
+                SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a * 0.5);
+                render_line(renderer, m_pos, m_pos + vector2_q1 * r);
+                render_line(renderer, m_pos, m_pos + vector2_q2 * r);
+                render_line(renderer, m_pos, m_pos + vector2_q3 * r);
+                render_line(renderer, m_pos, m_pos + vector2_q4 * r);
+            }
+        }
+    }else {
+        if (m_type == STATIC && m_enabled) {
+            SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a);
+
+            const Vertices vertices(m_shape->get_vertices());
+            if (m_shape->get_count() == 4) {
+                render_line(renderer, vertices[0], vertices[2]);
+                render_line(renderer, vertices[1], vertices[3]);
+            }
+        }
+        color = m_color;
+        if (!m_enabled) {
+            color.a *= 0.25;
+        }
+        // Draw outline
+        render_shape(renderer, m_shape, color, false);
+
+        // Fill the inside
+        color.a = m_color.a * 0.1;
+        render_shape(renderer, m_shape, color, true);
+    }
+
+#ifdef DEBUG
+    // Debug drawings
+    //
+#endif
+}
+
+void RigidBody::draw_trail(SDL_Renderer* renderer, bool update_trace) {
+    if (max_trail_length > 0) {
+        if (update_trace) {
+            if (trail.size() == max_trail_length) {
+                trail.pop_front();
+            }
+            if (trail.size() < max_trail_length) {
+                trail.push_back(m_pos);
+            }
+        }
+
+        if (trail.size() > 1) {
+            for (size_t i(0); i < trail.size() - 1; ++i) {
+                int alpha(255.0 / trail.size() * i);
+                SDL_SetRenderDrawColor(renderer, 255, 0, 0, alpha);
+                // render_circle_fill(renderer, point.x, point.y, 1 / (double)RENDER_SCALE);
+                render_line(renderer, trail[i], trail[i + 1]);
+            }
+        }
+    }
+}
+
+void RigidBody::draw_bounding_box(SDL_Renderer* renderer) {
+    AABB aabb(m_shape->get_aabb());
+    render_line(renderer, aabb.min, {aabb.max.x, aabb.min.y});
+    render_line(renderer, {aabb.max.x, aabb.min.y}, aabb.max);
+    render_line(renderer, aabb.max, {aabb.min.x, aabb.max.y});
+    render_line(renderer, {aabb.min.x, aabb.max.y}, aabb.min);
+}
+
+void RigidBody::draw_com(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    render_line(renderer, m_pos, transform2(vector2_x / RENDER_SCALE * 10, m_pos, m_theta));
+    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+    render_line(renderer, m_pos, transform2(vector2_y / RENDER_SCALE * 10, m_pos, m_theta));
+}
+
+void RigidBody::draw_forces(SDL_Renderer* renderer) const {
+    SDL_SetRenderDrawColor(renderer, 255, 0, 255, 255);
+    render_line(renderer, m_pos, m_pos + m_force / 50.0);
+}
+
+void Spring::draw(SDL_Renderer* renderer) {
+    SDL_SetRenderDrawColor(renderer, spring_color.r, spring_color.g, spring_color.b, spring_color.a);
+    // render_line(renderer, B->get_p().x, B->get_p().y, A->get_p().x, A->get_p().y);
+    // if (A->is_movable())
+    //     A->draw_trace(renderer);
+    // if (B->is_movable())
+    //     B->draw_trace(renderer);
+    const Vector2 A_pos(A->get_p());
+    const Vector2 B_pos(B->get_p());
+    const Vector2 axis(A_pos - B_pos);
+    const double length(axis.norm());
+    const unsigned n_coils(l0 * 10);
+
+    if (n_coils > 0) {
+        const double anchor_height((length / (double)n_coils) / 2.0);
+        const double coil_height((length - anchor_height * 2) / (double)n_coils);
+        const Vector2 direction(axis.normalized());
+        for (unsigned i(0); i < n_coils; ++i) {
+            Vector2 coil_start(B_pos + direction * (anchor_height + coil_height * i));
+            draw_coil(renderer, coil_start, direction, coil_height);
+        }
+
+        const Vector2 A_anchor(A_pos - direction * anchor_height);
+        const Vector2 B_anchor(B_pos + direction * anchor_height);
+        render_line(renderer, A_pos, A_anchor);
+        render_line(renderer, B_pos, B_anchor);
+    }else {
+        render_line(renderer, A_pos, B_pos);
+    }
+
+#ifdef DEBUG
+    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    render_point(renderer, equilibrium_pos);
+#endif
+}
+
+void Spring::draw_coil(SDL_Renderer* renderer, Vector2 start, Vector2 direction, double height) const {
+    //const double width(10e-2);
+    const double width(SCENE_WIDTH * 10e-3);
+    const double dw(width / 2.0);
+    const double dh(height / 4.0);
+    const Vector2 perp(direction.normal());
+    const Vector2 p1(start + direction * dh + perp * dw);
+    render_line(renderer, start, p1);
+    const Vector2 p2(p1 + direction * dh * 2 - perp * width);
+    render_line(renderer, p1, p2);
+    const Vector2 p3(p2 + direction * dh + perp * dw);
+    render_line(renderer, p2, p3);
+}
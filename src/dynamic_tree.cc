@@ -0,0 +1,415 @@
+#include <algorithm>
+#include "dynamic_tree.h"
+#include "rigid_body.h"
+
+namespace {
+    AABB merge(const AABB& a, const AABB& b) {
+        AABB result;
+        result.min = {std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y)};
+        result.max = {std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y)};
+        return result;
+    }
+
+    bool contains(const AABB& outer, const AABB& inner) {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y
+            && inner.max.x <= outer.max.x && inner.max.y <= outer.max.y;
+    }
+
+    // Surface area heuristic in 2D
+    double perimeter(const AABB& aabb) {
+        return 2 * ((aabb.max.x - aabb.min.x) + (aabb.max.y - aabb.min.y));
+    }
+
+    // Proportional margin: the scenes mix bodies of a few millimeters and of several meters
+    AABB fatten(const AABB& aabb) {
+        const Vector2 margin((aabb.max - aabb.min) * aabb_tree_margin);
+        AABB fat;
+        fat.min = aabb.min - margin;
+        fat.max = aabb.max + margin;
+        return fat;
+    }
+}
+
+DynamicTree::DynamicTree()
+:   m_root(null_node),
+    m_static_root(null_node),
+    m_free(null_node),
+    m_reinsertions(0)
+{}
+
+void DynamicTree::update() {
+    // Reinsert the bodies that left their fat AABB
+    m_reinsertions = 0;
+    for (size_t i(0); i < m_list.size(); ++i) {
+        const int leaf(m_leaves[i]);
+        const AABB aabb(m_list[i]->get_swept_aabb());
+        if (!contains(m_nodes[leaf].aabb, aabb)) {
+            remove_leaf(m_root, leaf);
+            m_nodes[leaf].aabb = fatten(aabb);
+            insert_leaf(m_root, leaf);
+            ++m_reinsertions;
+        }
+    }
+}
+
+void DynamicTree::process(std::vector<BodyPair>& pairs) {
+    pairs.clear();
+    update();
+
+    if (m_root == null_node) {
+        return;
+    }
+
+    // Query of the tree against itself: a node paired with itself stands for the pairs
+    // within its subtree, two different nodes for the pairs across their subtrees.
+    // The static tree is only queried against the moving one.
+    m_stack.clear();
+    m_stack.push_back({m_root, m_root});
+    if (m_static_root != null_node) {
+        m_stack.push_back({m_root, m_static_root});
+    }
+    while (!m_stack.empty()) {
+        const std::array<int, 2> top(m_stack.back());
+        m_stack.pop_back();
+        const Node& a(m_nodes[top[0]]);
+        const Node& b(m_nodes[top[1]]);
+
+        if (top[0] == top[1]) {
+            if (!a.is_leaf()) {
+                m_stack.push_back({a.child1, a.child1});
+                m_stack.push_back({a.child2, a.child2});
+                m_stack.push_back({a.child1, a.child2});
+            }
+            continue;
+        }
+
+        if (!AABB_overlap(a.aabb, b.aabb)) {
+            continue;
+        }
+
+        if (a.is_leaf() && b.is_leaf()) {
+            if (should_collide(a.filter, b.filter)) {
+                pairs.push_back({a.body, b.body});
+            }
+        }else if (b.is_leaf() || (!a.is_leaf() && perimeter(a.aabb) >= perimeter(b.aabb))) {
+            m_stack.push_back({a.child1, top[1]});
+            m_stack.push_back({a.child2, top[1]});
+        }else {
+            m_stack.push_back({top[0], b.child1});
+            m_stack.push_back({top[0], b.child2});
+        }
+    }
+}
+
+void DynamicTree::query(const AABB& aabb, std::vector<RigidBody*>& bodies) const {
+    m_query_stack.clear();
+    for (int root : {m_root, m_static_root}) {
+        if (root != null_node) {
+            m_query_stack.push_back(root);
+        }
+    }
+    while (!m_query_stack.empty()) {
+        const Node& node(m_nodes[m_query_stack.back()]);
+        m_query_stack.pop_back();
+        if (!AABB_overlap(node.aabb, aabb)) {
+            continue;
+        }
+        if (node.is_leaf()) {
+            bodies.push_back(node.body);
+        }else {
+            m_query_stack.push_back(node.child1);
+            m_query_stack.push_back(node.child2);
+        }
+    }
+}
+
+void DynamicTree::add_body(RigidBody* body) {
+    if (!body->is_enabled()) {
+        return;
+    }
+
+    const int leaf(allocate_node());
+    m_nodes[leaf].body = body;
+    m_nodes[leaf].filter = body->get_filter();
+    m_nodes[leaf].height = 0;
+    if (body->is_static()) {
+        // Never moves during a step, no need for a fat AABB
+        m_nodes[leaf].aabb = body->get_swept_aabb();
+        insert_leaf(m_static_root, leaf);
+        m_static_leaves[body] = leaf;
+        return;
+    }
+    m_nodes[leaf].aabb = fatten(body->get_swept_aabb());
+    insert_leaf(m_root, leaf);
+
+    m_indices[body] = m_list.size();
+    m_list.push_back(body);
+    m_leaves.push_back(leaf);
+}
+
+void DynamicTree::remove_body(RigidBody* body) {
+    auto it(m_indices.find(body));
+    if (it == m_indices.end()) {
+        auto static_it(m_static_leaves.find(body));
+        if (static_it != m_static_leaves.end()) {
+            remove_leaf(m_static_root, static_it->second);
+            free_node(static_it->second);
+            m_static_leaves.erase(static_it);
+        }
+        return;
+    }
+    const size_t index(it->second);
+    m_indices.erase(it);
+
+    remove_leaf(m_root, m_leaves[index]);
+    free_node(m_leaves[index]);
+
+    // The last body takes the free place
+    if (index + 1 < m_list.size()) {
+        m_list[index] = m_list.back();
+        m_leaves[index] = m_leaves.back();
+        m_indices[m_list[index]] = index;
+    }
+    m_list.pop_back();
+    m_leaves.pop_back();
+}
+
+void DynamicTree::clear() {
+    m_nodes.clear();
+    m_root = null_node;
+    m_static_root = null_node;
+    m_free = null_node;
+    m_list.clear();
+    m_leaves.clear();
+    m_indices.clear();
+    m_static_leaves.clear();
+}
+
+int DynamicTree::get_height() const {
+    return m_root == null_node ? 0 : m_nodes[m_root].height;
+}
+
+int DynamicTree::allocate_node() {
+    if (m_free == null_node) {
+        m_nodes.push_back(Node());
+        return m_nodes.size() - 1;
+    }
+
+    const int node(m_free);
+    m_free = m_nodes[node].parent;
+    m_nodes[node] = Node();
+    return node;
+}
+
+void DynamicTree::free_node(const int node) {
+    m_nodes[node].parent = m_free;
+    m_nodes[node].height = -1;
+    m_nodes[node].body = nullptr;
+    m_free = node;
+}
+
+void DynamicTree::insert_leaf(int& root, const int leaf) {
+    if (root == null_node) {
+        root = leaf;
+        m_nodes[leaf].parent = null_node;
+        return;
+    }
+
+    // Find the best sibling, descending where the perimeter grows the least
+    const AABB leaf_aabb(m_nodes[leaf].aabb);
+    int index(root);
+    while (!m_nodes[index].is_leaf()) {
+        const Node& node(m_nodes[index]);
+        const double area(perimeter(node.aabb));
+        const double combined_area(perimeter(merge(node.aabb, leaf_aabb)));
+
+        // Cost of making a new parent for this node and the leaf
+        const double cost(2 * combined_area);
+        // Minimum cost of pushing the leaf further down
+        const double inheritance_cost(2 * (combined_area - area));
+
+        double child_costs[2];
+        for (unsigned k(0); k < 2; ++k) {
+            const Node& child(m_nodes[k ? node.child2 : node.child1]);
+            const double merged(perimeter(merge(leaf_aabb, child.aabb)));
+            child_costs[k] = (child.is_leaf() ? merged : merged - perimeter(child.aabb)) + inheritance_cost;
+        }
+
+        if (cost < child_costs[0] && cost < child_costs[1]) {
+            break;
+        }
+        index = child_costs[0] < child_costs[1] ? node.child1 : node.child2;
+    }
+    const int sibling(index);
+
+    // New parent of the sibling and the leaf
+    const int old_parent(m_nodes[sibling].parent);
+    const int new_parent(allocate_node());
+    m_nodes[new_parent].parent = old_parent;
+    m_nodes[new_parent].aabb = merge(leaf_aabb, m_nodes[sibling].aabb);
+    m_nodes[new_parent].height = m_nodes[sibling].height + 1;
+    m_nodes[new_parent].child1 = sibling;
+    m_nodes[new_parent].child2 = leaf;
+    m_nodes[sibling].parent = new_parent;
+    m_nodes[leaf].parent = new_parent;
+
+    if (old_parent != null_node) {
+        if (m_nodes[old_parent].child1 == sibling) {
+            m_nodes[old_parent].child1 = new_parent;
+        }else {
+            m_nodes[old_parent].child2 = new_parent;
+        }
+    }else {
+        root = new_parent;
+    }
+
+    // Refit and rebalance the ancestors
+    index = m_nodes[leaf].parent;
+    while (index != null_node) {
+        index = balance(root, index);
+        Node& node(m_nodes[index]);
+        node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+        node.aabb = merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+        index = node.parent;
+    }
+}
+
+void DynamicTree::remove_leaf(int& root, const int leaf) {
+    if (leaf == root) {
+        root = null_node;
+        return;
+    }
+
+    const int parent(m_nodes[leaf].parent);
+    const int grand_parent(m_nodes[parent].parent);
+    const int sibling(m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1);
+
+    if (grand_parent == null_node) {
+        root = sibling;
+        m_nodes[sibling].parent = null_node;
+        free_node(parent);
+        return;
+    }
+
+    // The sibling takes the place of the parent
+    if (m_nodes[grand_parent].child1 == parent) {
+        m_nodes[grand_parent].child1 = sibling;
+    }else {
+        m_nodes[grand_parent].child2 = sibling;
+    }
+    m_nodes[sibling].parent = grand_parent;
+    free_node(parent);
+
+    int index(grand_parent);
+    while (index != null_node) {
+        index = balance(root, index);
+        Node& node(m_nodes[index]);
+        node.height = 1 + std::max(m_nodes[node.child1].height, m_nodes[node.child2].height);
+        node.aabb = merge(m_nodes[node.child1].aabb, m_nodes[node.child2].aabb);
+        index = node.parent;
+    }
+}
+
+int DynamicTree::balance(int& root, const int index_a) {
+    Node& A(m_nodes[index_a]);
+    if (A.is_leaf() || A.height < 2) {
+        return index_a;
+    }
+
+    const int index_b(A.child1);
+    const int index_c(A.child2);
+    Node& B(m_nodes[index_b]);
+    Node& C(m_nodes[index_c]);
+
+    const int imbalance(C.height - B.height);
+
+    // Rotate C up
+    if (imbalance > 1) {
+        const int index_f(C.child1);
+        const int index_g(C.child2);
+        Node& F(m_nodes[index_f]);
+        Node& G(m_nodes[index_g]);
+
+        // Swap A and C
+        C.child1 = index_a;
+        C.parent = A.parent;
+        A.parent = index_c;
+
+        if (C.parent != null_node) {
+            if (m_nodes[C.parent].child1 == index_a) {
+                m_nodes[C.parent].child1 = index_c;
+            }else {
+                m_nodes[C.parent].child2 = index_c;
+            }
+        }else {
+            root = index_c;
+        }
+
+        // The highest child of C stays under C
+        if (F.height > G.height) {
+            C.child2 = index_f;
+            A.child2 = index_g;
+            G.parent = index_a;
+            A.aabb = merge(B.aabb, G.aabb);
+            C.aabb = merge(A.aabb, F.aabb);
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        }else {
+            C.child2 = index_g;
+            A.child2 = index_f;
+            F.parent = index_a;
+            A.aabb = merge(B.aabb, F.aabb);
+            C.aabb = merge(A.aabb, G.aabb);
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+
+        return index_c;
+    }
+
+    // Rotate B up
+    if (imbalance < -1) {
+        const int index_d(B.child1);
+        const int index_e(B.child2);
+        Node& D(m_nodes[index_d]);
+        Node& E(m_nodes[index_e]);
+
+        // Swap A and B
+        B.child1 = index_a;
+        B.parent = A.parent;
+        A.parent = index_b;
+
+        if (B.parent != null_node) {
+            if (m_nodes[B.parent].child1 == index_a) {
+                m_nodes[B.parent].child1 = index_b;
+            }else {
+                m_nodes[B.parent].child2 = index_b;
+            }
+        }else {
+            root = index_b;
+        }
+
+        // The highest child of B stays under B
+        if (D.height > E.height) {
+            B.child2 = index_d;
+            A.child1 = index_e;
+            E.parent = index_a;
+            A.aabb = merge(C.aabb, E.aabb);
+            B.aabb = merge(A.aabb, D.aabb);
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        }else {
+            B.child2 = index_e;
+            A.child1 = index_d;
+            D.parent = index_a;
+            A.aabb = merge(C.aabb, D.aabb);
+            B.aabb = merge(A.aabb, E.aabb);
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+
+        return index_b;
+    }
+
+    return index_a;
+}
@@ -0,0 +1,81 @@
+#ifndef DYNAMIC_TREE_H
+#define DYNAMIC_TREE_H
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include "broad_phase.h"
+#include "rigid_body.h" // CollisionFilter
+#include "shape.h"  // AABB
+
+constexpr double aabb_tree_margin(0.1);   // Enlargement of the fat AABBs, relative to their size
+
+/**
+ * @brief Broad phase on a dynamic bounding volume tree.
+ * Each body is a leaf holding a fat AABB, enlarged by aabb_tree_margin, so that a body
+ * moving a little stays inside it and the tree is left untouched. A body leaving its
+ * fat AABB is removed and reinserted, its ancestors are refitted on the way up and
+ * rebalanced with tree rotations. The pairs come from a query of the tree against itself.
+ * The static bodies have a tree of their own, left untouched by the steps and only
+ * queried against the tree of the moving bodies.
+ */
+class DynamicTree : public BroadPhase {
+public:
+    DynamicTree();
+
+    void process(std::vector<BodyPair>& pairs) override;
+    void update() override;
+    void query(const AABB& aabb, std::vector<RigidBody*>& bodies) const override;
+    void add_body(RigidBody* body) override;
+    void remove_body(RigidBody* body) override;
+    void clear() override;
+
+    // Height of the tree of the moving bodies
+    int get_height() const;
+    size_t get_proxy_count() const { return m_leaves.size() + m_static_leaves.size(); }
+    // Bodies that left their fat AABB during the last process
+    unsigned get_reinsertions() const { return m_reinsertions; }
+private:
+    static constexpr int null_node = -1;
+
+    struct Node {
+        AABB aabb;                  // Fat for the leaves
+        RigidBody* body = nullptr;  // Leaves only
+        CollisionFilter filter;     // Of the body, read without leaving the nodes
+        int parent = null_node;     // Next free node when in the free list
+        int child1 = null_node;
+        int child2 = null_node;
+        int height = 0;             // 0 for the leaves, -1 when free
+
+        bool is_leaf() const { return child1 == null_node; }
+    };
+
+    std::vector<Node> m_nodes;      // Nodes of both trees
+    int m_root;
+    int m_static_root;
+    int m_free;
+
+    std::vector<RigidBody*> m_list; // Moving bodies
+    std::vector<int> m_leaves;      // Leaf of each body of m_list
+    std::unordered_map<RigidBody*, size_t> m_indices;   // Position of each body in m_list
+    std::unordered_map<RigidBody*, int> m_static_leaves;
+    unsigned m_reinsertions;
+
+    // Traversal stack of the self query, kept for its capacity
+    std::vector<std::array<int, 2>> m_stack;
+    mutable std::vector<int> m_query_stack;
+
+
+    int allocate_node();
+    void free_node(const int node);
+    // The root is either m_root or m_static_root
+    void insert_leaf(int& root, const int leaf);
+    void remove_leaf(int& root, const int leaf);
+    /**
+     * @brief Performs a left or right rotation if the subtree rooted at the node is imbalanced
+     * @return The new root of the subtree
+     */
+    int balance(int& root, const int node);
+};
+
+#endif /* DYNAMIC_TREE_H */
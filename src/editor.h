@@ -9,8 +9,6 @@
 #include "vector2.h"
 
 constexpr unsigned editor_ticks_default(50);
-constexpr float spring_stiffness_default(0.5 * steel_density);
-constexpr float spring_stiffness_infinite(1e4f * steel_density);
 
 struct Control;
 
@@ -0,0 +1,65 @@
+#include <cassert>
+#include "frame_arena.h"
+
+FrameArena::FrameArena(const size_t capacity)
+:   m_buffer(static_cast<char*>(::operator new(capacity))),
+    m_capacity(capacity),
+    m_top(0),
+    m_demand(0),
+    m_peak(0),
+    m_overflow_bytes(0),
+    m_overflow_count(0),
+    m_chunk(nullptr),
+    m_chunk_size(0),
+    m_chunk_top(0)
+{
+    m_overflow.reserve(frame_arena_max_overflows);
+}
+
+FrameArena::~FrameArena() {
+    reset();
+    ::operator delete(m_buffer);
+}
+
+void FrameArena::reset() {
+    for (void* block : m_overflow) {
+        ::operator delete(block);
+    }
+    m_overflow.clear();
+    m_overflow_bytes = 0;
+    m_chunk = nullptr;
+    m_chunk_size = 0;
+    m_chunk_top = 0;
+    m_top = 0;
+    m_demand = 0;
+
+    if (m_peak > m_capacity) {
+        size_t capacity(m_capacity);
+        while (capacity < m_peak) {
+            capacity *= 2;
+        }
+        ::operator delete(m_buffer);
+        m_buffer = static_cast<char*>(::operator new(capacity));
+        m_capacity = capacity;
+    }
+}
+
+void* FrameArena::allocate_overflow(const size_t size, const size_t align) {
+    assert(align <= alignof(std::max_align_t));
+    size_t begin((m_chunk_top + align - 1) & ~(align - 1));
+    if (!m_chunk || begin + size > m_chunk_size) {
+        // Chunks of the capacity of the arena, so that an overflowing step allocates a few
+        m_chunk_size = size > m_capacity ? size : m_capacity;
+        m_chunk = static_cast<char*>(::operator new(m_chunk_size));
+        m_overflow.push_back(m_chunk);
+        ++m_overflow_count;
+        m_chunk_top = 0;
+        begin = 0;
+    }
+
+    m_overflow_bytes += begin + size - m_chunk_top;
+    m_chunk_top = begin + size;
+    m_demand = m_overflow_bytes + m_top;
+    m_peak = m_demand > m_peak ? m_demand : m_peak;
+    return m_chunk + begin;
+}
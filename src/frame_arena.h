@@ -0,0 +1,119 @@
+// Per-step frame arena
+//
+// Bump allocator for the temporaries of a World::step (contacts, distance proxies), one per
+// World. Allocating is a pointer increment, nothing is freed individually: the whole arena
+// is reset at the beginning of the next step, and a nested computation can give its memory
+// back when it is done with ArenaScope.
+// When a step needs more than the capacity, the arena carries on in heap chunks of its
+// capacity and grows to the peak usage at the next reset, so it stops allocating once the
+// peak is reached.
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+constexpr size_t frame_arena_capacity(1 << 16);    // Initial capacity (bytes)
+constexpr size_t frame_arena_max_overflows(64);     // Overflow chunks tracked without reallocating
+
+class FrameArena {
+public:
+    explicit FrameArena(const size_t capacity = frame_arena_capacity);
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    /**
+     * @brief Allocates an uninitialized block, from an overflow chunk if the arena is full
+     */
+    inline void* allocate(const size_t size, const size_t align = alignof(std::max_align_t)) {
+        const size_t begin((m_top + align - 1) & ~(align - 1));
+        if (begin + size <= m_capacity) {
+            m_top = begin + size;
+            m_demand = m_overflow_bytes + m_top;
+            m_peak = m_demand > m_peak ? m_demand : m_peak;
+            return m_buffer + begin;
+        }
+        return allocate_overflow(size, align);
+    }
+
+    /**
+     * @brief Constructs an object in the arena, its destructor is never called
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    size_t get_marker() const { return m_top; }
+    /**
+     * @brief Frees everything allocated in the arena since the marker was taken
+     */
+    void rewind(const size_t marker) { m_top = marker; }
+
+    /**
+     * @brief Frees everything, and grows the arena if the last frames overflowed it
+     */
+    void reset();
+
+    size_t get_capacity() const { return m_capacity; }
+    size_t get_used() const { return m_top; }
+    size_t get_peak() const { return m_peak; }                  // Largest usage since the arena was created
+    size_t get_overflows() const { return m_overflow_count; }   // Heap chunks since the arena was created
+private:
+    char* m_buffer;
+    size_t m_capacity;
+    size_t m_top;
+    size_t m_demand;            // Bytes in use, overflow chunks included
+    size_t m_peak;
+    std::vector<void*> m_overflow;
+    size_t m_overflow_bytes;    // Used in the overflow chunks
+    size_t m_overflow_count;
+    char* m_chunk;              // Current overflow chunk
+    size_t m_chunk_size;
+    size_t m_chunk_top;
+
+    void* allocate_overflow(const size_t size, const size_t align);
+};
+
+// Gives the memory allocated in a scope back to the arena
+class ArenaScope {
+public:
+    explicit ArenaScope(FrameArena& arena) : m_arena(arena), m_marker(arena.get_marker()) {}
+    ~ArenaScope() { m_arena.rewind(m_marker); }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+private:
+    FrameArena& m_arena;
+    size_t m_marker;
+};
+
+// Standard allocator on a frame arena, for containers that live during a step at most
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    ArenaAllocator(FrameArena& arena) : m_arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.get_arena()) {}
+
+    T* allocate(const size_t n) { return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    FrameArena* get_arena() const { return m_arena; }
+private:
+    FrameArena* m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.get_arena() == b.get_arena(); }
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return !(a == b); }
+
+#endif /* FRAME_ARENA_H */
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cmath>
+#include "hierarchical_grid.h"
+#include "rigid_body.h"
+
+namespace {
+    // Level of the smallest cells larger than the AABB: 2^(level - 1) <= size < 2^level
+    int level_of(const AABB& aabb) {
+        int level;
+        std::frexp(std::max(aabb.max.x - aabb.min.x, aabb.max.y - aabb.min.y), &level);
+        return level;
+    }
+
+    // Inverse of the cell size of a level, a power of two so that scaling by it is exact
+    double scale_of(const int level) {
+        return std::ldexp(1.0, -level);
+    }
+
+    AABB merge(const AABB& a, const AABB& b) {
+        AABB result;
+        result.min = {std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y)};
+        result.max = {std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y)};
+        return result;
+    }
+
+    // Floor of the scaled value, without the library call
+    int cell_of(const double value, const double scale) {
+        const double scaled(value * scale);
+        const int cell(scaled);
+        return cell - (scaled < cell);
+    }
+}
+
+HierarchicalGrid::HierarchicalGrid()
+:   m_static_changed(0)
+{}
+
+void HierarchicalGrid::update() {
+    if (m_static_changed) {
+        build(m_static, m_static_grid);
+        m_static_changed = 0;
+    }
+    build(m_list, m_grid);
+}
+
+void HierarchicalGrid::process(std::vector<BodyPair>& pairs) {
+    pairs.clear();
+    update();
+
+    // Within a level, the cell itself then the right, upper left, upper and upper right
+    // neighbors, as in the spatial hash. The coarser levels are looked up from the entry.
+    const std::vector<Entry>& cells(m_grid.cells);
+    for (unsigned i(0); i < cells.size(); ++i) {
+        const Entry& entry(cells[i]);
+        const int level(entry.level);
+        pair_cell(entry, m_grid, level, entry.x, entry.y, i + 1, pairs);
+        pair_cell(entry, m_grid, level, entry.x + 1, entry.y, 0, pairs);
+        pair_cell(entry, m_grid, level, entry.x - 1, entry.y + 1, 0, pairs);
+        pair_cell(entry, m_grid, level, entry.x, entry.y + 1, 0, pairs);
+        pair_cell(entry, m_grid, level, entry.x + 1, entry.y + 1, 0, pairs);
+        pair_levels(entry, m_grid, level + 1, pairs);
+        pair_levels(entry, m_static_grid, level, pairs);
+    }
+
+    // The static bodies smaller than moving ones
+    for (const auto& entry : m_static_grid.cells) {
+        pair_levels(entry, m_grid, entry.level + 1, pairs);
+    }
+}
+
+void HierarchicalGrid::query(const AABB& aabb, std::vector<RigidBody*>& bodies) const {
+    for (const Grid* grid : {&m_grid, &m_static_grid}) {
+        // Scan all the entries when the box spans more cells of a level than there are entries
+        bool scan(0);
+        for (int level : grid->levels) {
+            const double scale(scale_of(level));
+            const double width(std::floor(aabb.max.x * scale) - std::floor(aabb.min.x * scale) + 2);
+            const double height(std::floor(aabb.max.y * scale) - std::floor(aabb.min.y * scale) + 2);
+            if (width * height > grid->cells.size()) {
+                scan = 1;
+                break;
+            }
+        }
+
+        if (scan) {
+            for (const auto& entry : grid->cells) {
+                if (AABB_overlap(entry.aabb, aabb)) {
+                    bodies.push_back(entry.body);
+                }
+            }
+            continue;
+        }
+
+        for (size_t i(0); i < grid->levels.size(); ++i) {
+            if (!AABB_overlap(grid->bounds[i], aabb)) {
+                continue;
+            }
+            const int level(grid->levels[i]);
+            const double scale(scale_of(level));
+            const int x1(cell_of(aabb.max.x, scale));
+            const int y1(cell_of(aabb.max.y, scale));
+            for (int y(cell_of(aabb.min.y, scale) - 1); y <= y1; ++y) {
+                for (int x(cell_of(aabb.min.x, scale) - 1); x <= x1; ++x) {
+                    grid->for_each_in_bucket(grid->bucket(level, x, y), 0, [&](const Entry& entry) {
+                        if (entry.level == level && entry.x == x && entry.y == y
+                         && AABB_overlap(entry.aabb, aabb)) {
+                            bodies.push_back(entry.body);
+                        }
+                    });
+                }
+            }
+        }
+    }
+}
+
+void HierarchicalGrid::add_body(RigidBody* body) {
+    if (!body->is_enabled()) {
+        return;
+    }
+    if (body->is_static()) {
+        m_static.push_back(body);
+        m_static_changed = 1;
+    }else {
+        m_list.push_back(body);
+    }
+}
+
+void HierarchicalGrid::remove_body(RigidBody* body) {
+    auto it(std::find(m_list.begin(), m_list.end(), body));
+    if (it != m_list.end()) {
+        m_list.erase(it);
+        return;
+    }
+    it = std::find(m_static.begin(), m_static.end(), body);
+    if (it != m_static.end()) {
+        m_static.erase(it);
+        m_static_changed = 1;
+    }
+}
+
+void HierarchicalGrid::clear() {
+    m_list.clear();
+    m_static.clear();
+    m_static_changed = 1;
+    m_grid.levels.clear();
+    m_grid.bounds.clear();
+    m_grid.cells.clear();
+}
+
+bool HierarchicalGrid::Entry::pairs_with(const Entry& other) const {
+    return AABB_overlap(aabb, other.aabb) && should_collide(filter, other.filter);
+}
+
+unsigned HierarchicalGrid::Grid::bucket(const int level, const int x, const int y) const {
+    return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)level * 83492791u) & mask;
+}
+
+void HierarchicalGrid::build(const std::vector<RigidBody*>& bodies, Grid& grid) {
+    grid.levels.clear();
+    grid.bounds.clear();
+    grid.cells.clear();
+    m_entries.clear();
+    if (bodies.empty()) {
+        return;
+    }
+
+    int min_level(INT32_MAX);
+    int max_level(INT32_MIN);
+    for (auto body : bodies) {
+        Entry entry;
+        entry.aabb = body->get_swept_aabb();
+        entry.level = level_of(entry.aabb);
+        const double scale(scale_of(entry.level));
+        entry.x = cell_of(entry.aabb.min.x, scale);
+        entry.y = cell_of(entry.aabb.min.y, scale);
+        entry.filter = body->get_filter();
+        entry.body = body;
+        m_entries.push_back(entry);
+        min_level = std::min(min_level, entry.level);
+        max_level = std::max(max_level, entry.level);
+    }
+
+    m_used_levels.assign(max_level - min_level + 1, 0);
+    m_level_bounds.resize(max_level - min_level + 1);
+    for (const auto& entry : m_entries) {
+        const int i(entry.level - min_level);
+        m_level_bounds[i] = m_used_levels[i] ? merge(m_level_bounds[i], entry.aabb) : entry.aabb;
+        m_used_levels[i] = 1;
+    }
+    for (int level(min_level); level <= max_level; ++level) {
+        if (m_used_levels[level - min_level]) {
+            grid.levels.push_back(level);
+            grid.bounds.push_back(m_level_bounds[level - min_level]);
+        }
+    }
+
+    grid.build(m_entries, [&grid](const Entry& entry) { return grid.bucket(entry.level, entry.x, entry.y); });
+}
+
+void HierarchicalGrid::pair_cell(const Entry& entry, const Grid& grid, const int level, const int x, const int y,
+                                 unsigned first, std::vector<BodyPair>& pairs) const {
+    grid.for_each_in_bucket(grid.bucket(level, x, y), first, [&](const Entry& other) {
+        if (other.level == level && other.x == x && other.y == y && entry.pairs_with(other)) {
+            pairs.push_back({entry.body, other.body});
+        }
+    });
+}
+
+void HierarchicalGrid::pair_levels(const Entry& entry, const Grid& grid, const int first_level,
+                                   std::vector<BodyPair>& pairs) const {
+    // The entry is smaller than the cells of these levels: the lower corners of the bodies
+    // overlapping it lie within one cell below and left of it, up to its upper corner,
+    // at most 3 by 3 cells
+    const size_t first(std::lower_bound(grid.levels.begin(), grid.levels.end(), first_level) - grid.levels.begin());
+    for (size_t i(first); i < grid.levels.size(); ++i) {
+        if (!AABB_overlap(grid.bounds[i], entry.aabb)) {
+            continue;
+        }
+        const int level(grid.levels[i]);
+        const double scale(scale_of(level));
+        const int x1(cell_of(entry.aabb.max.x, scale));
+        const int y1(cell_of(entry.aabb.max.y, scale));
+        for (int y(cell_of(entry.aabb.min.y, scale) - 1); y <= y1; ++y) {
+            for (int x(cell_of(entry.aabb.min.x, scale) - 1); x <= x1; ++x) {
+                pair_cell(entry, grid, level, x, y, 0, pairs);
+            }
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef HIERARCHICAL_GRID_H
+#define HIERARCHICAL_GRID_H
+
+#include <cstdint>
+#include <vector>
+#include "broad_phase.h"
+#include "bucket_grid.h"
+#include "rigid_body.h" // CollisionFilter
+#include "shape.h"  // AABB
+
+/**
+ * @brief Broad phase on a hierarchy of uniform grids, stored in a single spatial hash.
+ * The cells of level l are 2^l meters wide, and each body goes to the level of the smallest
+ * cells larger than its AABB, in the cell of its lower corner. Two overlapping bodies of a
+ * level then sit in the same cell or in neighbor cells, paired as in the spatial hash.
+ * A body looks up the bodies of the coarser levels in the few cells its AABB spans there,
+ * so that each pair is found from its smaller body and the work does not depend on the
+ * spread of the body sizes.
+ * The static bodies have a hierarchy of their own, built when they change only. The moving
+ * bodies look up the static ones of their level and the coarser ones, and the static bodies
+ * look up the moving ones of the coarser levels.
+ */
+class HierarchicalGrid : public BroadPhase {
+public:
+    HierarchicalGrid();
+
+    void process(std::vector<BodyPair>& pairs) override;
+    void update() override;
+    void query(const AABB& aabb, std::vector<RigidBody*>& bodies) const override;
+    void add_body(RigidBody* body) override;
+    void remove_body(RigidBody* body) override;
+    void clear() override;
+
+    // Levels holding moving bodies during the last process
+    size_t get_level_count() const { return m_grid.levels.size(); }
+private:
+    struct Entry {
+        AABB aabb;
+        int level;
+        int x;              // Cell of the lower corner
+        int y;
+        unsigned bucket;
+        CollisionFilter filter;
+        RigidBody* body;
+
+        // Overlap of the AABBs and collision filters
+        bool pairs_with(const Entry& other) const;
+    };
+
+    struct Grid : BucketGrid<Entry> {
+        std::vector<int> levels;        // Levels holding entries, ascending
+        std::vector<AABB> bounds;       // Of the entries of each level, to skip the far ones
+
+        unsigned bucket(const int level, const int x, const int y) const;
+    };
+
+    std::vector<RigidBody*> m_list;     // Moving bodies
+    std::vector<RigidBody*> m_static;
+    bool m_static_changed;
+
+    Grid m_grid;                        // Rebuilt by each update, kept for its capacity
+    Grid m_static_grid;
+    std::vector<Entry> m_entries;       // Scratch buffers of build
+    std::vector<char> m_used_levels;
+    std::vector<AABB> m_level_bounds;
+
+    void build(const std::vector<RigidBody*>& bodies, Grid& grid);
+    // Pairs the entry with the ones of the cell (level, x, y) from position first on
+    void pair_cell(const Entry& entry, const Grid& grid, const int level, const int x, const int y,
+                   unsigned first, std::vector<BodyPair>& pairs) const;
+    // Pairs the entry with the ones of the levels of the grid from first_level up
+    void pair_levels(const Entry& entry, const Grid& grid, const int first_level,
+                     std::vector<BodyPair>& pairs) const;
+};
+
+#endif /* HIERARCHICAL_GRID_H */
@@ -0,0 +1,459 @@
+#include <algorithm>
+#include "incremental_sap.h"
+#include "rigid_body.h"
+#include "shape.h"
+
+namespace {
+    constexpr uint64_t empty_key(UINT64_MAX);
+    constexpr size_t initial_table_size(64);
+    // A batch of new bodies larger than 1/rebuild_ratio of the others is sorted from scratch
+    constexpr unsigned rebuild_ratio(8);
+
+    uint64_t pair_key(const unsigned a, const unsigned b) {
+        return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    }
+
+    size_t hash(const uint64_t key) {
+        return (key * 0x9E3779B97F4A7C15ull) >> 32;
+    }
+
+    double lower(const AABB& aabb, const unsigned axis) {
+        return axis ? aabb.min.y : aabb.min.x;
+    }
+
+    double upper(const AABB& aabb, const unsigned axis) {
+        return axis ? aabb.max.y : aabb.max.x;
+    }
+}
+
+// Lower bounds first on ties: touching boxes overlap, like in AABB_overlap.
+// Resting bodies are exactly in contact after the position correction.
+bool IncrementalSweepAndPrune::Endpoint::operator<(const Endpoint& other) const {
+    return value < other.value || (value == other.value && !is_max() && other.is_max());
+}
+
+IncrementalSweepAndPrune::IncrementalSweepAndPrune()
+:   m_proxy_count(0),
+    m_keys(initial_table_size, empty_key),
+    m_slots(initial_table_size, 0),
+    m_swaps(0),
+    m_processed(0),
+    m_max_extent(0)
+{}
+
+void IncrementalSweepAndPrune::update() {
+    // The events of an update before a process are kept for it
+    if (m_processed) {
+        m_begin_events.clear();
+        m_end_events.clear();
+        m_swaps = 0;
+        m_processed = 0;
+    }
+
+    if (!m_pending.empty()) {
+        if (m_pending.size() * rebuild_ratio > m_proxy_count) {
+            m_proxy_count += m_pending.size();
+            rebuild();
+        }else {
+            for (unsigned proxy : m_pending) {
+                insert_proxy(proxy);
+            }
+        }
+        m_pending.clear();
+    }
+
+    for (unsigned proxy(0); proxy < m_proxies.size(); ++proxy) {
+        if (m_proxies[proxy].body && !m_proxies[proxy].is_static) {
+            update_proxy(proxy);
+        }
+    }
+}
+
+void IncrementalSweepAndPrune::process(std::vector<BodyPair>& pairs) {
+    update();
+    m_processed = 1;
+
+    pairs.clear();
+    for (const auto& pair : m_pairs) {
+        pairs.push_back({m_proxies[pair.a].body, m_proxies[pair.b].body});
+    }
+}
+
+void IncrementalSweepAndPrune::query(const AABB& aabb, std::vector<RigidBody*>& bodies) const {
+    // The proxies overlapping the box start at most m_max_extent before it on x
+    const std::vector<Endpoint>& endpoints(m_endpoints[0]);
+    auto it(std::lower_bound(endpoints.begin(), endpoints.end(), aabb.min.x - m_max_extent,
+                             [](const Endpoint& endpoint, double value) { return endpoint.value < value; }));
+    for (; it != endpoints.end() && it->value <= aabb.max.x; ++it) {
+        if (it->is_max()) {
+            continue;
+        }
+        const Proxy& proxy(m_proxies[it->proxy()]);
+        if (endpoints[proxy.max[0]].value >= aabb.min.x
+         && m_endpoints[1][proxy.min[1]].value <= aabb.max.y
+         && m_endpoints[1][proxy.max[1]].value >= aabb.min.y) {
+            bodies.push_back(proxy.body);
+        }
+    }
+}
+
+void IncrementalSweepAndPrune::add_body(RigidBody* body) {
+    if (!body->is_enabled()) {
+        return;
+    }
+
+    unsigned proxy;
+    if (!m_free_proxies.empty()) {
+        proxy = m_free_proxies.back();
+        m_free_proxies.pop_back();
+    }else {
+        proxy = m_proxies.size();
+        m_proxies.push_back(Proxy());
+    }
+    m_proxies[proxy].body = body;
+    m_proxies[proxy].is_static = body->is_static();
+    m_proxies[proxy].filter = body->get_filter();
+    m_pending.push_back(proxy);
+}
+
+void IncrementalSweepAndPrune::remove_body(RigidBody* body) {
+    unsigned proxy(0);
+    while (proxy < m_proxies.size() && m_proxies[proxy].body != body) {
+        ++proxy;
+    }
+    if (proxy == m_proxies.size()) {
+        return;
+    }
+
+    m_proxies[proxy].body = nullptr;
+    m_free_proxies.push_back(proxy);
+
+    auto pending(std::find(m_pending.begin(), m_pending.end(), proxy));
+    if (pending != m_pending.end()) {
+        m_pending.erase(pending);
+        return;
+    }
+
+    for (size_t i(m_pairs.size()); i-- > 0;) {
+        if (m_pairs[i].a == proxy || m_pairs[i].b == proxy) {
+            erase_pair(i);
+        }
+    }
+
+    for (unsigned axis(0); axis < 2; ++axis) {
+        std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+        const unsigned min(m_proxies[proxy].min[axis]);
+        endpoints.erase(endpoints.begin() + m_proxies[proxy].max[axis]);
+        endpoints.erase(endpoints.begin() + min);
+        for (unsigned i(min); i < endpoints.size(); ++i) {
+            const Endpoint& endpoint(endpoints[i]);
+            Proxy& other(m_proxies[endpoint.proxy()]);
+            (endpoint.is_max() ? other.max : other.min)[axis] = i;
+        }
+    }
+    --m_proxy_count;
+}
+
+void IncrementalSweepAndPrune::clear() {
+    m_endpoints[0].clear();
+    m_endpoints[1].clear();
+    m_proxies.clear();
+    m_free_proxies.clear();
+    m_pending.clear();
+    m_proxy_count = 0;
+    m_pairs.clear();
+    std::fill(m_keys.begin(), m_keys.end(), empty_key);
+    m_begin_events.clear();
+    m_end_events.clear();
+    m_max_extent = 0;
+}
+
+void IncrementalSweepAndPrune::insert_proxy(const unsigned proxy) {
+    const AABB aabb(m_proxies[proxy].body->get_swept_aabb());
+    m_max_extent = std::max(m_max_extent, aabb.max.x - aabb.min.x);
+
+    // Inserted in place rather than sorted down from the end, which would swap the new
+    // bounds past the proxies on the way and report overlaps that never happened
+    for (unsigned axis(0); axis < 2; ++axis) {
+        std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+        const Endpoint min{lower(aabb, axis), proxy << 1};
+        const Endpoint max{upper(aabb, axis), proxy << 1 | 1};
+        const auto min_it(endpoints.insert(std::lower_bound(endpoints.begin(), endpoints.end(), min), min));
+        const unsigned first(min_it - endpoints.begin());
+        endpoints.insert(std::lower_bound(min_it + 1, endpoints.end(), max), max);
+        for (unsigned i(first); i < endpoints.size(); ++i) {
+            const Endpoint& endpoint(endpoints[i]);
+            Proxy& other(m_proxies[endpoint.proxy()]);
+            (endpoint.is_max() ? other.max : other.min)[axis] = i;
+        }
+    }
+    ++m_proxy_count;
+
+    // The proxies overlapping the new one start at most m_max_extent before it on x
+    const std::vector<Endpoint>& endpoints(m_endpoints[0]);
+    const unsigned max_index(m_proxies[proxy].max[0]);
+    auto it(std::lower_bound(endpoints.begin(), endpoints.end(), aabb.min.x - m_max_extent,
+                             [](const Endpoint& endpoint, double value) { return endpoint.value < value; }));
+    for (; it != endpoints.begin() + max_index; ++it) {
+        const unsigned other(it->proxy());
+        if (!it->is_max() && other != proxy && overlap(proxy, other, 0) && overlap(proxy, other, 1)) {
+            add_pair(proxy, other);
+        }
+    }
+}
+
+void IncrementalSweepAndPrune::update_proxy(const unsigned proxy) {
+    const AABB aabb(m_proxies[proxy].body->get_swept_aabb());
+    m_max_extent = std::max(m_max_extent, aabb.max.x - aabb.min.x);
+
+    for (unsigned axis(0); axis < 2; ++axis) {
+        Endpoint& min(m_endpoints[axis][m_proxies[proxy].min[axis]]);
+        Endpoint& max(m_endpoints[axis][m_proxies[proxy].max[axis]]);
+        const double d_min(lower(aabb, axis) - min.value);
+        const double d_max(upper(aabb, axis) - max.value);
+        min.value = lower(aabb, axis);
+        max.value = upper(aabb, axis);
+
+        // Growing first, so that the lower bound never passes the upper one
+        if (d_min < 0) {
+            sort_min_down(axis, m_proxies[proxy].min[axis]);
+        }
+        if (d_max > 0) {
+            sort_max_up(axis, m_proxies[proxy].max[axis]);
+        }
+        if (d_min > 0) {
+            sort_min_up(axis, m_proxies[proxy].min[axis]);
+        }
+        if (d_max < 0) {
+            sort_max_down(axis, m_proxies[proxy].max[axis]);
+        }
+    }
+}
+
+void IncrementalSweepAndPrune::rebuild() {
+    for (unsigned axis(0); axis < 2; ++axis) {
+        m_endpoints[axis].clear();
+    }
+    m_max_extent = 0;
+    for (unsigned proxy(0); proxy < m_proxies.size(); ++proxy) {
+        if (!m_proxies[proxy].body) {
+            continue;
+        }
+        const AABB aabb(m_proxies[proxy].body->get_swept_aabb());
+        m_max_extent = std::max(m_max_extent, aabb.max.x - aabb.min.x);
+        for (unsigned axis(0); axis < 2; ++axis) {
+            m_endpoints[axis].push_back({lower(aabb, axis), proxy << 1});
+            m_endpoints[axis].push_back({upper(aabb, axis), proxy << 1 | 1});
+        }
+    }
+    for (unsigned axis(0); axis < 2; ++axis) {
+        std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+        std::sort(endpoints.begin(), endpoints.end());
+        for (unsigned i(0); i < endpoints.size(); ++i) {
+            Proxy& proxy(m_proxies[endpoints[i].proxy()]);
+            (endpoints[i].is_max() ? proxy.max : proxy.min)[axis] = i;
+        }
+    }
+
+    m_old_keys.clear();
+    for (const auto& pair : m_pairs) {
+        m_old_keys.push_back(pair_key(pair.a, pair.b));
+    }
+    m_pairs.clear();
+    std::fill(m_keys.begin(), m_keys.end(), empty_key);
+
+    // Sweep along x, the y overlap is read from the sorted y endpoints
+    m_active.clear();
+    for (const auto& endpoint : m_endpoints[0]) {
+        const unsigned proxy(endpoint.proxy());
+        if (endpoint.is_max()) {
+            auto it(std::find(m_active.begin(), m_active.end(), proxy));
+            *it = m_active.back();
+            m_active.pop_back();
+        }else {
+            for (unsigned other : m_active) {
+                if (overlap(proxy, other, 1)) {
+                    insert_pair(proxy, other);
+                }
+            }
+            m_active.push_back(proxy);
+        }
+    }
+
+    // Events: difference between the old and the new pairs
+    m_new_keys.clear();
+    for (const auto& pair : m_pairs) {
+        m_new_keys.push_back(pair_key(pair.a, pair.b));
+    }
+    std::sort(m_old_keys.begin(), m_old_keys.end());
+    std::sort(m_new_keys.begin(), m_new_keys.end());
+    auto to_bodies = [this](const uint64_t key) -> BodyPair {
+        return {m_proxies[key >> 32].body, m_proxies[key & UINT32_MAX].body};
+    };
+    size_t i(0), j(0);
+    while (i < m_old_keys.size() || j < m_new_keys.size()) {
+        if (j == m_new_keys.size() || (i < m_old_keys.size() && m_old_keys[i] < m_new_keys[j])) {
+            m_end_events.push_back(to_bodies(m_old_keys[i++]));
+        }else if (i == m_old_keys.size() || m_new_keys[j] < m_old_keys[i]) {
+            m_begin_events.push_back(to_bodies(m_new_keys[j++]));
+        }else {
+            ++i;
+            ++j;
+        }
+    }
+}
+
+// Each swap of a lower and an upper bound starts or ends an overlap on the axis.
+// A pair begins when the boxes also overlap on the other axis.
+
+void IncrementalSweepAndPrune::sort_min_down(const unsigned axis, unsigned index) {
+    std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+    while (index > 0 && endpoints[index] < endpoints[index - 1]) {
+        const Endpoint previous(endpoints[index - 1]);
+        if (previous.is_max() && overlap(endpoints[index].proxy(), previous.proxy(), 1 - axis)) {
+            add_pair(endpoints[index].proxy(), previous.proxy());
+        }
+        swap_endpoints(axis, index - 1, index);
+        --index;
+    }
+}
+
+void IncrementalSweepAndPrune::sort_min_up(const unsigned axis, unsigned index) {
+    std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+    while (index + 1 < endpoints.size() && endpoints[index + 1] < endpoints[index]) {
+        const Endpoint next(endpoints[index + 1]);
+        if (next.is_max()) {
+            remove_pair(endpoints[index].proxy(), next.proxy());
+        }
+        swap_endpoints(axis, index, index + 1);
+        ++index;
+    }
+}
+
+void IncrementalSweepAndPrune::sort_max_down(const unsigned axis, unsigned index) {
+    std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+    while (index > 0 && endpoints[index] < endpoints[index - 1]) {
+        const Endpoint previous(endpoints[index - 1]);
+        if (!previous.is_max()) {
+            remove_pair(endpoints[index].proxy(), previous.proxy());
+        }
+        swap_endpoints(axis, index - 1, index);
+        --index;
+    }
+}
+
+void IncrementalSweepAndPrune::sort_max_up(const unsigned axis, unsigned index) {
+    std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+    while (index + 1 < endpoints.size() && endpoints[index + 1] < endpoints[index]) {
+        const Endpoint next(endpoints[index + 1]);
+        if (!next.is_max() && overlap(endpoints[index].proxy(), next.proxy(), 1 - axis)) {
+            add_pair(endpoints[index].proxy(), next.proxy());
+        }
+        swap_endpoints(axis, index, index + 1);
+        ++index;
+    }
+}
+
+void IncrementalSweepAndPrune::swap_endpoints(const unsigned axis, const unsigned i, const unsigned j) {
+    std::vector<Endpoint>& endpoints(m_endpoints[axis]);
+    std::swap(endpoints[i], endpoints[j]);
+    for (unsigned k : {i, j}) {
+        Proxy& proxy(m_proxies[endpoints[k].proxy()]);
+        (endpoints[k].is_max() ? proxy.max : proxy.min)[axis] = k;
+    }
+    ++m_swaps;
+}
+
+// Positions in the sorted endpoints rather than values: consistent with the sort in progress
+bool IncrementalSweepAndPrune::overlap(const unsigned a, const unsigned b, const unsigned axis) const {
+    const Proxy& proxy_a(m_proxies[a]);
+    const Proxy& proxy_b(m_proxies[b]);
+    return proxy_a.min[axis] < proxy_b.max[axis] && proxy_b.min[axis] < proxy_a.max[axis];
+}
+
+void IncrementalSweepAndPrune::add_pair(const unsigned a, const unsigned b) {
+    if (insert_pair(a, b)) {
+        m_begin_events.push_back({m_proxies[a].body, m_proxies[b].body});
+    }
+}
+
+void IncrementalSweepAndPrune::remove_pair(const unsigned a, const unsigned b) {
+    const size_t slot(find_slot(pair_key(a, b)));
+    if (m_keys[slot] == empty_key) {
+        return;
+    }
+    m_end_events.push_back({m_proxies[a].body, m_proxies[b].body});
+    erase_pair(m_slots[slot]);
+}
+
+bool IncrementalSweepAndPrune::insert_pair(const unsigned a, const unsigned b) {
+    const Proxy& proxy_a(m_proxies[a]);
+    const Proxy& proxy_b(m_proxies[b]);
+    if ((proxy_a.is_static && proxy_b.is_static) || !should_collide(proxy_a.filter, proxy_b.filter)) {
+        return false;
+    }
+    if (2 * (m_pairs.size() + 1) > m_keys.size()) {
+        grow_table();
+    }
+
+    const uint64_t key(pair_key(a, b));
+    const size_t slot(find_slot(key));
+    if (m_keys[slot] != empty_key) {
+        return false;
+    }
+    m_keys[slot] = key;
+    m_slots[slot] = m_pairs.size();
+    m_pairs.push_back({std::min(a, b), std::max(a, b)});
+    return true;
+}
+
+void IncrementalSweepAndPrune::erase_pair(const size_t position) {
+    erase_slot(find_slot(pair_key(m_pairs[position].a, m_pairs[position].b)));
+
+    // The last pair takes the free place
+    if (position + 1 < m_pairs.size()) {
+        m_pairs[position] = m_pairs.back();
+        m_slots[find_slot(pair_key(m_pairs[position].a, m_pairs[position].b))] = position;
+    }
+    m_pairs.pop_back();
+}
+
+size_t IncrementalSweepAndPrune::find_slot(const uint64_t key) const {
+    const size_t mask(m_keys.size() - 1);
+    size_t slot(hash(key) & mask);
+    while (m_keys[slot] != empty_key && m_keys[slot] != key) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Backward shift deletion: the following entries of the probe sequence are moved up
+void IncrementalSweepAndPrune::erase_slot(size_t slot) {
+    const size_t mask(m_keys.size() - 1);
+    size_t next(slot);
+    while (true) {
+        next = (next + 1) & mask;
+        if (m_keys[next] == empty_key) {
+            break;
+        }
+        // An entry stays if its home slot lies cyclically in (slot, next]
+        const size_t home(hash(m_keys[next]) & mask);
+        const bool stays(slot <= next ? (slot < home && home <= next) : (slot < home || home <= next));
+        if (!stays) {
+            m_keys[slot] = m_keys[next];
+            m_slots[slot] = m_slots[next];
+            slot = next;
+        }
+    }
+    m_keys[slot] = empty_key;
+}
+
+void IncrementalSweepAndPrune::grow_table() {
+    m_keys.assign(2 * m_keys.size(), empty_key);
+    m_slots.assign(m_keys.size(), 0);
+    for (unsigned i(0); i < m_pairs.size(); ++i) {
+        const size_t slot(find_slot(pair_key(m_pairs[i].a, m_pairs[i].b)));
+        m_keys[slot] = pair_key(m_pairs[i].a, m_pairs[i].b);
+        m_slots[slot] = i;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef INCREMENTAL_SAP_H
+#define INCREMENTAL_SAP_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "broad_phase.h"
+#include "rigid_body.h" // CollisionFilter
+
+/**
+ * @brief Persistent sweep and prune on both axes.
+ * The bounds of the bodies are kept in one sorted endpoint array per axis, updated with
+ * an insertion sort. Bodies barely move from one step to the next, so this is close to
+ * linear. Every swap of a lower and an upper bound is the beginning or the end of an
+ * overlap on that axis, which keeps a persistent set of the pairs overlapping on both
+ * axes and reports them as begin and end events.
+ * A new body is inserted at its place on both axes, and paired with the bodies it overlaps.
+ * Bodies added in bulk (scene loading) trigger a full rebuild instead of one insertion each.
+ * The endpoints of the static bodies stay in place, they only swap with moving ones.
+ */
+class IncrementalSweepAndPrune : public BroadPhase {
+public:
+    IncrementalSweepAndPrune();
+
+    void process(std::vector<BodyPair>& pairs) override;
+    void update() override;
+    void query(const AABB& aabb, std::vector<RigidBody*>& bodies) const override;
+    void add_body(RigidBody* body) override;
+    /**
+     * @brief Stops pairing a body, its pairs are dropped without an end event
+     */
+    void remove_body(RigidBody* body) override;
+    void clear() override;
+
+    // Pairs that started or stopped overlapping during the last process and the updates before it
+    const std::vector<BodyPair>& get_begin_events() const { return m_begin_events; }
+    const std::vector<BodyPair>& get_end_events() const { return m_end_events; }
+    size_t get_pair_count() const { return m_pairs.size(); }
+    // Endpoint swaps of the last process, the work of the insertion sort
+    unsigned get_swaps() const { return m_swaps; }
+private:
+    struct Endpoint {
+        double value;
+        unsigned data;          // Proxy index << 1 | is_max
+
+        unsigned proxy() const { return data >> 1; }
+        bool is_max() const { return data & 1; }
+        bool operator<(const Endpoint& other) const;
+    };
+
+    struct Proxy {
+        RigidBody* body = nullptr;      // Null when the proxy is free
+        bool is_static = false;         // Not updated, nor paired with other static proxies
+        CollisionFilter filter;
+        std::array<unsigned, 2> min{};  // Position of the endpoints in m_endpoints[axis]
+        std::array<unsigned, 2> max{};
+    };
+
+    // Overlapping pair of proxies, a < b
+    struct Pair {
+        unsigned a;
+        unsigned b;
+    };
+
+    std::array<std::vector<Endpoint>, 2> m_endpoints;
+    std::vector<Proxy> m_proxies;
+    std::vector<unsigned> m_free_proxies;
+    std::vector<unsigned> m_pending;    // Proxies added since the last process
+    unsigned m_proxy_count;
+
+    std::vector<Pair> m_pairs;
+    // Open addressing table from the key of a pair to its position in m_pairs
+    std::vector<uint64_t> m_keys;
+    std::vector<unsigned> m_slots;
+
+    std::vector<BodyPair> m_begin_events;
+    std::vector<BodyPair> m_end_events;
+    unsigned m_swaps;
+    bool m_processed;       // The events are cleared by the next update
+    double m_max_extent;    // Largest x extent of the proxies seen since the last rebuild
+
+    // Scratch buffers of the rebuild
+    std::vector<unsigned> m_active;
+    std::vector<uint64_t> m_old_keys;
+    std::vector<uint64_t> m_new_keys;
+
+    void insert_proxy(const unsigned proxy);
+    void update_proxy(const unsigned proxy);
+    void rebuild();
+
+    void sort_min_down(const unsigned axis, unsigned index);
+    void sort_min_up(const unsigned axis, unsigned index);
+    void sort_max_down(const unsigned axis, unsigned index);
+    void sort_max_up(const unsigned axis, unsigned index);
+    void swap_endpoints(const unsigned axis, const unsigned i, const unsigned j);
+    bool overlap(const unsigned a, const unsigned b, const unsigned axis) const;
+
+    // Pair set changes with an event, skipped for the pairs that cannot collide
+    void add_pair(const unsigned a, const unsigned b);
+    void remove_pair(const unsigned a, const unsigned b);
+    // Without event
+    bool insert_pair(const unsigned a, const unsigned b);
+    void erase_pair(const size_t position);
+    size_t find_slot(const uint64_t key) const;
+    void erase_slot(size_t slot);
+    void grow_table();
+};
+
+#endif /* INCREMENTAL_SAP_H */
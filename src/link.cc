@@ -1,7 +1,5 @@
 #include <iostream>
 #include "link.h"
-#include "editor.h"
-#include "render.h"
 #include "rigid_body.h"
 #include "vector2.h"
 #include "config.h"
@@ -87,42 +85,6 @@ void Spring::apply(const double dt) {
     }
 }
 
-void Spring::draw(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawColor(renderer, spring_color.r, spring_color.g, spring_color.b, spring_color.a);
-    // render_line(renderer, B->get_p().x, B->get_p().y, A->get_p().x, A->get_p().y);
-    // if (A->is_movable())
-    //     A->draw_trace(renderer);
-    // if (B->is_movable())
-    //     B->draw_trace(renderer);
-    const Vector2 A_pos(A->get_p());
-    const Vector2 B_pos(B->get_p());
-    const Vector2 axis(A_pos - B_pos);
-    const double length(axis.norm());
-    const unsigned n_coils(l0 * 10);
-
-    if (n_coils > 0) {
-        const double anchor_height((length / (double)n_coils) / 2.0);
-        const double coil_height((length - anchor_height * 2) / (double)n_coils);
-        const Vector2 direction(axis.normalized());
-        for (unsigned i(0); i < n_coils; ++i) {
-            Vector2 coil_start(B_pos + direction * (anchor_height + coil_height * i));
-            draw_coil(renderer, coil_start, direction, coil_height);
-        }
-
-        const Vector2 A_anchor(A_pos - direction * anchor_height);
-        const Vector2 B_anchor(B_pos + direction * anchor_height);
-        render_line(renderer, A_pos, A_anchor);
-        render_line(renderer, B_pos, B_anchor);
-    }else {
-        render_line(renderer, A_pos, B_pos);
-    }
-
-#ifdef DEBUG
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-    render_point(renderer, equilibrium_pos);
-#endif
-}
-
 double Spring::energy() const {
     const double x(Vector2(B->get_p() - A->get_p()).norm() - l0);
     return 0.5 * k * x * x;
@@ -132,20 +94,6 @@ const Vector2 Spring::get_anchor() const {
     return A->get_p();
 }
 
-void Spring::draw_coil(SDL_Renderer* renderer, Vector2 start, Vector2 direction, double height) const {
-    //const double width(10e-2);
-    const double width(SCENE_WIDTH * 10e-3);
-    const double dw(width / 2.0);
-    const double dh(height / 4.0);
-    const Vector2 perp(direction.normal());
-    const Vector2 p1(start + direction * dh + perp * dw);
-    render_line(renderer, start, p1);
-    const Vector2 p2(p1 + direction * dh * 2 - perp * width);
-    render_line(renderer, p1, p2);
-    const Vector2 p3(p2 + direction * dh + perp * dw);
-    render_line(renderer, p2, p3);
-}
-
 
 // Spring::Spring(RigidBody* A, RigidBody* B, double stiffness, double length)
 // :   a(A),
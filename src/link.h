@@ -1,10 +1,14 @@
 #ifndef LINK_H
 #define LINK_H
 
-#include <SDL_render.h>
+#include "rigid_body.h" // steel_density
 #include "vector2.h"
 #include "utils.h"
 
+constexpr float spring_stiffness_default(0.5 * steel_density);
+constexpr float spring_stiffness_infinite(1e4f * steel_density);
+
+struct SDL_Renderer;
 class RigidBody;
 
 class Spring {
@@ -13,9 +17,11 @@ public:
 
     Spring(RigidBody* A_, RigidBody* B_, double length, float stiffness, DampingType damping);
     void apply(const double dt);
-    void draw(SDL_Renderer* renderer);
     double energy() const;
 
+    // Rendering, only defined by the demo application (see draw.cc)
+    void draw(SDL_Renderer* renderer);
+
     // const ScrollingBuffer& get_phase_data() const { return phase_portrait; }
     inline float get_stiffness() const { return k; }
     inline double get_x_eq() const { return x_eq; }
@@ -1,29 +1,90 @@
+#include <algorithm>
+#include <array>
 #include <climits>
+#include <cmath>
 #include <cassert>
 #include <cstdint>
 #include "narrow_phase.h"
 #include "shape.h"
+#include "profiler.h"
 #include "utils.h"
 #include "vector2.h"
 
 namespace {
-    // A 2D simplex (point, segment or triangle)
-    typedef std::vector<Vector2> Simplex;
-    // Pairs of the points of A and B that created the Minkowski difference points
-    typedef std::vector<std::array<Vector2, 2>> SourcePoints;
-
     constexpr unsigned GJK_max_iterations(1e4);
     constexpr unsigned GJK_dist_max_iterations(1e3);
     constexpr double   GJK_dist_epsilon(1e-7);
-    constexpr unsigned EPA_max_iterations(1e6);
+    // Points of the EPA polytope, each iteration adds one. Curved shapes need the most,
+    // the scenes stay under 64.
+    constexpr unsigned EPA_max_polytope(64);
     constexpr double   EPA_epsilon(1e-5);
+    // A reference face on B must beat the one on A by this much, so that the face does
+    // not switch between two equally deep axes from one step to the next
+    constexpr double   SAT_reference_tolerance(1e-6);
+    constexpr unsigned cast_max_iterations(30);
+    constexpr double   cast_tolerance(1e-4);
+
+    /**
+     * @brief Inline storage for at most N items, in place of a vector on the stack
+     */
+    template <typename T, unsigned N>
+    struct FixedVector {
+        std::array<T, N> items;
+        unsigned count = 0;
+
+        unsigned size() const { return count; }
+        bool full() const { return count == N; }
+        T& operator[](const unsigned i) { return items[i]; }
+        const T& operator[](const unsigned i) const { return items[i]; }
+        const T& back() const { return items[count - 1]; }
+
+        void push_back(const T& item) {
+            assert(count < N);
+            items[count++] = item;
+        }
+
+        void insert(const unsigned i, const T& item) {
+            assert(count < N);
+            for (unsigned j(count); j > i; --j) {
+                items[j] = items[j - 1];
+            }
+            items[i] = item;
+            ++count;
+        }
+
+        void erase(const unsigned i) {
+            for (unsigned j(i); j + 1 < count; ++j) {
+                items[j] = items[j + 1];
+            }
+            --count;
+        }
+    };
+
+    // A 2D simplex: point, segment or triangle
+    typedef FixedVector<Vector2, 3> Simplex;
+    // The simplex expanded by EPA
+    typedef FixedVector<Vector2, EPA_max_polytope> Polytope;
+    // Pairs of the points of A and B that created the points of a segment simplex
+    typedef FixedVector<std::array<Vector2, 2>, 2> SourcePoints;
+
+    // Result of the clipping of a segment, at most two points
+    struct ClippedPoints {
+        std::array<Vector2, 2> points;
+        unsigned count = 0;
+
+        void push_back(const Vector2& p) { points[count++] = p; }
+    };
+
+    NarrowPhaseStats stats;
 
     struct SimplexEdge {
         double distance = 0;
         Vector2 normal;
-        unsigned index = 0;
     };
 
+    // Edge i of the polytope goes from its point i to the next one
+    typedef FixedVector<SimplexEdge, EPA_max_polytope> PolytopeEdges;
+
     struct Edge {
         Vector2 closest_vertex;
         Vector2 A;
@@ -37,9 +98,10 @@ namespace {
      * @param s The initial simplex, empty
      * @param a Convex shape A
      * @param b Convex shape B
+     * @param cache Optional, simplex or direction to start from, updated with the last ones
      * @return Whether the shapes intersect or not.
      */
-    bool intersect_GJK(Simplex& s, SourcePoints& shape_points, Shape* a, Shape* b);
+    bool intersect_GJK(Simplex& s, Shape* a, Shape* b, SimplexCache* cache);
 
     /**
      * @brief Given a simplex, reduces it to its closest feature to the origin and finds the direction towards which it should be expanded in order to encompass the origin.
@@ -47,25 +109,29 @@ namespace {
      * @param direction The new direction towards the origin
      * @return Whether the newly created simplex contains the origin.
      */
-    bool nearest_simplex(Simplex& s, Vector2& direction, SourcePoints& points);
+    bool nearest_simplex(Simplex& s, Vector2& direction);
 
         /**
      * @brief Expanding Polytope Algorithm, finds the point in Minkowski difference the closest to the origin. EPA starts from the simplex given by GJK and iteratively expand it until one of its edges is close enough to the closest point to the origin on the Minkowski difference countour. It can then decuce the collision normal, the penetration depth and the contact points.
+     * The polytope holds at most EPA_max_polytope points, EPA stops on its closest edge when it is full.
      * @param s Simplex given by GJK
      * @param a Convex shape A
      * @param b Convex shape B
-     * @param shape_points The source points of A and B that were used to create the simplex
      * @param result The resulting information of the collision (normal, depth, contact points)
      */
-    void EPA(Simplex s, SourcePoints points, Shape* a, Shape* b, Manifold& result);
+    void EPA(const Simplex& s, Shape* a, Shape* b, Manifold& result);
+
+    /**
+     * @brief Computes the outward normal of an edge of the polytope and its distance to the origin.
+     * @param clockwise Whether the polytope is CW or CCW oriented
+     */
+    SimplexEdge polytope_edge(const Vector2& A, const Vector2& B, const bool clockwise);
 
     /**
-     * @brief Given a simplex, finds its closest edge to the origin.
-     * @param s Simplex containing the origin
-     * @param clockwise Whether the simplex is CW or CCW oriented
-     * @return The closest edge to the origin of the simplex.
+     * @brief Given the edges of a polytope, finds its closest edge to the origin.
+     * @return The index of the closest edge to the origin of the polytope.
      */
-    SimplexEdge closest_edge_to_origin(Simplex s, const bool clockwise);
+    unsigned closest_edge_to_origin(const PolytopeEdges& edges);
 
     /**
      * @brief Computes all the contact points (manifold) implied in a collision between two bodies.
@@ -84,13 +150,45 @@ namespace {
      */
     Edge closest_feature(Shape* body, Vector2 n);
 
-    std::vector<Vector2> clip_features(Vector2 v1, Vector2 v2, Vector2 edge, double threshold);
+    ClippedPoints clip_features(Vector2 v1, Vector2 v2, Vector2 edge, double threshold);
+
+    /**
+     * @brief Finds the edge of polygon a the farthest in front of polygon b, the separating axis candidate.
+     * @param edge The index of that edge
+     * @return The distance from that edge to the deepest vertex of b, > 0 when the polygons are separated.
+     */
+    double max_separation(const Shape* a, const Vertices& normals, const Shape* b, uint8_t& edge);
 
     /**
      * @brief Computes the distance between two non intersecting convex shapes.
+     * @param cache Optional, segment or direction to start from, updated with the last ones
      * @return The distance between the two shapes.
      */
-    double distance_GJK(Simplex& s, SourcePoints& points, const Shape* a, const Shape* b);
+    double distance_GJK(Simplex& s, SourcePoints& points, const Shape* a, const Shape* b, SimplexCache* cache);
+
+    /**
+     * @brief Finds the vertex of a polygon a support point was taken from.
+     * @return The index of the vertex, 0 for a circle.
+     */
+    uint8_t vertex_index(const Shape* shape, const Vector2& point);
+
+    /**
+     * @brief Whether vertex i of polygon A minus vertex j of polygon B is a vertex of their
+     * Minkowski difference: some direction has the first as support point of A, and its
+     * opposite the second as support point of B.
+     */
+    bool minkowski_vertex(const Shape* a, const uint8_t i, const Shape* b, const uint8_t j);
+
+    /**
+     * @brief Whether the direction lies in the normal cone of a vertex, between the normals of its two edges.
+     */
+    bool in_normal_cone(const Vector2& d, const Vector2& n0, const Vector2& n1);
+
+    /**
+     * @brief Whether the cached simplex can be rebuilt from the vertices of the two shapes.
+     * Circles have no vertex to index, only the direction is cached for them.
+     */
+    bool valid_simplex(const SimplexCache& cache, const Shape* a, const Shape* b);
 
     /**
      * @brief Finds the closest point to the origin on the edge formed by v1 and v2.
@@ -106,7 +204,18 @@ namespace {
      * @param points The respective points of the two shapes that created the simplex
      * @return The closest point on each shape.
      */
-    ClosestPoints convex_combination(Simplex s, const SourcePoints& points);
+    ClosestPoints convex_combination(const Simplex& s, const SourcePoints& points);
+
+    /**
+     * @brief Moves the proxy along the translation until it touches the target, each move
+     * being the distance between them over the speed along the separating direction.
+     * @param proxy Copy of the cast shape, moved in place
+     */
+    bool conservative_advancement(Shape& proxy, const Vector2 translation, Shape* target, CastOutput& output);
+}
+
+NarrowPhaseStats& narrow_phase_stats() {
+    return stats;
 }
 
 Vector2 support(const Shape* shape, const Vector2 d) {
@@ -115,7 +224,7 @@ Vector2 support(const Shape* shape, const Vector2 d) {
         support = shape->get_centroid() + d.normalized() * shape->get_radius();
     }else {
         double max(-INT_MAX);
-        const Vertices vert(shape->get_vertices());
+        const Vertices& vert(shape->get_vertices());
         const uint8_t count(shape->get_count());
         for (uint8_t i(0); i < count; ++i) {
             double proj(dot2(vert[i], d));
@@ -161,221 +270,416 @@ Manifold collide_circle_circle(Shape* a, Shape* b) {
 Manifold collide_circle_polygon(Shape* a, Shape* b) {
     Manifold result;
 
-    auto vertices(b->get_vertices());
-    const uint8_t vertices_count(b->get_count());
-    const Vector2 centroid_a(a->get_centroid());
-
-    // result.depth = INT_MAX;
-
-    // Separation Axis Theorem
-    for (uint8_t i(0); i < vertices_count; ++i) {
-        Vector2 A(vertices[i]);
-        Vector2 B(vertices[(i + 1) % vertices_count]);
-        Vector2 edge(B - A);
-        Vector2 normal(edge.normal());
-        Vector2 u(centroid_a - normal * a->get_radius() - vertices[i]);
-
-        double support_dist(dot2(u, normal));
-
-        if (support_dist >= 0) {
-            result.intersecting = false;
-            break;
+    const Vertices& vertices(b->get_vertices());
+    const Vertices& normals(b->get_normals());
+    const uint8_t count(b->get_count());
+    const Vector2 center(a->get_centroid());
+    const double radius(a->get_radius());
+
+    // Edge of largest separation from the center, along its outward normal
+    double separation(-INT_MAX);
+    uint8_t index(0);
+    Vector2 normal;
+    for (uint8_t i(0); i < count; ++i) {
+        const Vector2 n(normals[i]);
+        const double s(dot2(n, center - vertices[i]));
+        if (s > radius) {
+            return result;
         }
+        if (s > separation) {
+            separation = s;
+            index = i;
+            normal = n;
+        }
+    }
 
-        double projection(proj2(centroid_a, A, edge).norm());
-
-        if (projection < edge.norm() && dot2(u, edge) > 0) {
-            if (b->contains_point(u + A)) {
-                result.intersecting = true;
-                result.depth = abs(support_dist);
-                result.normal = -normal;
-                result.contact_points[0] = u + vertices[i] - result.normal * 0.5 * result.depth;
-                result.count = 1;
-                break;
-            }
-        }else {
-            if (a->contains_point(A)) {
-                double depth(a->get_radius() - (A - centroid_a).norm());
-
-                if (depth > result.depth) {
-                    result.intersecting = true;
-                    result.normal = (A - centroid_a).normalized();
-                    result.depth = depth;
-                    result.contact_points[0] = A;
-                    result.count = 1;
-                }
-            }else if (a->contains_point(B)) {
-                double depth(a->get_radius() - (B - centroid_a).norm());
-
-                if (depth > result.depth) {
-                    result.intersecting = true;
-                    result.normal = (B - centroid_a).normalized();
-                    result.depth = depth;
-                    result.contact_points[0] = B + result.normal * 0.5 * result.depth;
-                    result.count = 1;
-                }
+    const Vector2 v1(vertices[index]);
+    const Vector2 v2(vertices[(index + 1) % count]);
+
+    // Outside and beyond an end of the edge, the closest point of the polygon is that vertex
+    if (separation > 0) {
+        const bool before(dot2(center - v1, v2 - v1) <= 0);
+        if (before || dot2(center - v2, v1 - v2) <= 0) {
+            const Vector2 vertex(before ? v1 : v2);
+            const Vector2 d(vertex - center);
+            const double distance_2(dot2(d, d));
+            if (distance_2 > radius * radius) {
+                return result;
             }
+            const double distance(std::sqrt(distance_2));
+            result.intersecting = true;
+            result.normal = d / distance;
+            result.depth = radius - distance;
+            result.contact_points[0] = vertex;
+            result.count = 1;
+            return result;
         }
     }
 
+    // In front of the edge or inside the polygon
+    result.intersecting = true;
+    result.normal = -normal;
+    result.depth = radius - separation;
+    result.contact_points[0] = center - normal * separation;
+    result.count = 1;
+    return result;
+}
+
+Manifold collide_polygon_circle(Shape* a, Shape* b) {
+    Manifold result(collide_circle_polygon(b, a));
+    result.normal = -result.normal;
     return result;
 }
 
 Manifold collide_polygon_polygon(Shape* a, Shape* b) {
     Manifold result;
+    ++stats.sat_calls;
 
-    auto a_vertices(a->get_vertices());
-    const uint8_t a_count(a->get_count());
-    auto b_vertices(b->get_vertices());
-    const uint8_t b_count(b->get_count());
-
-    result.depth = INT_MAX;
-
-    // Separation Axis Theorem
-    for (uint8_t i(0); i < a_count; ++i) {
-        Vector2 edge(a_vertices[(i + 1) % a_count] - a_vertices[i]);
-        Vector2 normal(edge.normal());
-
-        bool all_in_front(true);
-        double current_depth(0);
-
-        for (auto vertex : b_vertices) {
-            double projection(dot2(vertex - a_vertices[i], normal));
-
-            if (projection <= 0) {
-                all_in_front = false;
+    // Separating axis test on the edge normals of both polygons
+    const Vertices& normals_a(a->get_normals());
+    uint8_t edge_a(0);
+    const double separation_a(max_separation(a, normals_a, b, edge_a));
+    if (separation_a > 0) {
+        return result;
+    }
 
-                if (abs(projection) > current_depth && a->contains_point(vertex)) {
-                    current_depth = abs(projection);
+    const Vertices& normals_b(b->get_normals());
+    uint8_t edge_b(0);
+    const double separation_b(max_separation(b, normals_b, a, edge_b));
+    if (separation_b > 0) {
+        return result;
+    }
 
-                    if (current_depth < result.depth) {
-                        result.depth = current_depth;
-                        result.normal = normal;
-                        result.contact_points[0] = vertex + result.normal * result.depth;
-                    }
-                }
-            }
-        }
-        if (all_in_front) {
-            result.intersecting = false;
-            return result;
+    // The reference face is the edge of least penetration, the incident face the edge of
+    // the other polygon the most opposed to it
+    const bool flip(separation_b > separation_a + SAT_reference_tolerance);
+    const Shape* ref(flip ? b : a);
+    const Shape* inc(flip ? a : b);
+    const Vertices& inc_normals(flip ? normals_a : normals_b);
+    const uint8_t ref_edge(flip ? edge_b : edge_a);
+    const Vector2 ref_normal(flip ? normals_b[edge_b] : normals_a[edge_a]);
+
+    const uint8_t inc_count(inc->get_count());
+    uint8_t inc_edge(0);
+    double min(INT_MAX);
+    for (uint8_t i(0); i < inc_count; ++i) {
+        const double d(dot2(ref_normal, inc_normals[i]));
+        if (d < min) {
+            min = d;
+            inc_edge = i;
         }
     }
 
-    double depth_2(INT_MAX);
-    Vector2 n_2;
-    Vector2 p_2;
-
-    for (uint8_t i(0); i < b_count; ++i) {
-        Vector2 edge(b_vertices[(i + 1) % b_count] - b_vertices[i]);
-        Vector2 normal(edge.normal());
-
-        bool all_in_front(true);
-        double current_depth(0);
-
-        for (auto vertex : a_vertices) {
-            double projection(dot2(vertex - b_vertices[i], normal));
-
-            if (projection <= 0) {
-                all_in_front = false;
-
-                if (abs(projection) > current_depth && b->contains_point(vertex)) {
-                    current_depth = abs(projection);
-
-                    if (current_depth < depth_2) {
-                        depth_2 = current_depth;
-                        n_2 = normal * -1;
-                        p_2 = vertex + n_2 * depth_2;
-                    }
-                }
-            }
-        }
-        if (all_in_front) {
-            result.intersecting = false;
-            return result;
-        }
+    const Vertices& ref_vertices(ref->get_vertices());
+    const Vertices& inc_vertices(inc->get_vertices());
+    const Vector2 v1(ref_vertices[ref_edge]);
+    const Vector2 v2(ref_vertices[(ref_edge + 1) % ref->get_count()]);
+    const Vector2 ref_dir((v2 - v1).normalized());
+
+    // Clip the incident face by the side planes of the reference face
+    ClippedPoints clipped(clip_features(inc_vertices[inc_edge], inc_vertices[(inc_edge + 1) % inc_count],
+                                        ref_dir, dot2(ref_dir, v1)));
+    if (clipped.count < 2) {
+        ++stats.clip_failed;
+        return result;
+    }
+    clipped = clip_features(clipped.points[0], clipped.points[1], -ref_dir, -dot2(ref_dir, v2));
+    if (clipped.count < 2) {
+        ++stats.clip_failed;
+        return result;
     }
 
-    if ((depth_2 >= result.depth && depth_2 != INT_MAX) || result.depth == INT_MAX) {
-        result.normal = n_2;
-        result.contact_points[0] = p_2;
-        result.depth = depth_2;
+    // Keep the clipped points behind the reference face
+    const double offset(dot2(ref_normal, v1));
+    for (unsigned i(0); i < clipped.count; ++i) {
+        if (dot2(ref_normal, clipped.points[i]) - offset <= 0) {
+            result.contact_points[result.count] = clipped.points[i];
+            ++result.count;
+        }
     }
+    stats.clip_two += (result.count == 2);
+    stats.clip_one += (result.count == 1);
+    stats.clip_failed += (result.count == 0);
 
-    result.intersecting = true;
+    result.intersecting = result.count > 0;
+    result.normal = flip ? -ref_normal : ref_normal;
+    result.depth = -(flip ? separation_b : separation_a);
     return result;
 }
 
-Manifold collide_convex(Shape* a, Shape* b, Timer& gjk, Timer& epa, Timer& clip) {
+Manifold collide_convex(Shape* a, Shape* b, SimplexCache* cache) {
     Manifold result;
     Simplex s;
-    SourcePoints points;
-    
-    gjk.reset();
-    result.intersecting = intersect_GJK(s, points, a, b);
-    gjk.halt();
+
+    {
+        PROFILE_ZONE("gjk");
+        result.intersecting = intersect_GJK(s, a, b, cache);
+    }
 
     if (result.intersecting) {
-        epa.reset();
-        EPA(s, points, a, b, result);
-        epa.halt();
+        {
+            PROFILE_ZONE("epa");
+            EPA(s, a, b, result);
+        }
 
-        clip.reset();
+        PROFILE_ZONE("clip");
         result = get_contact_points(a, b, result);
-        clip.halt();
-    }else {
-        epa.reset(true);
-        clip.reset(true);
     }
 
     return result;
 }
 
+const CollideKernel& get_collide_kernel(const ShapeType a, const ShapeType b) {
+    static const CollideKernel kernels[shape_type_count][shape_type_count] = {
+        // CIRCLE                                           POLYGON
+        {{collide_circle_circle, "circle_circle"},    {collide_circle_polygon, "circle_polygon"}},
+        {{collide_polygon_circle, "polygon_circle"},  {collide_polygon_polygon, "polygon_polygon"}}
+    };
+    return kernels[a][b];
+}
 
-DistanceInfo ditance_convex(const Shape* a, const Shape* b) {
+
+DistanceInfo ditance_convex(const Shape* a, const Shape* b, SimplexCache* cache) {
     DistanceInfo result;
 
     Simplex s;
     SourcePoints points;
-    result.distance = distance_GJK(s, points, a, b);
+    result.distance = distance_GJK(s, points, a, b, cache);
     result.points = convex_combination(s, points);
 
     return result;
 }
 
+bool raycast(const Shape* shape, const Vector2 p1, const Vector2 p2, CastOutput& output) {
+    const Vector2 d(p2 - p1);
+
+    if (shape->get_type() == CIRCLE) {
+        const Vector2 m(p1 - shape->get_centroid());
+        const double r(shape->get_radius());
+        const double a(dot2(d, d));
+        const double b(dot2(m, d));
+        const double c(dot2(m, m) - r * r);
+        const double discriminant(b * b - a * c);
+        if (c <= 0 || a == 0 || discriminant < 0) {
+            return false;
+        }
+        const double t((-b - std::sqrt(discriminant)) / a);
+        if (t < 0 || t > 1) {
+            return false;
+        }
+        output.fraction = t;
+        output.point = p1 + d * t;
+        output.normal = (m + d * t).normalized();
+        return true;
+    }
+
+    // Cyrus-Beck clipping of the segment by the half-planes of the edges
+    const Vertices& vertices(shape->get_vertices());
+    const Vertices& normals(shape->get_normals());
+    const uint8_t count(shape->get_count());
+    double lower(0);
+    double upper(1);
+    int index(-1);
+    Vector2 normal;
+    for (uint8_t i(0); i < count; ++i) {
+        const Vector2 n(normals[i]);
+        const double numerator(dot2(n, vertices[i] - p1));
+        const double denominator(dot2(n, d));
+        if (denominator == 0) {
+            if (numerator < 0) {
+                return false;
+            }
+        }else if (denominator < 0 && numerator < lower * denominator) {
+            // Entering the half-plane
+            lower = numerator / denominator;
+            index = i;
+            normal = n;
+        }else if (denominator > 0 && numerator < upper * denominator) {
+            upper = numerator / denominator;
+        }
+
+        if (upper < lower) {
+            return false;
+        }
+    }
+
+    // No edge entered: the ray starts inside
+    if (index < 0) {
+        return false;
+    }
+    output.fraction = lower;
+    output.point = p1 + d * lower;
+    output.normal = normal;
+    return true;
+}
+
+bool shape_cast(const Shape* shape, const Vector2 translation, Shape* target, CastOutput& output) {
+    if (shape->get_type() == CIRCLE) {
+        Circle proxy(*static_cast<const Circle*>(shape));
+        return conservative_advancement(proxy, translation, target, output);
+    }
+    Polygon proxy(*static_cast<const Polygon*>(shape));
+    return conservative_advancement(proxy, translation, target, output);
+}
+
 
 namespace {
 
-    bool intersect_GJK(Simplex& s, SourcePoints& shape_points, Shape* a, Shape* b) {
+    bool conservative_advancement(Shape& proxy, const Vector2 translation, Shape* target, CastOutput& output) {
+        // The proxy only translates: each distance query starts from the simplex of the previous one
+        SimplexCache cache;
+        const Manifold manifold(collide_convex(&proxy, target, &cache));
+        if (manifold.intersecting) {
+            output.fraction = 0;
+            output.point = manifold.contact_points[0];
+            output.normal = -manifold.normal;
+            return true;
+        }
+
+        double t(0);
+        Vector2 n(translation.normalized());
+        DistanceInfo info;
+        for (unsigned i(0); i < cast_max_iterations; ++i) {
+            info = ditance_convex(&proxy, target, &cache);
+            if (info.distance < cast_tolerance) {
+                break;
+            }
+            // The separating direction is kept from the last distance large enough to give it
+            n = (info.points.closest_b - info.points.closest_a) / info.distance;
+
+            // Moving away from the separating line, the shapes cannot meet
+            const double speed(dot2(translation, n));
+            if (speed <= 0) {
+                return false;
+            }
+            const double dt(info.distance / speed);
+            if (t + dt > 1) {
+                return false;
+            }
+            t += dt;
+            proxy.translate(translation * dt);
+        }
+
+        // Touching, or out of iterations and short of the contact
+        output.fraction = t;
+        output.point = info.points.closest_b;
+        output.normal = -n;
+        return true;
+    }
+
+    bool intersect_GJK(Simplex& s, Shape* a, Shape* b, SimplexCache* cache) {
+        ++stats.gjk_calls;
+        // Points of A and B that created the points of the simplex, only kept for the cache
+        FixedVector<std::array<Vector2, 2>, 3> points;
         Vector2 axis(1, 0);
-        Vector2 S(support(a, axis) - support(b, -axis));
-        s.push_back(S);
-        axis = -axis;
 
+        if (cache && cache->count == 3 && valid_simplex(*cache, a, b)) {
+            // EPA needs points on the boundary of the Minkowski difference. After the shapes
+            // rotated, a cached pair of vertices may no longer be one, it is then replaced by
+            // the support point in its direction.
+            ++stats.gjk_warm_starts;
+            const Vertices& vertices_a(a->get_vertices());
+            const Vertices& vertices_b(b->get_vertices());
+            for (uint8_t i(0); i < 3; ++i) {
+                const Vector2 supp_a(vertices_a[cache->index_a[i]]);
+                const Vector2 supp_b(vertices_b[cache->index_b[i]]);
+                if (minkowski_vertex(a, cache->index_a[i], b, cache->index_b[i])) {
+                    points.push_back({supp_a, supp_b});
+                }else {
+                    const Vector2 D(supp_a - supp_b);
+                    points.push_back({support(a, D), support(b, -D)});
+                }
+                s.push_back(points[i][0] - points[i][1]);
+            }
+
+            // Still holding the origin, the triangle is the answer and EPA starts from it
+            const std::array<double, 3> sides = {cross2(s[0], s[1]), cross2(s[1], s[2]), cross2(s[2], s[0])};
+            const double winding(sides[0] + sides[1] + sides[2]);
+            if (sides[0] * winding > 0 && sides[1] * winding > 0 && sides[2] * winding > 0) {
+                for (uint8_t i(0); i < 3; ++i) {
+                    cache->index_a[i] = vertex_index(a, points[i][0]);
+                    cache->index_b[i] = vertex_index(b, points[i][1]);
+                }
+                return true;
+            }
+
+            // Otherwise GJK goes on from an edge with the origin outside of it
+            unsigned edge(0);
+            while (edge < 3 && sides[edge] * winding > 0) {
+                ++edge;
+            }
+            if (edge < 3) {
+                const Simplex triangle(s);
+                const FixedVector<std::array<Vector2, 2>, 3> sources(points);
+                s.count = 0;
+                points.count = 0;
+                for (unsigned i : {edge, (edge + 1) % 3}) {
+                    s.push_back(triangle[i]);
+                    points.push_back(sources[i]);
+                }
+                nearest_simplex(s, axis);
+            }
+            if (edge == 3 || axis == vector2_zero) {
+                s.count = 0;
+                points.count = 0;
+                axis = {1, 0};
+            }
+        }else if (cache && cache->direction != vector2_zero) {
+            // The last search direction is the best guess of the separating axis
+            ++stats.gjk_warm_starts;
+            axis = -cache->direction;
+        }
+
+        if (s.size() == 0) {
+            points.push_back({support(a, axis), support(b, -axis)});
+            s.push_back(points[0][0] - points[0][1]);
+            axis = -axis;
+        }
+
+        bool intersecting(0);
         unsigned watchdog(GJK_max_iterations);
         while (--watchdog) {
+            ++stats.gjk_iterations;
             Vector2 supp_a(support(a, axis));
             Vector2 supp_b(support(b, -axis));
             Vector2 A(supp_a - supp_b);
 
             s.push_back(A);
-            shape_points.push_back({supp_a, supp_b});
+            points.push_back({supp_a, supp_b});
 
             if (dot2(A, axis) <= 0) {
-                return false;
+                break;
             }
 
-            if (nearest_simplex(s, axis, shape_points)) {
-                return true;
+            const Vector2 first(s[0]);
+            if (nearest_simplex(s, axis)) {
+                intersecting = 1;
+                break;
+            }
+            // The triangle lost its first or its second point
+            if (points.size() > s.size()) {
+                points.erase(s[0] == first ? 1 : 0);
             }
         }
-        return false;
+
+        if (cache) {
+            cache->direction = axis;
+            cache->count = 0;
+            if (intersecting && a->get_type() == POLYGON && b->get_type() == POLYGON) {
+                cache->count = 3;
+                for (uint8_t i(0); i < 3; ++i) {
+                    cache->index_a[i] = vertex_index(a, points[i][0]);
+                    cache->index_b[i] = vertex_index(b, points[i][1]);
+                }
+            }
+        }
+        return intersecting;
     }
 
-    bool nearest_simplex(Simplex& s, Vector2& D, SourcePoints& shape_points) {
+    bool nearest_simplex(Simplex& s, Vector2& D) {
         const Vector2 A(s.back());
         const Vector2 AO(-A);
-        const size_t n(s.size());
+        const unsigned n(s.size());
 
         if (n == 3) {
             const Vector2 B(s[1]);
@@ -388,13 +692,11 @@ namespace {
             const Vector2 AC_perp(triple_product(-AC, AB, AC));
 
             if (dot2(AB_perp, AO) > 0) {
-                s.erase(s.begin());
-                shape_points.erase(shape_points.begin());
+                s.erase(0);
                 D = AB_perp;
             }else {
                 if (dot2(AC_perp, AO) > 0) {
-                    s.erase(s.begin() + 1);
-                    shape_points.erase(shape_points.begin() + 1);
+                    s.erase(1);
                     D = AC_perp;
                 }else {
                     return true;
@@ -411,17 +713,33 @@ namespace {
         return false;
     }
 
-    void EPA(Simplex s, SourcePoints points, Shape* a, Shape* b, Manifold& result) {
+    void EPA(const Simplex& simplex, Shape* a, Shape* b, Manifold& result) {
+        Polytope s;
+        for (unsigned i(0); i < simplex.size(); ++i) {
+            s.push_back(simplex[i]);
+        }
+
         // Determine the winding of the simplex
         double winding(0);
-        for (size_t i(0); i < s.size() - 1; ++i) {
+        for (unsigned i(0); i < s.size() - 1; ++i) {
             winding += s[i].x * s[i + 1].y - s[i + 1].x * s[i].y;
         }
         const bool clockwise(winding < 0);
 
-        unsigned watchdog(EPA_max_iterations);
-        while (--watchdog) {
-            SimplexEdge e(closest_edge_to_origin(s, clockwise));
+        // Kept along the points, only the two edges around a new point change
+        PolytopeEdges edges;
+        for (unsigned i(0); i < s.size(); ++i) {
+            edges.push_back(polytope_edge(s[i], s[(i + 1) % s.size()], clockwise));
+        }
+
+        ++stats.epa_calls;
+        uint64_t iterations(0);
+        bool stopped(0);
+        while (1) {
+            ++iterations;
+            ++stats.epa_iterations;
+            const unsigned i(closest_edge_to_origin(edges));
+            const SimplexEdge e(edges[i]);
 
             Vector2 supp_a(support(a, e.normal));
             Vector2 supp_b(support(b, -e.normal));
@@ -429,46 +747,56 @@ namespace {
 
             double d(dot2(supp, e.normal));
 
-            if (d - e.distance < EPA_epsilon) {
+            // Converged, or out of room: the depth is then between e.distance and d
+            const bool converged(d - e.distance < EPA_epsilon);
+            if (converged || s.full()) {
+                stopped = !converged;
                 result.normal = e.normal;
                 result.depth = d;
                 // Vector2 MTV(-e.normal * d);
                 break;
-            }else {
-                s.insert(s.begin() + e.index, supp);
-                points.insert(points.begin() + e.index, {supp_a, supp_b});
             }
-        }        
+            s.insert(i + 1, supp);
+            edges[i] = polytope_edge(s[i], supp, clockwise);
+            edges.insert(i + 1, polytope_edge(supp, s[(i + 2) % s.size()], clockwise));
+        }
+
+        stats.epa_max_iterations = std::max(stats.epa_max_iterations, iterations);
+        stats.epa_polytope += s.size();
+        stats.epa_max_polytope = std::max(stats.epa_max_polytope, (uint64_t)s.size());
+        stats.epa_watchdog += stopped;
     }
 
-    SimplexEdge closest_edge_to_origin(Simplex s, const bool clockwise) {
-        SimplexEdge closest;
-        closest.distance = INT_MAX;
+    SimplexEdge polytope_edge(const Vector2& A, const Vector2& B, const bool clockwise) {
+        Vector2 edge(B - A);
+        // Vector2 ABO(triple_product(edge * -1, edge, A).normalized());
+        Vector2 ABO;
+        if (clockwise) {
+            ABO = {-edge.y, edge.x};
+        }else {
+            ABO = {edge.y, -edge.x};
+        }
 
-        for (size_t i(0); i < s.size(); i++) {
-            size_t j((i + 1) == s.size() ? 0 : i + 1);
-            Vector2 A(s[i]);
-            Vector2 B(s[j]);
-            Vector2 edge(B - A);
-            // Vector2 ABO(triple_product(edge * -1, edge, A).normalized());
-            Vector2 ABO;
-            if (clockwise) {
-                ABO = {edge.y, -edge.x};
-            }else {
-                ABO = {-edge.y, edge.x};
-            }
-            ABO = ABO.normalized();
-            // Distance from the origin to the edge
-            double d(dot2(ABO, A));
+        SimplexEdge result;
+        result.normal = ABO.normalized();
+        // Distance from the origin to the edge
+        result.distance = dot2(result.normal, A);
+        return result;
+    }
+
+    unsigned closest_edge_to_origin(const PolytopeEdges& edges) {
+        double closest(INT_MAX);
+        unsigned index(0);
+
+        for (unsigned i(0); i < edges.size(); i++) {
             // Check the distance against the other distances
-            if (d < closest.distance) {
-                closest.distance = d;
-                closest.normal = ABO;
-                closest.index = j;
+            if (edges[i].distance < closest) {
+                closest = edges[i].distance;
+                index = i;
             }
         }
 
-        return closest;
+        return index;
     }
 
 
@@ -481,12 +809,14 @@ namespace {
         if (a->get_type() != POLYGON) {
             result.contact_points[0] = support(a, n);
             result.count = 1;
+            ++stats.clip_curved;
             return result;
         }
 
         if (b->get_type() != POLYGON) {
             result.contact_points[0] = support(b, -n);
             result.count = 1;
+            ++stats.clip_curved;
             return result;
         }
 
@@ -505,39 +835,37 @@ namespace {
         Vector2 ref_dir((ref.B - ref.A).normalized());
 
         double threshold1(dot2(ref_dir, ref.A));
-        std::vector<Vector2> clipped(clip_features(inc.A, inc.B, ref_dir, threshold1));
-        if (clipped.size() < 2) {
+        ClippedPoints clipped(clip_features(inc.A, inc.B, ref_dir, threshold1));
+        if (clipped.count < 2) {
+            ++stats.clip_failed;
             return manifold;
         }
 
         double threshold2(dot2(ref_dir, ref.B));
-        clipped = clip_features(clipped[0], clipped[1], -ref_dir, -threshold2);
-        if (clipped.size() < 2) {
+        clipped = clip_features(clipped.points[0], clipped.points[1], -ref_dir, -threshold2);
+        if (clipped.count < 2) {
+            ++stats.clip_failed;
             return manifold;
         }
 
         Vector2 ref_normal(-ref_dir.normal());
 
         double max(dot2(ref_normal, ref.closest_vertex));
-        if (dot2(ref_normal, clipped[0]) < max) {
-            clipped.erase(clipped.begin());
-        }
-        if (dot2(ref_normal, clipped.back()) < max) {
-            clipped.erase(clipped.begin() + clipped.size() - 1);
-        }
-
-        assert(clipped.size() <= 2);
-
-        for (unsigned i(0); i < clipped.size(); ++i) {
-            result.contact_points[i] = clipped[i];
-            ++result.count;
+        for (unsigned i(0); i < clipped.count; ++i) {
+            if (dot2(ref_normal, clipped.points[i]) >= max) {
+                result.contact_points[result.count] = clipped.points[i];
+                ++result.count;
+            }
         }
+        stats.clip_two += (result.count == 2);
+        stats.clip_one += (result.count == 1);
+        stats.clip_failed += (result.count == 0);
 
         return result;
     }
 
     Edge closest_feature(Shape* shape, Vector2 n) {
-        const Vertices vertices(shape->get_vertices());
+        const Vertices& vertices(shape->get_vertices());
         const uint8_t count(shape->get_count());
         unsigned index(0);
 
@@ -564,8 +892,8 @@ namespace {
         return Edge(v, v, v1);
     }
 
-    std::vector<Vector2> clip_features(Vector2 v1, Vector2 v2, Vector2 edge, double threshold) {
-        std::vector<Vector2> clipped;
+    ClippedPoints clip_features(Vector2 v1, Vector2 v2, Vector2 edge, double threshold) {
+        ClippedPoints clipped;
         double d1(dot2(edge, v1) - threshold);
         double d2(dot2(edge, v2) - threshold);
 
@@ -588,24 +916,72 @@ namespace {
         return clipped;
     }
 
+    double max_separation(const Shape* a, const Vertices& normals, const Shape* b, uint8_t& edge) {
+        const Vertices& vertices_a(a->get_vertices());
+        const Vertices& vertices_b(b->get_vertices());
+        const uint8_t count_a(a->get_count());
+        const uint8_t count_b(b->get_count());
 
-    double distance_GJK(Simplex& s, SourcePoints& points, const Shape* a, const Shape* b) {
-        Vector2 D(a->get_centroid() - b->get_centroid());
+        double max(-INT_MAX);
+        for (uint8_t i(0); i < count_a; ++i) {
+            const Vector2 n(normals[i]);
+            const double offset(dot2(n, vertices_a[i]));
+
+            // Deepest vertex of b behind the edge
+            double min(INT_MAX);
+            for (uint8_t j(0); j < count_b; ++j) {
+                min = std::min(min, dot2(n, vertices_b[j]) - offset);
+            }
+
+            if (min > max) {
+                max = min;
+                edge = i;
+            }
+        }
+        return max;
+    }
 
-        Vector2 supp_a1(support(a, D));
-        Vector2 supp_b1(support(b, -D));
-        s.push_back(supp_a1 - supp_b1);
-        points.push_back({supp_a1, supp_b1});
 
-        Vector2 supp_a2(support(a, -D));
-        Vector2 supp_b2(support(b, D));
-        s.push_back(supp_a2 - supp_b2);
-        points.push_back({supp_a2, supp_b2});
+    double distance_GJK(Simplex& s, SourcePoints& points, const Shape* a, const Shape* b, SimplexCache* cache) {
+        ++stats.distance_calls;
+
+        // The cached segment of the last query on the pair, if it is still one
+        if (cache && cache->count == 2 && valid_simplex(*cache, a, b)) {
+            const Vertices& vertices_a(a->get_vertices());
+            const Vertices& vertices_b(b->get_vertices());
+            for (uint8_t i(0); i < 2; ++i) {
+                const Vector2 supp_a(vertices_a[cache->index_a[i]]);
+                const Vector2 supp_b(vertices_b[cache->index_b[i]]);
+                s.push_back(supp_a - supp_b);
+                points.push_back({supp_a, supp_b});
+            }
+            if (s[0] == s[1]) {
+                s.count = 0;
+                points.count = 0;
+            }
+        }
+
+        // Otherwise the centroids give the direction, exact for circles
+        Vector2 D(a->get_centroid() - b->get_centroid());
+        if (s.size() == 0) {
+            Vector2 supp_a1(support(a, D));
+            Vector2 supp_b1(support(b, -D));
+            s.push_back(supp_a1 - supp_b1);
+            points.push_back({supp_a1, supp_b1});
+
+            Vector2 supp_a2(support(a, -D));
+            Vector2 supp_b2(support(b, D));
+            s.push_back(supp_a2 - supp_b2);
+            points.push_back({supp_a2, supp_b2});
+        }else {
+            ++stats.gjk_warm_starts;
+        }
 
         D = closest_point_to_origin(s[0], s[1]);
 
         unsigned watchdog(GJK_dist_max_iterations);
         while (--watchdog) {
+            ++stats.distance_iterations;
             D = -D;
 
             // assert(D != Vector2::zero());
@@ -620,6 +996,18 @@ namespace {
             double da(dot2(s[0], D));
 
             if (dc - da < GJK_dist_epsilon) {
+                if (cache) {
+                    // Same sense as the GJK search direction, towards the origin
+                    cache->direction = D;
+                    cache->count = 0;
+                    if (a->get_type() == POLYGON && b->get_type() == POLYGON) {
+                        cache->count = 2;
+                        for (uint8_t i(0); i < 2; ++i) {
+                            cache->index_a[i] = vertex_index(a, points[i][0]);
+                            cache->index_b[i] = vertex_index(b, points[i][1]);
+                        }
+                    }
+                }
                 return D.norm();
             }
 
@@ -640,6 +1028,50 @@ namespace {
         return 0;
     }
 
+    uint8_t vertex_index(const Shape* shape, const Vector2& point) {
+        if (shape->get_type() != POLYGON) {
+            return 0;
+        }
+        // Support points are copies of the vertices
+        const Vertices& vertices(shape->get_vertices());
+        const uint8_t count(shape->get_count());
+        for (uint8_t i(0); i < count; ++i) {
+            if (vertices[i] == point) {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    bool minkowski_vertex(const Shape* a, const uint8_t i, const Shape* b, const uint8_t j) {
+        const Vertices& normals_a(a->get_normals());
+        const Vertices& normals_b(b->get_normals());
+        const Vector2 a0(normals_a[i == 0 ? a->get_count() - 1 : i - 1]);
+        const Vector2 a1(normals_a[i]);
+        const Vector2 b0(-normals_b[j == 0 ? b->get_count() - 1 : j - 1]);
+        const Vector2 b1(-normals_b[j]);
+        // Two cones narrower than a half-plane overlap when one holds a side of the other
+        return in_normal_cone(a0, b0, b1) || in_normal_cone(a1, b0, b1)
+            || in_normal_cone(b0, a0, a1) || in_normal_cone(b1, a0, a1);
+    }
+
+    bool in_normal_cone(const Vector2& d, const Vector2& n0, const Vector2& n1) {
+        const double side(cross2(n0, n1));
+        return cross2(n0, d) * side >= 0 && cross2(d, n1) * side >= 0;
+    }
+
+    bool valid_simplex(const SimplexCache& cache, const Shape* a, const Shape* b) {
+        if (a->get_type() != POLYGON || b->get_type() != POLYGON) {
+            return false;
+        }
+        for (uint8_t i(0); i < cache.count; ++i) {
+            if (cache.index_a[i] >= a->get_count() || cache.index_b[i] >= b->get_count()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
     Vector2 closest_point_to_origin(const Vector2& v1, const Vector2& v2) {
         Vector2 AB(v2 - v1);
         Vector2 AO(-v1);
@@ -665,7 +1097,7 @@ namespace {
         return v2;
     }
 
-    ClosestPoints convex_combination(Simplex s, const SourcePoints& shape_points) {
+    ClosestPoints convex_combination(const Simplex& s, const SourcePoints& shape_points) {
         ClosestPoints points;
 
         Vector2 p1_a(shape_points[0][0]);
@@ -2,11 +2,10 @@
 #define NARROW_PHASE_H
 
 #include <array>
+#include <cstdint>
+#include "shape.h"
 #include "vector2.h"
 
-struct Timer;
-class Shape;
-
 struct Manifold {
     bool intersecting = false;
     Vector2 normal;
@@ -25,32 +24,117 @@ struct DistanceInfo {
     ClosestPoints points;
 };
 
+// Last simplex of a GJK query on a pair of shapes, to start the next query on the same pair from
+struct SimplexCache {
+    uint8_t count = 0;                  // Points of the simplex, only kept for polygon pairs
+    std::array<uint8_t, 3> index_a{};   // Vertices of A and B that made each point
+    std::array<uint8_t, 3> index_b{};
+    Vector2 direction;                  // Last search direction, towards the origin from A - B, zero when unknown
+};
+
+// Hit of a ray or a shape cast
+struct CastOutput {
+    Vector2 point;
+    Vector2 normal;         // Surface normal of the hit shape, against the cast
+    double fraction = 0;    // Of the ray or translation covered at the hit
+};
+
+// Counters of the narrow phase kernels, accumulated until reset
+struct NarrowPhaseStats {
+    uint64_t gjk_calls = 0;
+    uint64_t gjk_iterations = 0;
+    uint64_t gjk_warm_starts = 0;       // GJK and distance queries started from a cached simplex
+    uint64_t epa_calls = 0;
+    uint64_t epa_iterations = 0;
+    uint64_t epa_max_iterations = 0;    // Longest single EPA run
+    uint64_t epa_polytope = 0;          // Final polytope sizes, summed
+    uint64_t epa_max_polytope = 0;
+    uint64_t epa_watchdog = 0;          // EPA runs stopped by a full polytope
+    uint64_t sat_calls = 0;             // Polygon pairs
+    uint64_t distance_calls = 0;
+    uint64_t distance_iterations = 0;
+
+    // Outcomes of the contact points computation
+    uint64_t clip_curved = 0;           // Circle involved in collide_convex, single support point
+    uint64_t clip_two = 0;
+    uint64_t clip_one = 0;
+    uint64_t clip_failed = 0;           // No contact point left after clipping
+
+    void reset() { *this = NarrowPhaseStats(); }
+};
+
+/**
+ * @brief Global narrow phase counters, used by the benchmarks
+ */
+NarrowPhaseStats& narrow_phase_stats();
+
 /**
  * @brief Computes the support point of a convex shape following a given direction
  * @return 
  */
 Vector2 support(const Shape* shape, const Vector2 d);
 
-// SAT
+// Closed form kernels, the normal of the manifold goes from a to b
 Manifold collide_circle_circle(Shape* a, Shape* b);
+/**
+ * @brief Collides circle a with polygon b, on the polygon edge the farthest from the center
+ * and its Voronoi regions: no iteration, one contact point on the surface of the polygon.
+ */
 Manifold collide_circle_polygon(Shape* a, Shape* b);
+Manifold collide_polygon_circle(Shape* a, Shape* b);
+/**
+ * @brief Collides two polygons by the separating axis test on their edge normals, then clips
+ * the incident face against the side planes of the reference face: up to two contact points,
+ * in O(n.m) with no iteration.
+ */
 Manifold collide_polygon_polygon(Shape* a, Shape* b);
 
 /**
  * @brief Determines if two convex shapes are colliding, and computes the contact manifold.
  * Uses GJK for colliion detection, EPA for penetration vector,
  * and clipping for contact point(s) calculation.
+ * @param cache Optional, GJK starts from it and leaves its last simplex in it. Only shape casts
+ * pass one, across the queries of a conservative advancement: the step collides pairs through
+ * get_collide_kernel without a cache, and only warm starts its distance proxies.
  * @return The contact manifold, containing all the information needed to solve the collision.
  */
-Manifold collide_convex(Shape* a, Shape* b, Timer& gjk, Timer& epa, Timer& clip);
+Manifold collide_convex(Shape* a, Shape* b, SimplexCache* cache = nullptr);
+
+typedef Manifold (*CollideFunction)(Shape* a, Shape* b);
+
+struct CollideKernel {
+    CollideFunction collide;
+    const char* name;       // Profiler zone
+};
+
+/**
+ * @brief Kernel of a pair of shape types, from a table indexed by both types. collide_convex
+ * remains the general kernel for the convex shapes without a closed form test.
+ */
+const CollideKernel& get_collide_kernel(const ShapeType a, const ShapeType b);
 
 /**
  * @brief Performs a proximity query: computes the euclidian distance between two convex shapes a and b, as well as their closest points from each other.
  * @param a Convex shape A
  * @param b Convex shape B
+ * @param cache Optional, GJK starts from it and leaves its last simplex in it
  * @return The proximity info, containing the distance and the closest points.
  */
-DistanceInfo ditance_convex(const Shape* a, const Shape* b);
+DistanceInfo ditance_convex(const Shape* a, const Shape* b, SimplexCache* cache = nullptr);
+
+/**
+ * @brief Casts the segment from p1 to p2 against a convex shape.
+ * A ray starting inside the shape does not hit it.
+ * @return Whether the ray hits the shape, the hit being written to output.
+ */
+bool raycast(const Shape* shape, const Vector2 p1, const Vector2 p2, CastOutput& output);
+
+/**
+ * @brief Sweeps a convex shape along a translation against a target shape, by conservative
+ * advancement on the GJK distance. A shape already overlapping the target hits it at fraction 0.
+ * @return Whether the shape hits the target before the end of the translation.
+ */
+bool shape_cast(const Shape* shape, const Vector2 translation, Shape* target, CastOutput& output);
 
 
 #endif /* NARROW_PHASE_H */
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include "profiler.h"
+#include "utils.h"
+
+namespace {
+    Profiler instance;
+
+    int64_t clock_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The ticks to microseconds ratio stops being refined after this duration
+    constexpr int64_t calibration_duration_ns(1e9);
+    // Duration of the measure of the ratio used by a trace
+    constexpr int64_t trace_calibration_ns(1e7);
+}
+
+Profiler& profiler() {
+    return instance;
+}
+
+uint32_t profiler_thread_id() {
+    static std::atomic<uint32_t> next_id(1);
+    thread_local const uint32_t id(next_id++);
+    return id;
+}
+
+Profiler::Profiler()
+:   m_frames(0),
+    m_calibration_ticks(profiler_ticks()),
+    m_calibration_ns(clock_ns()),
+    m_us_per_tick(0),
+    m_tracing(false),
+    m_trace_events(0),
+    m_trace_origin(0),
+    m_trace_us_per_tick(0),
+    m_trace_pending(false),
+    m_trace_stop(false)
+{
+    Zone root;
+    root.name = "root";
+    m_zones.push_back(root);
+    m_stack.push_back(0);
+}
+
+Profiler::~Profiler() {
+    if (m_tracing) {
+        stop_trace();
+    }
+}
+
+unsigned Profiler::add_zone(const char* name) {
+    const unsigned parent(m_stack.back());
+
+    // Same name from another call site or translation unit
+    for (unsigned child : m_zones[parent].children) {
+        if (std::strcmp(m_zones[child].name, name) == 0) {
+            m_stack.push_back(child);
+            return child;
+        }
+    }
+
+    Zone zone;
+    zone.name = name;
+    zone.parent = parent;
+    zone.depth = m_zones[parent].depth + 1;
+    const unsigned index(m_zones.size());
+    m_zones.push_back(zone);
+    m_zones[parent].children.push_back(index);
+    m_stack.push_back(index);
+
+    return index;
+}
+
+void Profiler::calibrate() {
+    const int64_t elapsed_ns(clock_ns() - m_calibration_ns);
+    if (m_us_per_tick > 0 && elapsed_ns > calibration_duration_ns) {
+        return;
+    }
+
+    const uint64_t elapsed_ticks(profiler_ticks() - m_calibration_ticks);
+    if (elapsed_ticks > 0) {
+        m_us_per_tick = 1e-3 * elapsed_ns / elapsed_ticks;
+    }
+}
+
+void Profiler::end_frame() {
+    assert(m_stack.size() == 1);
+    calibrate();
+
+    const unsigned slot(m_frames % profiler_history_size);
+    for (auto& zone : m_zones) {
+        const double time(zone.ticks * m_us_per_tick);
+        zone.last = time;
+        zone.last_calls = zone.calls;
+        zone.history[slot] = time;
+
+        if (zone.calls) {
+            zone.min = zone.frames ? std::min(zone.min, time) : time;
+            zone.max = zone.frames ? std::max(zone.max, time) : time;
+            zone.total += time;
+            zone.total_calls += zone.calls;
+            ++zone.frames;
+        }
+
+        zone.ticks = 0;
+        zone.calls = 0;
+    }
+    ++m_frames;
+
+    if (m_tracing) {
+        flush_trace();
+    }
+}
+
+void Profiler::reset() {
+    for (auto& zone : m_zones) {
+        Zone cleared;
+        cleared.name = zone.name;
+        cleared.parent = zone.parent;
+        cleared.depth = zone.depth;
+        cleared.children = std::move(zone.children);
+        zone = std::move(cleared);
+    }
+    m_frames = 0;
+}
+
+bool Profiler::start_trace(const std::string& path, const size_t capacity) {
+    if (m_tracing) {
+        stop_trace();
+    }
+    m_trace_file.open(path);
+    if (!m_trace_file) {
+        std::cerr << "Could not open " << path << "\n";
+        m_trace_file.clear();
+        return false;
+    }
+    m_trace_file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n" << std::fixed << std::setprecision(3);
+
+    // The buffers are written with one ratio, calibrate() keeps refining its own
+    const uint64_t ticks(profiler_ticks());
+    const int64_t ns(clock_ns());
+    std::this_thread::sleep_for(std::chrono::nanoseconds(trace_calibration_ns));
+    m_trace_us_per_tick = 1e-3 * (clock_ns() - ns) / std::max<uint64_t>(1, profiler_ticks() - ticks);
+
+    m_trace.clear();
+    m_trace.reserve(capacity);
+    m_trace_full.clear();
+    m_trace_full.reserve(capacity);
+    m_trace_threads.clear();
+    m_trace_events = 0;
+    m_trace_pending = false;
+    m_trace_stop = false;
+    m_trace_origin = profiler_ticks();
+    m_writer = std::thread(&Profiler::write_trace, this);
+    m_tracing = true;
+    return true;
+}
+
+bool Profiler::stop_trace() {
+    if (!m_tracing) {
+        return false;
+    }
+    m_tracing = false;
+    flush_trace();
+    {
+        std::lock_guard<std::mutex> lock(m_trace_mutex);
+        m_trace_stop = true;
+    }
+    m_trace_condition.notify_all();
+    m_writer.join();
+
+    for (uint32_t thread : m_trace_threads) {
+        m_trace_file << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread
+                     << ", \"args\": {\"name\": \"" << (thread == 1 ? "simulation" : "worker " + std::to_string(thread))
+                     << "\"}},\n";
+    }
+    m_trace_file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"physics2d\"}}\n"
+                 << "]}\n";
+    m_trace_file.close();
+
+    const bool written(!m_trace_file.fail());
+    if (!written) {
+        std::cerr << "Could not write the whole trace\n";
+    }
+    m_trace_file.clear();
+    return written;
+}
+
+void Profiler::flush_trace() {
+    if (m_trace.empty()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_trace_mutex);
+        m_trace_condition.wait(lock, [this] { return !m_trace_pending; });
+        m_trace.swap(m_trace_full);
+        m_trace_pending = true;
+    }
+    m_trace_condition.notify_all();
+}
+
+void Profiler::write_trace() {
+    std::unique_lock<std::mutex> lock(m_trace_mutex);
+    while (true) {
+        m_trace_condition.wait(lock, [this] { return m_trace_pending || m_trace_stop; });
+        if (!m_trace_pending) {
+            return;
+        }
+        lock.unlock();
+
+        // Formatted by hand, streaming each field is several times slower than recording
+        for (const auto& event : m_trace_full) {
+            if (std::find(m_trace_threads.begin(), m_trace_threads.end(), event.thread) == m_trace_threads.end()) {
+                m_trace_threads.push_back(event.thread);
+            }
+            char line[256];
+            const int length(std::snprintf(line, sizeof(line),
+                    "{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f},\n",
+                    event.name, event.thread, (int64_t)(event.begin - m_trace_origin) * m_trace_us_per_tick,
+                    (event.end - event.begin) * m_trace_us_per_tick));
+            m_trace_file.write(line, std::min<int>(length, sizeof(line) - 1));
+        }
+        m_trace_full.clear();
+
+        lock.lock();
+        m_trace_pending = false;
+        m_trace_condition.notify_all();
+    }
+}
+
+double Profiler::get_last(const std::string& name) const {
+    double time(0);
+    for (const auto& zone : m_zones) {
+        if (name == zone.name) {
+            time += zone.last;
+        }
+    }
+    return time;
+}
+
+double Profiler::get_average(const std::string& name) const {
+    double time(0);
+    for (const auto& zone : m_zones) {
+        if (name == zone.name && m_frames) {
+            time += zone.total / m_frames;
+        }
+    }
+    return time;
+}
+
+std::string Profiler::dump() const {
+    std::string text;
+
+    // Depth-first walk, children in order of first entry
+    std::vector<unsigned> stack(m_zones[0].children.rbegin(), m_zones[0].children.rend());
+    while (!stack.empty()) {
+        const Zone& zone(m_zones[stack.back()]);
+        stack.pop_back();
+
+        text += std::string(2 * (zone.depth - 1), ' ') + (zone.depth > 1 ? "> " : "") + zone.name
+              + " : " + truncate_to_string(zone.last / 1e3) + " ms"
+              + " (avg " + truncate_to_string(zone.average() / 1e3)
+              + ", min " + truncate_to_string(zone.min / 1e3)
+              + ", max " + truncate_to_string(zone.max / 1e3) + ")";
+        if (zone.last_calls > 1) {
+            text += " x" + std::to_string(zone.last_calls);
+        }
+        text += "\n";
+
+        stack.insert(stack.end(), zone.children.rbegin(), zone.children.rend());
+    }
+
+    return text;
+}
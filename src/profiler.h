@@ -0,0 +1,245 @@
+// Hierarchical zone profiler
+//
+// A zone is a scope timed with PROFILE_ZONE("name"). Zones entered while another one
+// is open become its children, so the same name can appear at several places of the tree.
+// Timings are accumulated during a frame (one World::step) and turned into statistics
+// (last, min, average, max and history) by Profiler::end_frame().
+// Every zone can also be recorded in a trace, streamed to a file in the Chrome Trace Event
+// format (chrome://tracing, https://ui.perfetto.dev) by a writer thread.
+// Without PROFILER defined in config.h, the macros compile to nothing.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "config.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+constexpr unsigned profiler_history_size(128);
+constexpr size_t profiler_trace_capacity(1 << 18);   // Events of each trace buffer, 32 bytes each
+
+/**
+ * @brief Reads the fastest monotonic counter available, the time stamp counter on x86
+ */
+inline uint64_t profiler_ticks() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/**
+ * @brief Small sequential identifier of the calling thread, 1 for the first thread that asks
+ */
+uint32_t profiler_thread_id();
+
+class Profiler {
+public:
+    struct Zone {
+        const char* name = nullptr;
+        int parent = -1;
+        unsigned depth = 0;
+        std::vector<unsigned> children;
+
+        // Current frame
+        uint64_t ticks = 0;
+        unsigned calls = 0;
+
+        // Finished frames (microseconds)
+        double last = 0;
+        unsigned last_calls = 0;
+        double min = 0;
+        double max = 0;
+        double total = 0;
+        uint64_t total_calls = 0;
+        unsigned frames = 0;        // Frames in which the zone was entered
+        std::array<float, profiler_history_size> history{};
+
+        double average() const { return frames ? total / frames : 0; }
+        double average_calls() const { return frames ? (double)total_calls / frames : 0; }
+    };
+
+    // Closed zone recorded by the trace
+    struct TraceEvent {
+        const char* name;
+        uint32_t thread;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    Profiler();
+    ~Profiler();
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    /**
+     * @brief Opens a zone as a child of the innermost open zone
+     * @return The index of the zone
+     */
+    inline unsigned enter(const char* name) {
+        Zone& current(m_zones[m_stack.back()]);
+        for (unsigned child : current.children) {
+            if (m_zones[child].name == name) {
+                m_stack.push_back(child);
+                return child;
+            }
+        }
+        return add_zone(name);
+    }
+
+    /**
+     * @brief Closes the innermost open zone, started at the given tick
+     */
+    inline void leave(const uint64_t start) {
+        const uint64_t end(profiler_ticks());
+        Zone& zone(m_zones[m_stack.back()]);
+        zone.ticks += end - start;
+        ++zone.calls;
+        if (m_tracing) {
+            record(zone.name, start, end);
+        }
+        m_stack.pop_back();
+    }
+
+    /**
+     * @brief Turns the timings of the current frame into statistics, must be called with no open zone.
+     * Hands the events of the frame to the trace writer when tracing.
+     */
+    void end_frame();
+
+    /**
+     * @brief Clears the statistics, keeps the zone tree
+     */
+    void reset();
+
+    /**
+     * @brief Starts recording every closed zone into a Chrome Trace Event JSON file.
+     * The events fill one of two buffers, allocated here so that recording never allocates.
+     * At each end_frame, or when it is full, the buffer is swapped with the other one and
+     * appended to the file by a writer thread, so that no event is dropped.
+     * @return Whether the file could be opened
+     */
+    bool start_trace(const std::string& path, const size_t capacity = profiler_trace_capacity);
+    /**
+     * @brief Writes the last events and closes the file
+     * @return Whether the whole trace could be written
+     */
+    bool stop_trace();
+    bool is_tracing() const { return m_tracing; }
+    size_t get_trace_size() const { return m_trace_events; }   // Events of the current or last trace
+
+    /**
+     * @brief Conversion factor from profiler_ticks() to microseconds
+     */
+    double get_us_per_tick() { calibrate(); return m_us_per_tick; }
+
+    const std::vector<Zone>& get_zones() const { return m_zones; }
+    unsigned get_frame_count() const { return m_frames; }
+    unsigned get_history_offset() const { return m_frames % profiler_history_size; }
+
+    /**
+     * @brief Time spent in the last frame by all the zones with the given name (microseconds)
+     */
+    double get_last(const std::string& name) const;
+
+    /**
+     * @brief Average time per frame of all the zones with the given name (microseconds)
+     */
+    double get_average(const std::string& name) const;
+
+    /**
+     * @brief Text tree of the zones with their last, average, min and max times
+     */
+    std::string dump() const;
+private:
+    std::vector<Zone> m_zones;          // m_zones[0] is the root, never timed
+    std::vector<unsigned> m_stack;      // Open zones
+    unsigned m_frames;
+
+    // Conversion from ticks to microseconds, calibrated against std::chrono::steady_clock
+    uint64_t m_calibration_ticks;
+    int64_t m_calibration_ns;
+    double m_us_per_tick;
+
+    bool m_tracing;
+    std::vector<TraceEvent> m_trace;        // Being recorded
+    size_t m_trace_events;
+    uint64_t m_trace_origin;                // Tick of the start of the trace
+    double m_trace_us_per_tick;             // Measured at the start, the same for all the events
+
+    // Writer thread and what it shares with the simulation thread, under m_trace_mutex
+    std::thread m_writer;
+    std::mutex m_trace_mutex;
+    std::condition_variable m_trace_condition;
+    std::vector<TraceEvent> m_trace_full;   // Handed to the writer
+    bool m_trace_pending;                   // Whether m_trace_full is still to be written
+    bool m_trace_stop;
+    std::ofstream m_trace_file;             // Only used by the writer while tracing
+    std::vector<uint32_t> m_trace_threads;  // Seen by the writer, named at the end
+
+    unsigned add_zone(const char* name);
+    void calibrate();
+    /**
+     * @brief Hands the recorded events to the writer, after it is done with the previous ones
+     */
+    void flush_trace();
+    void write_trace();
+
+    inline void record(const char* name, const uint64_t begin, const uint64_t end) {
+        if (m_trace.size() == m_trace.capacity()) {
+            flush_trace();
+        }
+        m_trace.push_back({name, profiler_thread_id(), begin, end});
+        ++m_trace_events;
+    }
+};
+
+/**
+ * @brief The profiler of the simulation thread
+ */
+Profiler& profiler();
+
+// Times a scope
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name) {
+        profiler().enter(name);
+        m_start = profiler_ticks();
+    }
+    ~ProfileScope() {
+        profiler().leave(m_start);
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+    uint64_t m_start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILER
+#   define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#   define PROFILE_END_FRAME() profiler().end_frame()
+#else
+#   define PROFILE_ZONE(name)
+#   define PROFILE_END_FRAME()
+#endif
+
+#endif /* PROFILER_H */
@@ -1,6 +1,7 @@
 #include <SDL2_gfxPrimitives.h>
 #include <vector>
 #include "render.h"
+#include "shape.h"
 #include "vector2.h"
 
 namespace camera {
@@ -180,6 +181,37 @@ void render_polygon_fill(SDL_Renderer* renderer, Vector2* vertices, uint8_t n, u
     filledPolygonColor(renderer, vx, vy, n, color);
 }
 
+void render_shape(SDL_Renderer* renderer, const Shape* shape, const Color& color, bool fill) {
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+
+    if (shape->get_type() == CIRCLE) {
+        if (fill) {
+            render_circle_fill_raster(renderer, shape->get_centroid(), shape->get_radius());
+        }else {
+            render_circle(renderer, shape->get_centroid(), shape->get_radius());
+        }
+        return;
+    }
+
+    const Vertices shape_vertices(shape->get_vertices());
+    const uint8_t count(shape->get_count());
+    for (uint8_t i(0); i < count; ++i) {
+        const Vector2 a(shape_vertices[i]);
+        const Vector2 b(shape_vertices[(i + 1) % count]);
+        render_line(renderer, a, b);
+    }
+
+    if (fill) {
+        Vector2 vertices[count];
+        for (uint8_t i(0); i < count; ++i) {
+            vertices[i] = shape_vertices[i];
+        }
+
+        uint32_t c(color.r + (color.g << 8) + (color.b << 16) + (color.a << 24));
+        render_polygon_fill(renderer, vertices, count, c);
+    }
+}
+
 Vector2 camera::world_to_screen(Vector2 world_p) {
     Vector2 screen_p;
     world_p -= camera::position;
@@ -1,17 +1,15 @@
 #ifndef RENDER_H
 #define RENDER_H
 
+#include "color.h"
 #include "vector2.h"
 #include <SDL_render.h>
 
 struct Vector2;
+class Shape;
 
 const SDL_Color bg_color({31, 31, 31, 255});
 const SDL_Color text_color({255, 255, 255, 255});
-const SDL_Color kinematic_body_color({189, 183, 107, 255});
-const SDL_Color dynamic_body_color({255, 180, 180, 255});
-const SDL_Color focus_color({255, 0, 255, 255});
-const SDL_Color spring_color({160, 160, 160, 255});
 const SDL_Color editing_color({106, 90, 205, 255});
 
 extern const unsigned SCREEN_WIDTH;
@@ -30,6 +28,7 @@ void render_circle_fill(SDL_Renderer*, Vector2 center, double radius);
 void render_circle_fill_raster(SDL_Renderer* renderer, Vector2 center, double radius);
 void render_rectangle(SDL_Renderer* renderer, Vector2 center, float w, float h);
 void render_polygon_fill(SDL_Renderer* renderer, Vector2* vertices, uint8_t n, uint32_t color);
+void render_shape(SDL_Renderer* renderer, const Shape* shape, const Color& color, bool fill);
 
 /**
  *  RENDER_SCALE = camera_width
@@ -1,6 +1,6 @@
-#include <SDL_endian.h>
-#include <SDL_stdinc.h>
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include "rigid_body.h"
 #include "shape.h"
 #include "narrow_phase.h"
@@ -8,7 +8,6 @@
 #include "shape.h"
 #include "transform2.h"
 #include "utils.h"
-#include "render.h"
 #include "config.h"
 #include "vector2.h"
 
@@ -23,6 +22,7 @@ RigidBody::RigidBody(const RigidBodyDef& def, const Shape& shape, const size_t i
     m_friction(def.friction),
     m_type(def.type),
     m_enabled(def.enabled),
+    m_filter(def.filter),
     // m_shape(shape),
     m_id(id)
 {
@@ -69,6 +69,7 @@ RigidBody::RigidBody(const RigidBodyDef& def, Shape* shape, const size_t id)
     m_friction(def.friction),
     m_type(def.type),
     m_enabled(def.enabled),
+    m_filter(def.filter),
     m_shape(shape),
     m_id(id)
 {
@@ -196,6 +197,47 @@ void RigidBody::step(double dt) {
     m_shape->transform(m_pos, m_theta);
 }
 
+void RigidBody::sweep(const double dt, const double margin) {
+    if (m_type == STATIC) {
+        return;
+    }
+
+    const Vector2 d(m_vel * dt);
+    // A vertex at distance r from the centroid moves by at most r times the rotation
+    double spin(0);
+    if (m_shape->get_type() == POLYGON) {
+        spin = m_shape->get_bounding_radius() * std::abs(m_omega * dt);
+    }
+
+    // The position corrections of the contacts move a body by more than its velocity does. One
+    // that left its box gets twice the room it lacked, halved at each sweep it stays in.
+    const AABB aabb(m_shape->get_aabb());
+    const double out(!m_swept ? 0 : std::max({m_swept_aabb.min.x - aabb.min.x, m_swept_aabb.min.y - aabb.min.y,
+                                              aabb.max.x - m_swept_aabb.max.x, aabb.max.y - m_swept_aabb.max.y}));
+    m_sweep_extra = out > 0 ? 2 * (m_sweep_extra + out) : 0.5 * m_sweep_extra;
+
+    const double grow(spin + margin + m_sweep_extra);
+    m_swept_aabb.min = aabb.min + Vector2(std::min(d.x, 0.0) - grow, std::min(d.y, 0.0) - grow);
+    m_swept_aabb.max = aabb.max + Vector2(std::max(d.x, 0.0) + grow, std::max(d.y, 0.0) + grow);
+    m_swept = 1;
+}
+
+bool RigidBody::left_sweep() const {
+    if (m_type == STATIC || !m_swept) {
+        return false;
+    }
+    const AABB aabb(m_shape->get_aabb());
+    return aabb.min.x < m_swept_aabb.min.x || aabb.min.y < m_swept_aabb.min.y
+        || aabb.max.x > m_swept_aabb.max.x || aabb.max.y > m_swept_aabb.max.y;
+}
+
+AABB RigidBody::get_swept_aabb() const {
+    if (m_type == STATIC || !m_swept) {
+        return m_shape->get_aabb();
+    }
+    return m_swept_aabb;
+}
+
 void RigidBody::subject_to_force(const Vector2 force, const Vector2 point) {
     if (m_type != DYNAMIC || !m_enabled) {
         return;
@@ -299,134 +341,14 @@ double RigidBody::p_energy(double gravity) const {
     return m_mass * gravity * m_pos.y;
 }
 
-void RigidBody::draw(SDL_Renderer* renderer) {
-    if (!trail.empty()) {
-        if (trail.back() != m_pos) {
-            trail.clear();
-        }
-    }
-
-    auto aabb(m_shape->get_aabb());
-    const Vector2 world_min(camera::screen_to_world(0, 0));
-    const Vector2 world_max(camera::screen_to_world(SCREEN_WIDTH, SCREEN_HEIGHT));
-    if (aabb.max.x < world_min.x || aabb.max.y < world_max.y ||
-        aabb.min.x > world_max.x || aabb.min.y > world_min.y) {
-        return;
-    }
-
-    SDL_Color color;
-    color.r = m_color.r * 0.5;
-    color.g = m_color.g * 0.5;
-    color.b = m_color.b * 0.5;
-    color.a = m_color.a * 0.5;
-
-    if (m_shape->get_type() == CIRCLE) {
-        const double r(m_shape->get_radius());
-
-        if (m_type != STATIC && m_enabled) {
-            m_shape->draw(renderer, color, true);
-            color = m_color;
-            m_shape->draw(renderer, color, false);
-
-            const Vector2 indicator(m_pos.x + r * cos(m_theta), m_pos.y + r * sin(m_theta));
-            render_line(renderer, m_pos, indicator);
-        }else {
-            if (m_enabled) {
-                color = m_color;
-                // SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a);
-            }else {
-                color = m_color;
-                color.a *= 0.5;
-                // SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a * 0.5);
-            }
-            m_shape->draw(renderer, color, false);
-            if (m_type == STATIC) {
-                SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a * 0.5);
-                render_line(renderer, m_pos, m_pos + vector2_q1 * r);
-                render_line(renderer, m_pos, m_pos + vector2_q2 * r);
-                render_line(renderer, m_pos, m_pos + vector2_q3 * r);
-                render_line(renderer, m_pos, m_pos + vector2_q4 * r);
-            }
-        }
-    }else {
-        if (m_type == STATIC && m_enabled) {
-            SDL_SetRenderDrawColor(renderer, m_color.r, m_color.g, m_color.b, m_color.a);
-
-            const Vertices vertices(m_shape->get_vertices());
-            if (m_shape->get_count() == 4) {
-                render_line(renderer, vertices[0], vertices[2]);
-                render_line(renderer, vertices[1], vertices[3]);
-            }
-        }
-        color = m_color;
-        if (!m_enabled) {
-            color.a *= 0.25;
-        }
-        // Draw outline
-        m_shape->draw(renderer, color, false);
-
-        // Fill the inside
-        color.a = m_color.a * 0.1;
-        m_shape->draw(renderer, color, true);
-    }
-
-#ifdef DEBUG
-    // Debug drawings
-    //
-#endif
-}
-
-void RigidBody::draw_trail(SDL_Renderer* renderer, bool update_trace) {
-    if (max_trail_length > 0) {
-        if (update_trace) {
-            if (trail.size() == max_trail_length) {
-                trail.pop_front();
-            }
-            if (trail.size() < max_trail_length) {
-                trail.push_back(m_pos);
-            }
-        }
-
-        if (trail.size() > 1) {
-            for (size_t i(0); i < trail.size() - 1; ++i) {
-                int alpha(255.0 / trail.size() * i);
-                SDL_SetRenderDrawColor(renderer, 255, 0, 0, alpha);
-                // render_circle_fill(renderer, point.x, point.y, 1 / (double)RENDER_SCALE);
-                render_line(renderer, trail[i], trail[i + 1]);
-            }
-        }
-    }
-}
-
-void RigidBody::draw_bounding_box(SDL_Renderer* renderer) {
-    AABB aabb(m_shape->get_aabb());
-    render_line(renderer, aabb.min, {aabb.max.x, aabb.min.y});
-    render_line(renderer, {aabb.max.x, aabb.min.y}, aabb.max);
-    render_line(renderer, aabb.max, {aabb.min.x, aabb.max.y});
-    render_line(renderer, {aabb.min.x, aabb.max.y}, aabb.min);
-}
-
-void RigidBody::draw_com(SDL_Renderer* renderer) {
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-    render_line(renderer, m_pos, transform2(vector2_x / RENDER_SCALE * 10, m_pos, m_theta));
-    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
-    render_line(renderer, m_pos, transform2(vector2_y / RENDER_SCALE * 10, m_pos, m_theta));
-}
-
-void RigidBody::draw_forces(SDL_Renderer* renderer) const {
-    SDL_SetRenderDrawColor(renderer, 255, 0, 255, 255);
-    render_line(renderer, m_pos, m_pos + m_force / 50.0);
-}
-
-void RigidBody::colorize(const SDL_Color color) {
+void RigidBody::colorize(const Color color) {
     this->m_color = color;
-    
 }
 
 void RigidBody::reset_color() {
     switch (m_type) {
         case STATIC:
-            m_color = {255, 255, 255, 255};
+            m_color = static_body_color;
             break;
         case KINEMATIC:
             m_color = kinematic_body_color;
@@ -452,9 +374,9 @@ std::string RigidBody::dump(double gravity) const {
     return E_m + mass + x + y + vx + vy + v_theta;
 }
 
-void RigidBody::handle_wall_collisions() {
+unsigned RigidBody::handle_wall_collisions(const double width, const double height) {
     if (m_type != DYNAMIC) {
-        return;
+        return 0;
     }
 
     Manifold collision_h, collision_v;  // We separate horizontal and vertical walls
@@ -469,11 +391,11 @@ void RigidBody::handle_wall_collisions() {
             m_pos.x = r;
             collision_h.contact_points[0] = {0, m_pos.y};
             collision_h.count = 1;
-        }else if (m_pos.x + r > SCENE_WIDTH) {
+        }else if (m_pos.x + r > width) {
             collision_h.normal = {1, 0};
-            collision_h.depth = m_pos.x + r - SCENE_WIDTH;
-            m_pos.x = SCENE_WIDTH - r;
-            collision_h.contact_points[0] = {SCENE_WIDTH, m_pos.y};
+            collision_h.depth = m_pos.x + r - width;
+            m_pos.x = width - r;
+            collision_h.contact_points[0] = {width, m_pos.y};
             collision_h.count = 1;
         }
         if (m_pos.y - r < 0) {
@@ -482,11 +404,11 @@ void RigidBody::handle_wall_collisions() {
             m_pos.y = r;
             collision_v.contact_points[0] = {m_pos.x, 0};
             collision_v.count = 1;
-        }else if (m_pos.y + r > SCENE_HEIGHT) {
+        }else if (m_pos.y + r > height) {
             collision_v.normal = {0, 1};
-            collision_v.depth = m_pos.y + r - SCENE_HEIGHT;
-            m_pos.y = SCENE_HEIGHT - r;
-            collision_v.contact_points[0] = {m_pos.x, SCENE_HEIGHT};
+            collision_v.depth = m_pos.y + r - height;
+            m_pos.y = height - r;
+            collision_v.contact_points[0] = {m_pos.x, height};
             collision_v.count = 1;
         }
 
@@ -501,7 +423,7 @@ void RigidBody::handle_wall_collisions() {
         Vector2 r1_v, r2_v;
 
         const AABB aabb(m_shape->get_aabb());
-        const Vertices vertices(m_shape->get_vertices());
+        const Vertices& vertices(m_shape->get_vertices());
         const uint8_t count(m_shape->get_count());
 
         if (aabb.min.x <= 0) {
@@ -516,10 +438,10 @@ void RigidBody::handle_wall_collisions() {
                 }
             }
             m_pos.x -= aabb.min.x;
-        }else if (aabb.max.x >= SCENE_WIDTH) {
+        }else if (aabb.max.x >= width) {
             collision_h.normal = {1, 0};
             for (uint8_t i(0); i < count; ++i) {
-                if (vertices[i].x >= SCENE_WIDTH) {
+                if (vertices[i].x >= width) {
                     collision_h.contact_points[0 + collision_h.count] = vertices[i];
                     ++collision_h.count;
                     if (collision_h.count >= 2) {
@@ -527,7 +449,7 @@ void RigidBody::handle_wall_collisions() {
                     }
                 }
             }
-            m_pos.x -= (aabb.max.x - SCENE_WIDTH);
+            m_pos.x -= (aabb.max.x - width);
         }
         if (aabb.min.y <= 0) {
             collision_v.normal = {0, -1};
@@ -541,10 +463,10 @@ void RigidBody::handle_wall_collisions() {
                 }
             }
             m_pos.y -= aabb.min.y;
-        }else if (aabb.max.y >= SCENE_HEIGHT) {
+        }else if (aabb.max.y >= height) {
             collision_v.normal = {0, 1};
             for (uint8_t i(0); i < count; ++i) {
-                if (vertices[i].y >= SCENE_HEIGHT) {
+                if (vertices[i].y >= height) {
                     collision_v.contact_points[0 + collision_v.count] = vertices[i];
                     ++collision_v.count;
                     if (collision_v.count >= 2) {
@@ -552,7 +474,7 @@ void RigidBody::handle_wall_collisions() {
                     }
                 }
             }
-            m_pos.y -= (aabb.max.y - SCENE_HEIGHT);
+            m_pos.y -= (aabb.max.y - height);
         }
 
         //const Vector2 r_h((r1_h + r2_h) * 0.5);
@@ -569,4 +491,6 @@ void RigidBody::handle_wall_collisions() {
     }
 
     m_shape->transform(m_pos, m_theta);
+
+    return (collision_h.count > 0) + (collision_v.count > 0);
 }
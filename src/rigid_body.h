@@ -1,13 +1,16 @@
 #ifndef RIGID_BODY_H
 #define RIGID_BODY_H
 
-#include <SDL_render.h>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <string>
+#include "color.h"
 #include "shape.h"
 #include "vector2.h"
 
+struct SDL_Renderer;
+
 enum BodyType {
     STATIC,
     KINEMATIC,
@@ -26,6 +29,24 @@ struct Friction {
 
 const Friction steel_friction = {steel_static_friction, steel_dynamic_friction};
 
+/**
+ * @brief Which bodies a body collides with, checked by the broad phase before pairing.
+ * Two bodies of the same non zero group always collide if it is positive and never if it
+ * is negative. Otherwise, the category of each body must be in the mask of the other.
+ */
+struct CollisionFilter {
+    uint16_t category = 0x0001;
+    uint16_t mask = 0xFFFF;
+    int16_t group = 0;
+};
+
+inline bool should_collide(const CollisionFilter& a, const CollisionFilter& b) {
+    if (a.group == b.group && a.group != 0) {
+        return a.group > 0;
+    }
+    return (a.mask & b.category) && (b.mask & a.category);
+}
+
 struct RigidBodyDef {
     Vector2 position;
     Vector2 velocity;
@@ -36,6 +57,7 @@ struct RigidBodyDef {
     Friction friction = steel_friction;
     BodyType type = DYNAMIC;
     bool enabled = true;
+    CollisionFilter filter;
 };
 
 class RigidBody {
@@ -47,6 +69,12 @@ public:
     virtual ~RigidBody();
 
     void step(double dt);
+    /**
+     * @brief Bounds the motion of the body over a frame of duration dt, from its velocity and
+     * spin, the margin covering the velocity changes during the frame, and from how far the body
+     * left its box since the last sweep
+     */
+    void sweep(const double dt, const double margin);
     void subject_to_force(const Vector2 force, const Vector2 point);
     void subject_to_torque(const double torque);
     void reset_forces();
@@ -62,12 +90,14 @@ public:
     double k_energy() const;
     double p_energy(double gravity) const;
 
+    // Rendering, only defined by the demo application (see draw.cc)
     void draw(SDL_Renderer* renderer);
     void draw_trail(SDL_Renderer* renderer, bool update_trace);
     void draw_bounding_box(SDL_Renderer* renderer);
     void draw_com(SDL_Renderer* renderer);
     void draw_forces(SDL_Renderer* renderer) const;
-    void colorize(const SDL_Color color);
+
+    void colorize(const Color color);
     void reset_color();
 
     std::string dump(double gravity) const;
@@ -89,12 +119,18 @@ public:
     inline bool is_static() const { return m_type == STATIC; }
     inline bool is_dynamic() const { return m_type == DYNAMIC; }
     inline bool is_enabled() const { return m_enabled; }
+    inline const CollisionFilter& get_filter() const { return m_filter; }
     inline Shape* get_shape() const { return m_shape; }
+    // Bounding box of the shape at the last sweep grown by it, exact for static bodies
+    AABB get_swept_aabb() const;
+    // Whether the bounding box of the shape went out of the swept one of the last sweep
+    bool left_sweep() const;
     inline ShapeType get_shape_type() const { return m_shape->get_type(); }
     inline unsigned get_id() const { return m_id; }
     inline auto get_pos_curve() const { return trail; }
 
-    void handle_wall_collisions();
+    // Returns the number of walls hit (0 to 2)
+    unsigned handle_wall_collisions(const double width, const double height);
 
 protected:
     // linear, x y axis
@@ -123,13 +159,17 @@ protected:
 
     BodyType m_type;
     bool m_enabled;
+    CollisionFilter m_filter;
 
     Shape* m_shape;
+    AABB m_swept_aabb;          // Bounding box over the frame, set by sweep, the one of the broad phase
+    bool m_swept = 0;           // Whether there was a sweep yet
+    double m_sweep_extra = 0;   // Room for the moves of the contacts, from how far the body left its box
 
     size_t max_trail_length = 2e3;
     std::deque<Vector2> trail;
 
-    SDL_Color m_color;
+    Color m_color;
 
     size_t m_id;
 };
@@ -0,0 +1,630 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "scenes.h"
+#include "world.h"
+#include "rigid_body.h"
+#include "shape.h"
+#include "link.h"
+#include "settings.h"
+#include "transform2.h"
+#include "config.h"
+#include "vector2.h"
+
+namespace {
+    const std::vector<SceneEntry> scene_registry = {
+        {"collision", [](World& world, Settings& settings) { demo_collision(world, settings); }},
+        {"stacking", [](World& world, Settings& settings) { demo_stacking(world, settings); }},
+        {"rigidbody", demo_rigidbody},
+        {"double_pendulum", demo_double_pendulum},
+        {"springs", demo_springs},
+        {"simple_pendulum", demo_simple_pendulum},
+        {"spring_chains", [](World& world, Settings& settings) { demo_spring_chains(world, settings); }},
+        {"mixed_sizes", [](World& world, Settings& settings) { demo_mixed_sizes(world, settings); }},
+    };
+
+    bool parse_body_type(const std::string& token, BodyType& type) {
+        if (token == "static") {
+            type = STATIC;
+        }else if (token == "kinematic") {
+            type = KINEMATIC;
+        }else if (token == "dynamic") {
+            type = DYNAMIC;
+        }else {
+            return false;
+        }
+        return true;
+    }
+
+    bool parse_damping(const std::string& token, Spring::DampingType& damping) {
+        if (token == "undamped") {
+            damping = Spring::UNDAMPED;
+        }else if (token == "underdamped") {
+            damping = Spring::UNDERDAMPED;
+        }else if (token == "critical") {
+            damping = Spring::CRIT_DAMPED;
+        }else if (token == "overdamped") {
+            damping = Spring::OVERDAMPED;
+        }else {
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Reads the optional trailing "type vx vy rotation" fields of a body line
+     */
+    bool parse_body_options(std::istringstream& line, RigidBodyDef& def) {
+        std::string type;
+        if (!(line >> type)) {
+            return true;
+        }
+        if (!parse_body_type(type, def.type)) {
+            return false;
+        }
+        double vx, vy;
+        if (line >> vx >> vy) {
+            def.velocity = {vx, vy};
+            double rotation;
+            if (line >> rotation) {
+                def.rotation = deg2rad(rotation);
+            }
+        }
+        return true;
+    }
+}
+
+const std::vector<SceneEntry>& get_scenes() {
+    return scene_registry;
+}
+
+bool load_scene(const std::string& name, World& world, Settings& settings) {
+    for (const auto& entry : scene_registry) {
+        if (name == entry.name) {
+            entry.build(world, settings);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool load_scene_file(const std::string& path, World& world, Settings& settings) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open scene file " << path << "\n";
+        return false;
+    }
+
+    std::string raw;
+    unsigned line_number(0);
+    CollisionFilter filter;     // Of the bodies that follow
+    while (std::getline(file, raw)) {
+        ++line_number;
+        const size_t comment(raw.find('#'));
+        if (comment != std::string::npos) {
+            raw.erase(comment);
+        }
+
+        std::istringstream line(raw);
+        std::string keyword;
+        if (!(line >> keyword)) {
+            continue;
+        }
+
+        bool valid(false);
+        if (keyword == "gravity") {
+            double gravity;
+            if (line >> gravity) {
+                world.set_gravity(gravity);
+                settings.enable_gravity = gravity != 0;
+                valid = true;
+            }
+        }else if (keyword == "size") {
+            double width, height;
+            if (line >> width >> height && width > 0 && height > 0) {
+                world.set_scene_size(width, height);
+                valid = true;
+            }
+        }else if (keyword == "walls") {
+            std::string state;
+            if (line >> state && (state == "on" || state == "off")) {
+                if (state == "on") {
+                    world.enable_walls();
+                }else {
+                    world.disable_walls();
+                }
+                valid = true;
+            }
+        }else if (keyword == "circle") {
+            RigidBodyDef def;
+            def.filter = filter;
+            double x, y, r;
+            if (line >> x >> y >> r && r > 0) {
+                def.position = {x, y};
+                if (parse_body_options(line, def)) {
+                    world.add_body(def, Circle(r));
+                    valid = true;
+                }
+            }
+        }else if (keyword == "box") {
+            RigidBodyDef def;
+            def.filter = filter;
+            double x, y, hw, hh;
+            if (line >> x >> y >> hw >> hh && hw > 0 && hh > 0) {
+                def.position = {x, y};
+                if (parse_body_options(line, def)) {
+                    world.add_body(def, create_box(hw, hh));
+                    valid = true;
+                }
+            }
+        }else if (keyword == "polygon") {
+            RigidBodyDef def;
+            def.filter = filter;
+            double x, y;
+            unsigned count;
+            if (line >> x >> y >> count && count >= 3 && count <= shape_max_vertices) {
+                std::vector<Vector2> points(count);
+                valid = true;
+                for (auto& p : points) {
+                    if (!(line >> p.x >> p.y)) {
+                        valid = false;
+                        break;
+                    }
+                }
+                const ConvexHull hull(compute_hull(points));
+                def.position = {x, y};
+                valid = valid && hull.count >= 3 && parse_body_options(line, def);
+                if (valid) {
+                    world.add_body(def, Polygon(hull));
+                }
+            }
+        }else if (keyword == "filter") {
+            unsigned category, mask;
+            int group(0);
+            if (line >> category >> mask && category <= UINT16_MAX && mask <= UINT16_MAX) {
+                valid = !(line >> group) || (group >= INT16_MIN && group <= INT16_MAX);
+                filter.category = category;
+                filter.mask = mask;
+                filter.group = group;
+            }
+        }else if (keyword == "spring") {
+            double x1, y1, x2, y2;
+            float stiffness;
+            if (line >> x1 >> y1 >> x2 >> y2 >> stiffness) {
+                Spring::DampingType damping(Spring::UNDAMPED);
+                std::string token;
+                valid = !(line >> token) || parse_damping(token, damping);
+                if (valid) {
+                    if (stiffness <= 0) {
+                        stiffness = spring_stiffness_infinite;
+                    }
+                    world.add_spring({x1, y1}, {x2, y2}, damping, stiffness);
+                }
+            }
+        }
+
+        if (!valid) {
+            std::cerr << path << ":" << line_number << ": invalid scene line: " << raw << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void demo_collision(World& world, Settings& settings, const unsigned ball_count) {
+    const double scene_width(world.get_scene_width());
+    const double scene_height(world.get_scene_height());
+    // Grow the spawn area with the number of balls to keep the same density
+    const double spread(sqrt(ball_count / 400.0));
+    RigidBodyDef body_def;
+    body_def.position = {scene_width * 0.1, scene_height * 0.5};
+    body_def.velocity = {3, 0};
+    Polygon collider(create_box(0.125, 0.125));
+    world.add_body(body_def, collider);
+
+    body_def.velocity = vector2_zero;
+    for (unsigned i(0); i < ball_count; ++i) {
+        body_def.position = {scene_width * 0.25 + 0.001 * spread * (rand() % 500),
+                            scene_height * 0.5 - 0.125 * spread + 0.001 * spread * (rand() % 250)};
+        Circle ball(0.01);
+        world.add_body(body_def, ball);
+    }
+
+    world.disable_walls();
+    world.set_gravity(0);
+    settings.enable_gravity = 0;
+    settings.draw_body_trajectory = 0;
+}
+
+void demo_stacking(World& world, Settings& settings, const unsigned columns, const unsigned rows) {
+    const double scene_width(world.get_scene_width());
+    RigidBodyDef body_def;
+    body_def.position = {scene_width * 0.5, 0.5};
+    body_def.type = STATIC;
+
+    const double block_size(0.1);
+    Polygon ground_box(create_box(block_size * std::max(40u, 2 * (columns + 2)), 0.1));
+    RigidBody* ground(world.add_body(body_def, ground_box));
+
+    body_def.type = DYNAMIC;
+    for (int i(0); i < (int)columns; ++i) {
+        for (unsigned j(0); j < rows; ++j) {
+            const double x(ground->get_p().x - 2*block_size * (i % 2 == 0 ? i : -i - 1));
+            body_def.position = {x, 1.5 + j};
+            Polygon square_box(create_square(block_size));
+            world.add_body(body_def, square_box);
+        }
+    }
+    world.disable_walls();
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    settings.draw_body_trajectory = 0;
+}
+
+void demo_rigidbody(World& world, Settings& settings) {
+    const double scene_width(world.get_scene_width());
+    const double ground_height(0.25);
+    const double ground_width(scene_width * 2);
+    RigidBodyDef def;
+    def.type = STATIC;
+    def.position = {ground_width * 0.75, -ground_height};
+    Polygon ground_box(create_box(ground_width, ground_height));
+    world.add_body(def, ground_box);
+
+    // Cubes and lever
+    const double cube_size(2);
+    Polygon cube(create_square(cube_size));
+    def.type = DYNAMIC;
+    def.position = {cube_size * 2, cube_size};
+    RigidBody* massive_cube(world.add_body(def, cube));
+
+    const double bar_height(0.125);
+    const double bar_length(cube_size * 2);
+    Polygon thin_bar(create_box(bar_length, bar_height));
+    def.position = {cube_size * 3, cube_size * 2 + bar_height};
+    RigidBody* lever(world.add_body(def, thin_bar));
+
+    const double small_cube_size(2 * bar_height);
+    const Vector2 placeholder(massive_cube->get_p() + Vector2(0, cube_size + 2 * bar_height));
+    cube = create_square(small_cube_size);
+    def.position = placeholder + Vector2(-small_cube_size, small_cube_size);
+    world.add_body(def, cube);
+    def.position = placeholder + Vector2(small_cube_size, small_cube_size);
+    world.add_body(def, cube);
+    for (int i (0); i < 4; ++i) {
+        def.position = placeholder + Vector2(0, (3 + 2 * i) * small_cube_size);
+        world.add_body(def, cube);
+    }
+
+    cube = create_square(cube_size * 0.5);
+    def.position = lever->get_p() + Vector2(bar_length - cube_size * 0.5, cube_size * 4);
+    world.add_body(def, cube);
+
+
+    // Seesaw
+    Circle pivot(0.5);
+    const double seesaw_pos(scene_width * 1.25);
+    def.position = {seesaw_pos, 0.5};
+    def.type = STATIC;
+    world.add_body(def, pivot);
+
+    const double seesaw_height(bar_height);
+    const double seesaw_length(bar_length);
+    Polygon seesaw(create_box(seesaw_length, seesaw_height));
+    def.position = {seesaw_pos, 1 + seesaw_height};
+    def.type = DYNAMIC;
+    world.add_body(def, seesaw);
+
+    const double r_cube_size(cube_size * 0.5);
+    cube = create_square(r_cube_size);
+    def.position = {seesaw_pos + seesaw_length - r_cube_size, 1 + seesaw_height * 2 + r_cube_size};
+    def.friction = {steel_static_friction * 0.25, steel_dynamic_friction * 0.25};
+    world.add_body(def, cube);
+
+    cube = create_square(small_cube_size);
+    def.position = {seesaw_pos - seesaw_length + small_cube_size, 1 + seesaw_height * 2 + small_cube_size};
+    def.friction = steel_friction;
+    world.add_body(def, cube);
+
+
+    // Dominos
+    double dominos_pos(scene_width * 1.8);
+    double prev_domino_height(0);
+    double domino_width(5e-3);
+    for (int i(0); i < 13; ++i) {
+        RigidBodyDef domino_def;
+        const double domino_height(domino_width * 7);
+        domino_def.position = {dominos_pos + prev_domino_height * 2, domino_height};
+        if (i == 0) {
+            domino_def.position.x += domino_height;
+            domino_def.rotation = -deg2rad(10);
+        }
+        Polygon domino(create_box(domino_width, domino_height));
+        world.add_body(domino_def, domino);
+        dominos_pos += prev_domino_height;
+        prev_domino_height = domino_height;
+        domino_width *= 1.5;
+    }
+
+
+    // // Balls collision propagation
+    // Circle ball(0.25);
+    // const double mark(scene_width * 3);
+    // for (int i(0); i < 10; ++i) {
+    //     def.position = {mark + 0.5 * i, 0.25};
+    //     world.add_body(def, ball);
+    // }
+    // def.position = {mark - 20 * 0.25, 0.25};
+    // def.velocity = {10, 0};
+    // world.add_body(def, ball);
+    //
+    //
+    // // Newton pendulums
+    // for (int i(0); i < 10; ++i) {
+    //     RigidBodyDef body_def;
+    //     body_def.position = {mark + 0.5 * i, scene_height * 0.5};
+    //     body_def.type = STATIC;
+    //     body_def.enabled = false;
+    //     Polygon anchor_box(create_box(0.5, 0.25));
+    //     RigidBody* anchor(world.add_body(body_def, anchor_box));
+    //
+    //     const double length(3);
+    //     if (i == 0) {
+    //         body_def.position = anchor->get_p() + Vector2(-length, 0);
+    //         const double max_angle(PI / 2);
+    //         body_def.velocity = {0, -(1 - cos(max_angle)) * sqrt(2*g*length)};
+    //     }else {
+    //         body_def.position = anchor->get_p() + Vector2(0, -length);
+    //     }
+    //     body_def.type = DYNAMIC;
+    //     body_def.enabled = true;
+    //     Circle circle(0.25);
+    //     RigidBody* body_1(world.add_body(body_def, circle));
+    //
+    //     world.add_spring(anchor->get_p(), body_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
+    // }
+
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    // camera::fit_width(ground_width * 2);
+    // camera::set_position({ground_width, 75 * ground_height});
+}
+
+void demo_double_pendulum(World& world, Settings& settings) {
+    const double scene_width(world.get_scene_width());
+    const double scene_height(world.get_scene_height());
+    const double arm_length(3.0);
+    // System 1
+    RigidBodyDef body_def;
+    body_def.position = {scene_width * 0.5, scene_height * 0.5};
+    body_def.type = STATIC;
+    body_def.enabled = false;
+    Polygon anchor_box(create_box(0.5, 0.25));
+    RigidBody* anchor(world.add_body(body_def, anchor_box));
+
+    body_def.position = anchor->get_p() + vector2_x * arm_length;
+    body_def.type = DYNAMIC;
+    body_def.enabled = true;
+    Circle circle(0.2);
+    RigidBody* body_1(world.add_body(body_def, circle));
+    body_def.position = anchor->get_p() + vector2_xy * arm_length;
+    RigidBody* body_2(world.add_body(body_def, circle));
+
+    world.add_spring(anchor->get_p(), body_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
+    world.add_spring(body_1->get_p(), body_2->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
+
+    // System 2
+    body_def.position = anchor->get_p() + vector2_x * 4 * arm_length;
+    body_def.type = STATIC;
+    body_def.enabled = false;
+    RigidBody* anchor_2(world.add_body(body_def, anchor_box));
+
+    body_def.position = anchor_2->get_p() + vector2_x * arm_length;
+    body_def.type = DYNAMIC;
+    body_def.enabled = true;
+    RigidBody* body_2_1(world.add_body(body_def, circle));
+    body_def.position = anchor_2->get_p() + transform2((vector2_xy * arm_length), vector2_zero, deg2rad(0.1));
+    RigidBody* body_2_2(world.add_body(body_def, circle));
+
+    world.add_spring(anchor_2->get_p(), body_2_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
+    world.add_spring(body_2_1->get_p(), body_2_2->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
+
+    world.disable_walls();
+    world.focus_body(body_2);
+    world.set_body_trail(body_2->get_id(), true);
+    world.set_body_trail(body_2_2->get_id(), true);
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    settings.draw_body_trajectory = 1;
+}
+
+void demo_simple_pendulum(World& world, Settings& settings) {
+    const double scene_width(world.get_scene_width());
+    const double scene_height(world.get_scene_height());
+    RigidBodyDef body_def;
+    body_def.position = {scene_width * 0.5, scene_height * 0.5};
+    body_def.type = STATIC;
+    body_def.enabled = false;
+    Polygon anchor_box(create_box(0.5, 0.25));
+    RigidBody* anchor(world.add_body(body_def, anchor_box));
+
+    const double length(3);
+    body_def.position = anchor->get_p() + Vector2(0, -length);
+    const double max_angle(PI / 2);
+    body_def.velocity = {(1 - cos(max_angle)) * sqrt(2*g*length), 0};
+    body_def.type = DYNAMIC;
+    body_def.enabled = true;
+    Circle circle(0.2);
+    RigidBody* body_1(world.add_body(body_def, circle));
+
+    world.add_spring(anchor->get_p(), body_1->get_p(), Spring::UNDAMPED, spring_stiffness_infinite);
+
+    world.disable_walls();
+    world.focus_on_position(body_1->get_p());
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    settings.draw_body_trajectory = 1;
+}
+
+void demo_springs(World& world, Settings& settings) {
+    const double scene_width(world.get_scene_width());
+    const double scene_height(world.get_scene_height());
+    RigidBodyDef bodydef;
+    bodydef.type = STATIC;
+
+    const double block_width(0.5);
+    const double block_height(0.25);
+    Polygon box(create_box(block_width, block_height));
+    Circle ball(0.25);
+
+    // Horizontal mass-spring systems
+    for (unsigned i(0); i < 4; ++i) {
+        Vector2 placeholder(0.6 * scene_width, 0.75 * scene_height - block_height * i * 8);
+        bodydef.type = STATIC;
+        for (unsigned j(1); j < 6; ++j) {
+            bodydef.position = placeholder + vector2_x * block_width * 2 * j;
+            world.add_body(bodydef, box);
+        }
+
+        bodydef.position = placeholder + vector2_y * block_height * 2;
+        RigidBody* anchor(world.add_body(bodydef, box));
+
+        bodydef.position = anchor->get_p() + vector2_x * block_width * 6;
+        bodydef.type = DYNAMIC;
+        RigidBody* mobile_mass;
+        if (i < 3) {
+            mobile_mass = world.add_body(bodydef, ball);
+        }else {
+            mobile_mass = world.add_body(bodydef, create_square(block_height));
+        }
+        // Produce a natural frequency of 1 Hz
+        float stiffness(4 * PI * PI * mobile_mass->get_mass());
+        stiffness *= (1 + 10*(i-1));
+        if (i == 0) {
+            stiffness = spring_stiffness_default;
+        }else if (i == 3) {
+            stiffness = spring_stiffness_default * 5;
+        }
+        world.add_spring(anchor->get_p(), mobile_mass->get_p(), Spring::UNDAMPED, stiffness);
+        const Vector2 x_offset(-vector2_x * 4 * block_width);
+        mobile_mass->move(x_offset);
+        world.update_body(mobile_mass);
+    }
+
+
+    // Vertical mass-spring systems
+    for (unsigned i(0); i < 4; ++i) {
+        bodydef.position = {0.4 * scene_width - i * block_width * 4, 0.75 * scene_height};
+        bodydef.type = STATIC;
+        RigidBody* vert_anchor(world.add_body(bodydef, box));
+
+        bodydef.position = vert_anchor->get_p() - vector2_y * 0.25 * scene_height;
+        bodydef.type = DYNAMIC;
+        Polygon hanging_box(create_square(block_height));
+        RigidBody* hanging_mass(world.add_body(bodydef, hanging_box));
+
+        // Produce a natural frequency of 1 Hz
+        float stiffness(4 * PI * PI * hanging_mass->get_mass());
+        const Spring::DampingType damping((Spring::DampingType)(3 - i));
+        world.add_spring(vert_anchor->get_p(), hanging_mass->get_p(), damping, stiffness);
+        // Pre-load the system by pulling down the spring
+        hanging_mass->move(-vector2_y * 0.1 * scene_height);
+        world.update_body(hanging_mass);
+    }
+
+
+    // Stick-and-slip
+    for (int i(-20); i < 20; ++i) {
+        Vector2 placeholder(0.5 * scene_width + 2 * block_width * i, 4 * block_height);
+        bodydef.position = placeholder;
+        bodydef.type = STATIC;
+        world.add_body(bodydef, box);
+    }
+
+    bodydef.position = {0.5 * scene_width + 2 * 17 * block_width, 6 * block_height};
+    bodydef.type = KINEMATIC;
+    bodydef.velocity = {-0.5, 0};
+    RigidBody* tractor(world.add_body(bodydef, box));
+
+    bodydef.position = {0.5 * scene_width + 2 * 19 * block_width, tractor->get_p().y};
+    bodydef.type = DYNAMIC;
+    bodydef.velocity = vector2_zero;
+    RigidBody* pulled_mass(world.add_body(bodydef, box));
+
+    world.add_spring(tractor->get_p(), pulled_mass->get_p(), Spring::UNDAMPED, spring_stiffness_default);
+
+    world.disable_walls();
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    settings.draw_body_trajectory = 0;
+}
+
+void demo_spring_chains(World& world, Settings& settings, const unsigned chains, const unsigned links) {
+    const double scene_width(world.get_scene_width());
+    const double scene_height(world.get_scene_height());
+    const double spacing(0.5);
+    const double link_length(0.3);
+    Polygon anchor_box(create_box(0.1, 0.1));
+    Circle ball(0.1);
+
+    for (unsigned i(0); i < chains; ++i) {
+        RigidBodyDef body_def;
+        body_def.position = {scene_width * 0.5 + spacing * (i - 0.5 * chains), scene_height - 0.5};
+        body_def.type = STATIC;
+        body_def.enabled = false;
+        RigidBody* previous(world.add_body(body_def, anchor_box));
+
+        body_def.type = DYNAMIC;
+        body_def.enabled = true;
+        for (unsigned j(0); j < links; ++j) {
+            // Slight horizontal offset so that the chains start swinging
+            body_def.position = previous->get_p() + Vector2(0.02, -link_length);
+            RigidBody* mass(world.add_body(body_def, ball));
+            const float stiffness(50 * 4 * PI * PI * mass->get_mass());
+            world.add_spring(previous->get_p(), mass->get_p(), Spring::UNDERDAMPED, stiffness);
+            previous = mass;
+        }
+    }
+
+    world.disable_walls();
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    settings.draw_body_trajectory = 0;
+}
+
+void demo_mixed_sizes(World& world, Settings& settings, const unsigned body_count) {
+    // Sizes spread evenly on a log scale, from the dominoes to the cubes of the rigidbody scene
+    const double min_size(5e-3);
+    const double max_size(2);
+    const double slot(max_size * 1.25);
+    const unsigned columns(std::ceil(std::sqrt(body_count)));
+
+    RigidBodyDef body_def;
+    body_def.type = STATIC;
+    const double ground_width(columns * slot);
+    body_def.position = {0.5 * ground_width, -0.25};
+    Polygon ground_box(create_box(ground_width, 0.25));
+    world.add_body(body_def, ground_box);
+
+    body_def.type = DYNAMIC;
+    for (unsigned i(0); i < body_count; ++i) {
+        const double size(min_size * std::pow(max_size / min_size, (rand() % 1000) / 999.0));
+        body_def.position = {(i % columns + 0.5) * slot, (i / columns + 0.5) * slot};
+        if (i % 2) {
+            Circle ball(0.5 * size);
+            world.add_body(body_def, ball);
+        }else {
+            Polygon box(create_square(0.5 * size));
+            world.add_body(body_def, box);
+        }
+    }
+
+    world.disable_walls();
+    world.set_gravity(g);
+    settings.enable_gravity = 1;
+    settings.draw_body_trajectory = 0;
+}
@@ -0,0 +1,56 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include <string>
+#include <vector>
+
+class World;
+struct Settings;
+
+/*
+ * Demo scenes. They only depend on the physics core, so that they can be
+ * loaded by the demo application as well as by the headless tools.
+ */
+void demo_collision(World& world, Settings& settings, const unsigned ball_count = 400);
+void demo_stacking(World& world, Settings& settings, const unsigned columns = 9, const unsigned rows = 15);
+void demo_rigidbody(World& world, Settings& settings);
+void demo_double_pendulum(World& world, Settings& settings);
+void demo_springs(World& world, Settings& settings);
+void demo_simple_pendulum(World& world, Settings& settings);
+void demo_spring_chains(World& world, Settings& settings, const unsigned chains = 10, const unsigned links = 10);
+void demo_mixed_sizes(World& world, Settings& settings, const unsigned body_count = 1000);
+
+struct SceneEntry {
+    const char* name;
+    void (*build)(World& world, Settings& settings);
+};
+
+/**
+ * @brief Lists the demo scenes that can be loaded by name
+ */
+const std::vector<SceneEntry>& get_scenes();
+
+/**
+ * @brief Populates the world with the demo scene of the given name
+ * @return Whether a scene with this name exists.
+ */
+bool load_scene(const std::string& name, World& world, Settings& settings);
+
+/**
+ * @brief Populates the world from a plain text scene file. Each line holds one entry
+ * ('#' starts a comment), positions in meters and angles in degrees:
+ *   size <width> <height>
+ *   gravity <g>
+ *   walls <on|off>
+ *   circle <x> <y> <radius> [type [vx vy [rotation]]]
+ *   box <x> <y> <half_width> <half_height> [type [vx vy [rotation]]]
+ *   polygon <x> <y> <n> <x1> <y1> ... <xn> <yn> [type [vx vy [rotation]]]
+ *   spring <x1> <y1> <x2> <y2> <stiffness> [undamped|underdamped|critical|overdamped]
+ *   filter <category> <mask> [group]
+ * with type one of static, kinematic or dynamic. A stiffness <= 0 gives an "infinite" spring.
+ * A filter line sets the collision filter of the bodies that follow (see CollisionFilter).
+ * @return Whether the whole file could be parsed.
+ */
+bool load_scene_file(const std::string& path, World& world, Settings& settings);
+
+#endif /* SCENES_H */
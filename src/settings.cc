@@ -9,6 +9,7 @@ void Settings::reset() {
     slow_motion = 0;
     draw_body_trajectory = 0;
     draw_center_of_mass = 0;
+    highlight_expensive = 0;
 #ifdef DEBUG
     highlight_collisions = 0;
     draw_contact_points = 0;
@@ -26,4 +27,5 @@ void Settings::reset() {
     plot_position = 0;
     plot_velocity = 0;
     plot_phase_plane = 0;
+    plot_counters = 0;
 }
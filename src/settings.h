@@ -7,6 +7,7 @@ struct Settings {
     bool draw_body_trajectory;
     bool draw_center_of_mass;
     bool highlight_collisions;
+    bool highlight_expensive;
     bool draw_contact_points;
     bool draw_collision_normal;
     bool draw_bounding_boxes;
@@ -14,6 +15,7 @@ struct Settings {
     bool plot_position;
     bool plot_velocity;
     bool plot_phase_plane;
+    bool plot_counters;
 
     Settings();
     void reset();
@@ -1,13 +1,10 @@
 #include "shape.h"
 #include "config.h"
-#include "narrow_phase.h"
-#include "render.h"
-#include "transform2.h"
 #include "vector2.h"
 #include <cassert>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
-#include <SDL_render.h>
 #include <algorithm>
 
 namespace {
@@ -94,12 +91,14 @@ Shape::Shape(ConvexHull hull, double radius, ShapeType type)
 {
     if (m_type == CIRCLE) {
         m_radius = radius;
+        m_bounding_radius = radius;
         m_count = 0;
     }else {
         // Check hull convexity and nb of vertices
         // m_vertices = ...
         // m_count = ...
         m_radius = 0;
+        m_bounding_radius = 0;
         m_ref_vertices = hull.points;
         m_vertices = m_ref_vertices;
         m_count = hull.count;
@@ -137,16 +136,6 @@ bool Circle::contains_point(const Vector2 point) const {
     return dot2(test, test) <= m_radius * m_radius;
 }
 
-void Circle::draw(SDL_Renderer* renderer, const SDL_Color& color, bool fill) const {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-
-    if (fill) {
-        render_circle_fill_raster(renderer, m_centroid, m_radius);
-    }else {
-        render_circle(renderer, m_centroid, m_radius);
-    }
-}
-
 void Circle::compute_area() {
     m_area = PI * m_radius * m_radius;
 }
@@ -161,10 +150,34 @@ void Circle::compute_centroid() {
     m_centroid = m_ref_centroid;
 }
 
+Polygon::Polygon(ConvexHull hull)
+:   Shape(hull, 0, POLYGON), m_angle(0), m_cos(1), m_sin(0)
+{
+    // The outward side of the edges depends on the winding of the hull
+    double area(0);
+    for (uint8_t i(0); i < m_count; ++i) {
+        area += cross2(m_ref_vertices[i], m_ref_vertices[(i + 1) % m_count]);
+    }
+    const double side(area < 0 ? -1 : 1);
+    for (uint8_t i(0); i < m_count; ++i) {
+        m_ref_normals[i] = (m_ref_vertices[(i + 1) % m_count] - m_ref_vertices[i]).normal() * side;
+    }
+    m_normals = m_ref_normals;
+}
+
 void Polygon::transform(const Vector2 p, const double theta) {
-    const Vector2 t(p - m_ref_centroid);
-    for (unsigned i(0); i < m_count; ++i) {
-        m_vertices[i] = transform2(m_ref_vertices[i], t, theta, m_ref_centroid);
+    if (theta != m_angle) {
+        m_angle = theta;
+        m_cos = std::cos(theta);
+        m_sin = std::sin(theta);
+    }
+
+    // Rotation about the centroid, then translation to p
+    for (uint8_t i(0); i < m_count; ++i) {
+        const Vector2 r(m_ref_vertices[i] - m_ref_centroid);
+        m_vertices[i] = {m_cos * r.x - m_sin * r.y + p.x, m_sin * r.x + m_cos * r.y + p.y};
+        const Vector2 n(m_ref_normals[i]);
+        m_normals[i] = {m_cos * n.x - m_sin * n.y, m_sin * n.x + m_cos * n.y};
     }
 
     m_centroid = p;
@@ -181,15 +194,20 @@ void Polygon::translate(const Vector2 delta_p) {
 }
 
 void Polygon::rotate(const double d_theta) {
-    for (uint8_t i(0); i < m_count; ++i) {
-        m_vertices[i] = transform2(m_vertices[i], vector2_zero, d_theta, m_centroid);
-    }
+    transform(m_centroid, m_angle + d_theta);
 }
 
 MassProperties Polygon::compute_mass_properties(const double density) {
     compute_area();
     compute_centroid();
 
+    double r2(0);
+    for (uint8_t i(0); i < m_count; ++i) {
+        const Vector2 r(m_ref_vertices[i] - m_ref_centroid);
+        r2 = std::max(r2, dot2(r, r));
+    }
+    m_bounding_radius = std::sqrt(r2);
+
     MassProperties mp;
     mp.mass = m_area * density;
     mp.inertia = 0;
@@ -218,25 +236,6 @@ bool Polygon::contains_point(const Vector2 point) const {
     return c;
 }
 
-void Polygon::draw(SDL_Renderer* renderer, const SDL_Color& color, bool fill) const {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    for (uint8_t i(0); i < m_count; ++i) {
-        const Vector2 a(m_vertices[i]);
-        const Vector2 b(m_vertices[(i + 1) % m_count]);
-        render_line(renderer, a, b);
-    }
-
-    if (fill) {
-        Vector2 vertices[m_count];
-        for (uint8_t i(0); i < m_count; ++i) {
-            vertices[i] = m_vertices[i];
-        }
-
-        uint32_t c(color.r + (color.g << 8) + (color.b << 16) + (color.a << 24));
-        render_polygon_fill(renderer, vertices, m_count, c);
-    }
-}
-
 void Polygon::compute_centroid() {
     double Cx(0);
     for (uint8_t i(0); i < m_count; ++i) {
@@ -267,8 +266,13 @@ void Polygon::compute_area() {
 }
 
 void Polygon::compute_aabb() {
-    m_aabb.min = {support(this, -vector2_x).x, support(this, -vector2_y).y};
-    m_aabb.max = {support(this, vector2_x).x, support(this, vector2_y).y};
+    m_aabb.min = m_vertices[0];
+    m_aabb.max = m_vertices[0];
+    for (uint8_t i(1); i < m_count; ++i) {
+        const Vector2 v(m_vertices[i]);
+        m_aabb.min = {std::min(m_aabb.min.x, v.x), std::min(m_aabb.min.y, v.y)};
+        m_aabb.max = {std::max(m_aabb.max.x, v.x), std::max(m_aabb.max.y, v.y)};
+    }
 }
 
 
@@ -1,7 +1,7 @@
 #ifndef SHAPE_H
 #define SHAPE_H
 
-#include <SDL_render.h>
+#include <cstdint>
 #include <vector>
 #include <array>
 #include "vector2.h"
@@ -24,6 +24,9 @@ enum ShapeType {
     POLYGON
 };
 
+// Size of the tables indexed by shape type
+constexpr unsigned shape_type_count(POLYGON + 1);
+
 struct AABB {
     Vector2 min; // Bottom left corner
     Vector2 max; // Top right corner
@@ -40,9 +43,13 @@ public:
     virtual ~Shape() {}
 
     Vector2 get_centroid() const { return m_centroid; }
-    Vertices get_vertices() const { return m_vertices; }
+    const Vertices& get_vertices() const { return m_vertices; }
+    // Outward unit normals of the edges, edge i going from vertex i to the next one
+    const Vertices& get_normals() const { return m_normals; }
     uint8_t get_count() const { return m_count; }
     double get_radius() const { return m_radius; }
+    // Largest distance from the centroid to the shape
+    double get_bounding_radius() const { return m_bounding_radius; }
     double get_area() const { return m_area; }
     AABB get_aabb() const { return m_aabb; }
     ShapeType get_type() const { return m_type; }
@@ -52,14 +59,16 @@ public:
     virtual void rotate(const double d_theta) = 0;
     virtual MassProperties compute_mass_properties(const double density) = 0;
     virtual bool contains_point(const Vector2 point) const = 0;
-    virtual void draw(SDL_Renderer* renderer, const SDL_Color& color, bool fill) const = 0;
 protected:
     Vector2 m_centroid;
     Vector2 m_ref_centroid;
     double m_radius;
     Vertices m_vertices;
     Vertices m_ref_vertices;
+    Vertices m_normals;
+    Vertices m_ref_normals;
     uint8_t m_count;
+    double m_bounding_radius;
 
     double m_area;
 
@@ -80,7 +89,6 @@ public:
     void rotate(const double d_theta) override;
     MassProperties compute_mass_properties(const double density) override;
     bool contains_point(const Vector2 point) const override;
-    void draw(SDL_Renderer* renderer, const SDL_Color& color, bool fill) const override;
 private:
     void compute_centroid() override;
     void compute_area() override;
@@ -89,15 +97,19 @@ private:
 
 class Polygon : public Shape {
 public:
-    Polygon(ConvexHull hull) : Shape(hull, 0, POLYGON) {}
+    Polygon(ConvexHull hull);
 
     void transform(const Vector2 p, const double theta) override;
     void translate(const Vector2 delta_p) override;
     void rotate(const double d_theta) override;
     MassProperties compute_mass_properties(const double density) override;
     bool contains_point(const Vector2 point) const override;
-    void draw(SDL_Renderer* renderer, const SDL_Color& color, bool fill) const override;
 private:
+    // Rotation of the last transform, its cosine and sine are only recomputed when it changes
+    double m_angle;
+    double m_cos;
+    double m_sin;
+
     void compute_centroid() override;
     void compute_area() override;
     void compute_aabb() override;
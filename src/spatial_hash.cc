@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include "spatial_hash.h"
+#include "rigid_body.h"
+
+SpatialHash::SpatialHash()
+:   m_static_changed(0)
+{}
+
+void SpatialHash::update() {
+    if (m_static_changed) {
+        build(m_static, m_static_grid);
+        m_static_changed = 0;
+    }
+    build(m_list, m_grid);
+}
+
+void SpatialHash::process(std::vector<BodyPair>& pairs) {
+    pairs.clear();
+    update();
+
+    // The cell itself, then the right, upper left, upper and upper right neighbors:
+    // the other half of the neighbors pair with this cell from their own side
+    const std::vector<Entry>& cells(m_grid.cells);
+    for (unsigned i(0); i < cells.size(); ++i) {
+        const Entry& entry(cells[i]);
+        pair_cell(entry, m_grid, entry.x, entry.y, i + 1, pairs);
+        pair_cell(entry, m_grid, entry.x + 1, entry.y, 0, pairs);
+        pair_cell(entry, m_grid, entry.x - 1, entry.y + 1, 0, pairs);
+        pair_cell(entry, m_grid, entry.x, entry.y + 1, 0, pairs);
+        pair_cell(entry, m_grid, entry.x + 1, entry.y + 1, 0, pairs);
+        query_static(entry, pairs);
+    }
+
+    const std::vector<Entry>& large(m_grid.large);
+    for (size_t i(0); i < large.size(); ++i) {
+        for (size_t j(i + 1); j < large.size(); ++j) {
+            if (large[i].pairs_with(large[j])) {
+                pairs.push_back({large[i].body, large[j].body});
+            }
+        }
+        for (const auto& entry : cells) {
+            if (large[i].pairs_with(entry)) {
+                pairs.push_back({large[i].body, entry.body});
+            }
+        }
+        query_static(large[i], pairs);
+    }
+}
+
+void SpatialHash::query(const AABB& aabb, std::vector<RigidBody*>& bodies) const {
+    for (const Grid* grid : {&m_grid, &m_static_grid}) {
+        for_each_candidate(*grid, aabb, [&](const Entry& entry) {
+            if (AABB_overlap(entry.aabb, aabb)) {
+                bodies.push_back(entry.body);
+            }
+        });
+    }
+}
+
+void SpatialHash::add_body(RigidBody* body) {
+    if (!body->is_enabled()) {
+        return;
+    }
+    if (body->is_static()) {
+        m_static.push_back(body);
+        m_static_changed = 1;
+    }else {
+        m_list.push_back(body);
+    }
+}
+
+void SpatialHash::remove_body(RigidBody* body) {
+    auto it(std::find(m_list.begin(), m_list.end(), body));
+    if (it != m_list.end()) {
+        m_list.erase(it);
+        return;
+    }
+    it = std::find(m_static.begin(), m_static.end(), body);
+    if (it != m_static.end()) {
+        m_static.erase(it);
+        m_static_changed = 1;
+    }
+}
+
+void SpatialHash::clear() {
+    m_list.clear();
+    m_static.clear();
+    m_static_changed = 1;
+    m_grid.cells.clear();
+    m_grid.large.clear();
+}
+
+bool SpatialHash::Entry::pairs_with(const Entry& other) const {
+    return AABB_overlap(aabb, other.aabb) && should_collide(filter, other.filter);
+}
+
+unsigned SpatialHash::Grid::bucket(const int x, const int y) const {
+    return ((unsigned)x * 73856093u ^ (unsigned)y * 19349663u) & mask;
+}
+
+void SpatialHash::build(const std::vector<RigidBody*>& bodies, Grid& grid) {
+    grid.cells.clear();
+    grid.large.clear();
+    m_entries.clear();
+
+    // Size of the bodies, the largest side of their AABB
+    m_sizes.clear();
+    for (auto body : bodies) {
+        const AABB aabb(body->get_swept_aabb());
+        m_sizes.push_back(std::max(aabb.max.x - aabb.min.x, aabb.max.y - aabb.min.y));
+    }
+    if (m_sizes.empty()) {
+        return;
+    }
+
+    std::vector<double>::iterator median(m_sizes.begin() + m_sizes.size() / 2);
+    std::nth_element(m_sizes.begin(), median, m_sizes.end());
+    const double large_size(*median * spatial_hash_large_ratio);
+    grid.cell_size = 0;
+    for (auto size : m_sizes) {
+        if (size <= large_size) {
+            grid.cell_size = std::max(grid.cell_size, size);
+        }
+    }
+    if (grid.cell_size <= 0) {
+        grid.cell_size = 1;
+    }
+
+    const double inverse_size(1 / grid.cell_size);
+    for (auto body : bodies) {
+        Entry entry;
+        entry.aabb = body->get_swept_aabb();
+        entry.filter = body->get_filter();
+        entry.body = body;
+        if (std::max(entry.aabb.max.x - entry.aabb.min.x, entry.aabb.max.y - entry.aabb.min.y) > large_size) {
+            grid.large.push_back(entry);
+            continue;
+        }
+        entry.x = std::floor(entry.aabb.min.x * inverse_size);
+        entry.y = std::floor(entry.aabb.min.y * inverse_size);
+        m_entries.push_back(entry);
+    }
+
+    grid.build(m_entries, [&grid](const Entry& entry) { return grid.bucket(entry.x, entry.y); });
+}
+
+void SpatialHash::pair_cell(const Entry& entry, const Grid& grid, const int x, const int y,
+                            unsigned first, std::vector<BodyPair>& pairs) const {
+    grid.for_each_in_bucket(grid.bucket(x, y), first, [&](const Entry& other) {
+        if (other.x == x && other.y == y && entry.pairs_with(other)) {
+            pairs.push_back({entry.body, other.body});
+        }
+    });
+}
+
+template <typename F>
+void SpatialHash::for_each_candidate(const Grid& grid, const AABB& aabb, F f) const {
+    if (!grid.cells.empty()) {
+        // A body overlapping the box has its lower corner within one cell below
+        // and left of the box, up to its upper corner
+        const double inverse_size(1 / grid.cell_size);
+        const double x0(std::floor(aabb.min.x * inverse_size) - 1);
+        const double y0(std::floor(aabb.min.y * inverse_size) - 1);
+        const double x1(std::floor(aabb.max.x * inverse_size));
+        const double y1(std::floor(aabb.max.y * inverse_size));
+
+        if ((x1 - x0 + 1) * (y1 - y0 + 1) > grid.cells.size()) {
+            for (const auto& entry : grid.cells) {
+                f(entry);
+            }
+        }else {
+            for (int y(y0); y <= (int)y1; ++y) {
+                for (int x(x0); x <= (int)x1; ++x) {
+                    grid.for_each_in_bucket(grid.bucket(x, y), 0, [&](const Entry& entry) {
+                        if (entry.x == x && entry.y == y) {
+                            f(entry);
+                        }
+                    });
+                }
+            }
+        }
+    }
+
+    for (const auto& entry : grid.large) {
+        f(entry);
+    }
+}
+
+void SpatialHash::query_static(const Entry& entry, std::vector<BodyPair>& pairs) const {
+    for_each_candidate(m_static_grid, entry.aabb, [&](const Entry& other) {
+        if (entry.pairs_with(other)) {
+            pairs.push_back({entry.body, other.body});
+        }
+    });
+}
@@ -0,0 +1,77 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <cstdint>
+#include <vector>
+#include "broad_phase.h"
+#include "bucket_grid.h"
+#include "rigid_body.h" // CollisionFilter
+#include "shape.h"  // AABB
+
+/**
+ * @brief Broad phase on a uniform grid, stored as a spatial hash.
+ * The cell size is the largest body size, leaving out the bodies much larger than the
+ * median (see spatial_hash_large_ratio). Every step, the bodies are counting sorted into
+ * the cells of the lower corner of their AABB, so the bodies of a cell are contiguous.
+ * Two overlapping bodies then sit in the same cell or in neighbor cells, and each cell
+ * is paired with itself and half of its neighbors so that no pair is found twice.
+ * The large bodies are tested against all the others.
+ * The static bodies have a grid of their own, built when they change only, whose cells
+ * are looked up by the moving bodies.
+ */
+class SpatialHash : public BroadPhase {
+public:
+    SpatialHash();
+
+    void process(std::vector<BodyPair>& pairs) override;
+    void update() override;
+    void query(const AABB& aabb, std::vector<RigidBody*>& bodies) const override;
+    void add_body(RigidBody* body) override;
+    void remove_body(RigidBody* body) override;
+    void clear() override;
+
+    // Grid of the moving bodies
+    double get_cell_size() const { return m_grid.cell_size; }
+    // Moving bodies left out of the grid during the last process
+    size_t get_large_count() const { return m_grid.large.size(); }
+private:
+    struct Entry {
+        AABB aabb;
+        int x;              // Cell of the lower corner
+        int y;
+        unsigned bucket;
+        CollisionFilter filter;
+        RigidBody* body;
+
+        // Overlap of the AABBs and collision filters
+        bool pairs_with(const Entry& other) const;
+    };
+
+    struct Grid : BucketGrid<Entry> {
+        double cell_size = 0;
+        std::vector<Entry> large;
+
+        unsigned bucket(const int x, const int y) const;
+    };
+
+    std::vector<RigidBody*> m_list;     // Moving bodies
+    std::vector<RigidBody*> m_static;
+    bool m_static_changed;
+
+    Grid m_grid;                        // Rebuilt by each process, kept for its capacity
+    Grid m_static_grid;
+    std::vector<Entry> m_entries;       // Scratch buffers of build
+    std::vector<double> m_sizes;
+
+    void build(const std::vector<RigidBody*>& bodies, Grid& grid);
+    // Pairs the entry with the ones of the cell (x, y) from position first on
+    void pair_cell(const Entry& entry, const Grid& grid, const int x, const int y, unsigned first,
+                   std::vector<BodyPair>& pairs) const;
+    // Pairs a moving entry with the static bodies
+    void query_static(const Entry& entry, std::vector<BodyPair>& pairs) const;
+    // Calls f on the entries of the grid whose cell may hold a body overlapping the box
+    template <typename F>
+    void for_each_candidate(const Grid& grid, const AABB& aabb, F f) const;
+};
+
+#endif /* SPATIAL_HASH_H */
@@ -3,9 +3,17 @@
 #include <limits>
 #include <sstream>
 #include <iomanip>
-#include <SDL_timer.h>
+#include <chrono>
 #include "utils.h"
 
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    uint64_t performance_counter() {
+        return Clock::now().time_since_epoch().count();
+    }
+}
+
 /* https://stackoverflow.com/questions/41294368/truncating-a-double-floating-point-at-a-certain-number-of-digits
 */
 std::string truncate_to_string(double n, int precision) {
@@ -38,13 +46,13 @@ std::string truncate_to_string(double n, int precision) {
 
 
 Timer::Timer() {
-    inv_frequency = 1.0 / SDL_GetPerformanceFrequency();
-    start = SDL_GetPerformanceCounter();
+    inv_frequency = (double)Clock::period::num / Clock::period::den;
+    start = performance_counter();
     stop = 0;
 }
 
 void Timer::reset(bool halt) {
-    start = SDL_GetPerformanceCounter();
+    start = performance_counter();
     if (halt) {
         stop = start;
     }else {
@@ -53,11 +61,11 @@ void Timer::reset(bool halt) {
 }
 
 void Timer::halt() {
-    stop = SDL_GetPerformanceCounter();
+    stop = performance_counter();
 }
 
 uint64_t Timer::get_ticks() {
-    uint64_t ticks(SDL_GetPerformanceCounter());
+    uint64_t ticks(performance_counter());
     return ticks - start;
 }
 
@@ -74,7 +82,7 @@ float Timer::get_microseconds() {
 }
 
 float Timer::get_elapsed(const double prescaler) {
-    uint64_t count(SDL_GetPerformanceCounter());
+    uint64_t count(performance_counter());
     if (stop > 0) {
         count = stop;
     }
@@ -1,29 +1,39 @@
-#include <SDL_hints.h>
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <iostream>
 #include <cassert>
 #include "world.h"
+#include "allocation_counter.h"
 #include "rigid_body.h"
 #include "shape.h"
 #include "broad_phase.h"
 #include "narrow_phase.h"
+#include "profiler.h"
 #include "collision.h"
-#include "utils.h"
-#include "render.h"
+#include "color.h"
+#include "frame_arena.h"
 #include "settings.h"
 #include "config.h"
 #include "vector2.h"
 
 World::World()
 :   m_gravity(g),
+    m_scene_width(scene_width_default),
+    m_scene_height(scene_height_default),
     walls_enabled(0),
     air_friction_enabled(0),
     body_count(0),
-    focus(-1)
+    focus(-1),
+    m_broad_phase(&m_sap),
+    m_broad_phase_type(BROAD_PHASE_SAP),
+    m_active_broad_phase(BROAD_PHASE_SAP),
+    m_bodies_changed(0),
+    m_broad_phase_stale(0),
+    cost_attribution_enabled(0)
 {
     m_bodies.reserve(500);
     body_count = m_bodies.size();
-    m_profile.reset();
 }
 
 World::~World() {
@@ -33,180 +43,177 @@ World::~World() {
 void World::step(double dt, int substeps, Settings& settings, bool perft) {
     if (perft && body_count < 250) {
         RigidBodyDef def;
-        def.position = {0.5 * SCENE_WIDTH, 0.5 * SCENE_HEIGHT};
+        def.position = {0.5 * m_scene_width, 0.5 * m_scene_height};
         def.velocity = {1, 0};
         Circle ball(0.1);
         add_body(def, ball);
     }
 
-    m_profile.reset();
-    Timer step_timer;
-    Timer broad_timer;
-    Timer pairs_timer;
-    Timer AABB_timer;
-    Timer response_timer;
-    Timer walls_timer;
+    m_counters = Counters();
+    narrow_phase_stats().reset();
+    const uint64_t allocations(allocation_count());
 
-#ifdef SWEEP_AND_PRUNE
-    pairs_timer.reset();
-    // m_sap.choose_axis();
-    const auto pairs(m_sap.process());
-    m_profile.pairs = pairs_timer.get_microseconds();
-    m_profile.broad_phase = m_profile.pairs;
-#endif
-
-    destroy_contacts();
-    destroy_proxys();
+    {
+        PROFILE_ZONE("step");
 
-    for (int i(0); i < substeps; ++i) {
-        apply_forces();
-        for (auto spring : m_springs) {
-            spring->apply(dt);
-        }
-        for (auto body : m_bodies) {
-            if (body->is_enabled()) {
-                Timer ode_timer;
-                body->step(dt / substeps);
-                // body->update_bounding_box();
-                m_profile.ode += ode_timer.get_microseconds();
+#ifdef SWEEP_AND_PRUNE
+        std::vector<BodyPair>& pairs(m_pairs);
+        {
+            PROFILE_ZONE("broad_phase");
+            if (m_broad_phase_type == BROAD_PHASE_AUTO && m_bodies_changed) {
+                use_broad_phase(choose_broad_phase(m_bodies));
+                m_bodies_changed = 0;
             }
-        }
 
-        for (auto& pair : pairs) {
-            RigidBody* a(pair[0]);
-            RigidBody* b(pair[1]);
+            pair_bodies(dt, 1);
+        }
+#endif
 
-            if (a->get_type() == STATIC && b->get_type() == STATIC) {
-                continue;
-            }
+        if (cost_attribution_enabled) {
+            m_costs.begin_step(pairs);
+        }
 
-            AABB_timer.reset();
-            const Shape* shape_a(a->get_shape());
-            const Shape* shape_b(b->get_shape());
-            bool broad_overlap(AABB_overlap(shape_a->get_aabb(), shape_b->get_aabb()));
-            m_profile.AABBs += AABB_timer.get_microseconds();
-            m_profile.broad_phase += AABB_timer.get_microseconds();
+        // The contacts and proxies of the previous step were kept for rendering
+        destroy_contacts();
+        destroy_proxys();
+        m_arena.reset();
 
-            if (broad_overlap) {
+        for (int i(0); i < substeps; ++i) {
+            PROFILE_ZONE("substep");
 
-                Timer narrow_phase_timer;
-                Manifold collision(collide(a, b));
-                m_profile.narrow_phase += narrow_phase_timer.get_microseconds();
+            {
+                PROFILE_ZONE("forces");
+                apply_forces();
+                for (auto spring : m_springs) {
+                    spring->apply(dt);
+                }
+            }
 
-                if (collision.intersecting) {
-                    if (i < 2) {
-                        m_contacts.push_back(new Manifold(collision));
+            {
+                PROFILE_ZONE("integration");
+                for (auto body : m_bodies) {
+                    if (body->is_enabled()) {
+                        body->step(dt / substeps);
+                        // body->update_bounding_box();
                     }
+                }
+            }
 
-                    response_timer.reset();
-                    if (!a->is_dynamic()) {
-                        b->move(collision.normal * collision.depth);
-                    }else if (!b->is_dynamic()) {
-                        a->move(-collision.normal * collision.depth);
-                    }else {
-                        a->move(-collision.normal * collision.depth * 0.5);
-                        b->move(collision.normal * collision.depth * 0.5);
+#ifdef SWEEP_AND_PRUNE
+            {
+                // The pairs hold as long as the bodies stay within their swept boxes. Contacts
+                // and springs move the bodies by more than any margin may bound, those that left
+                // their box are swept again and paired for the rest of the frame.
+                PROFILE_ZONE("sweep_check");
+                bool left(0);
+                for (auto body : m_bodies) {
+                    if (body->is_enabled() && body->left_sweep()) {
+                        left = 1;
+                        break;
                     }
-                    solve_collision(a, b, collision);
-                    m_profile.response_phase += response_timer.get_microseconds();
-
-                    if (settings.highlight_collisions) {
-                        a->colorize({0, 128, 255, 255});
-                        b->colorize({0, 255, 128, 255});
+                }
+                if (left) {
+                    PROFILE_ZONE("broad_phase");
+                    pair_bodies(dt, 0);
+                    if (cost_attribution_enabled) {
+                        m_costs.rebase(pairs);
                     }
-                }else if (i > substeps - 2) {
-                    m_proxys.push_back(new DistanceInfo(ditance_convex(shape_a, shape_b)));
                 }
-            }            
-        }
-
-        walls_timer.reset();
-        if (walls_enabled) {
-            for (auto body : m_bodies) {
-                body->handle_wall_collisions();
             }
-            m_profile.walls += walls_timer.get_microseconds();
-        }
-    }
-
-    // m_profile.average((double)steps);
-    m_profile.step = step_timer.get_microseconds();
-}
-
-void World::render(SDL_Renderer* renderer, bool running, Settings& settings) {
-    // Draw world boundaries
-    if (walls_enabled) {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 127);
-        render_line(renderer, {0, SCENE_HEIGHT}, {0, 0});
-        render_line(renderer, {0, 0}, {SCENE_WIDTH, 0});
-        render_line(renderer, {SCENE_WIDTH, 0}, {SCENE_WIDTH, SCENE_HEIGHT});
-        render_line(renderer, {SCENE_WIDTH, SCENE_HEIGHT}, {0, SCENE_HEIGHT});
-    }
-
-    if (body_count > 0 && focus >= 0) {
-        m_bodies[focus]->colorize(focus_color);
-        if (settings.draw_body_trajectory) {
-            m_bodies[focus]->draw_trail(renderer, running);
-        }
-    }
-    for (auto id : m_trail_register_id) {
-        if (id == focus) {
-            continue;
-        }
-        RigidBody* body(get_body(id));
-        if (body) {
-            body->draw_trail(renderer, running);
-        }
-    }
-
-    for (auto& body : m_bodies) {
-        body->draw(renderer);
-        body->reset_color();
-    }
-
-    if (settings.draw_center_of_mass) {
-        for (auto body :m_bodies) {
-            body->draw_com(renderer);
-        }
-    }
+#endif
 
-    if (settings.draw_bounding_boxes) {
-        SDL_SetRenderDrawColor(renderer, 178, 102, 255, 255);
-        for (auto body : m_bodies) {
-            body->draw_bounding_box(renderer);
-        }
-    }
+            {
+                // Self time: AABB overlap tests of the broad phase pairs
+                PROFILE_ZONE("collisions");
+                for (size_t k(0); k < pairs.size(); ++k) {
+                    RigidBody* a(pairs[k][0]);
+                    RigidBody* b(pairs[k][1]);
+
+                    const Shape* shape_a(a->get_shape());
+                    const Shape* shape_b(b->get_shape());
+
+                    ++m_counters.aabb_tests;
+                    if (AABB_overlap(shape_a->get_aabb(), shape_b->get_aabb())) {
+                        ++m_counters.aabb_overlaps;
+
+                        uint64_t start(0);
+                        NarrowPhaseStats before;
+                        if (cost_attribution_enabled) {
+                            before = narrow_phase_stats();
+                            start = profiler_ticks();
+                        }
+
+                        Manifold collision(collide(a, b));
+
+                        if (collision.intersecting) {
+                            ++m_counters.collisions;
+                            m_counters.contacts += collision.count;
+                            if (i < 2) {
+                                m_contacts.push_back(m_arena.create<Manifold>(collision));
+                            }
+
+                            PROFILE_ZONE("response");
+                            if (!a->is_dynamic()) {
+                                b->move(collision.normal * collision.depth);
+                            }else if (!b->is_dynamic()) {
+                                a->move(-collision.normal * collision.depth);
+                            }else {
+                                a->move(-collision.normal * collision.depth * 0.5);
+                                b->move(collision.normal * collision.depth * 0.5);
+                            }
+                            solve_collision(a, b, collision);
+
+                            if (settings.highlight_collisions) {
+                                a->colorize({0, 128, 255, 255});
+                                b->colorize({0, 255, 128, 255});
+                            }
+                        }else if (i > substeps - 2) {
+                            PROFILE_ZONE("distance");
+                            m_proxys.push_back(m_arena.create<DistanceInfo>(ditance_convex(shape_a, shape_b, &simplex_cache(a, b))));
+                        }
+
+                        if (cost_attribution_enabled) {
+                            const NarrowPhaseStats& after(narrow_phase_stats());
+                            m_costs.add(k, profiler_ticks() - start, before, after);
+                        }
+                    }
+                }
+            }
 
-    if (settings.draw_contact_points) {
-        SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
-        for (auto contact : m_contacts) {
-            for (unsigned i(0); i < contact->count; ++i) {
-                const auto point(contact->contact_points[i]);
-                render_circle_fill_raster(renderer, point, 3.5 / RENDER_SCALE);
+            if (walls_enabled) {
+                PROFILE_ZONE("walls");
+                for (auto body : m_bodies) {
+                    m_counters.wall_hits += body->handle_wall_collisions(m_scene_width, m_scene_height);
+                }
             }
         }
-    }
 
-    if (settings.draw_collision_normal) {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 0, 255);
-        for (auto contact : m_contacts) {
-            for (unsigned i(0); i < contact->count; ++i) {
-                const auto point(contact->contact_points[i]);
-                render_line(renderer, point, point + contact->normal / RENDER_SCALE * 20);
+        // The pairs without a proxy this step start cold the next time
+        m_simplex_caches.swap(m_next_simplex_caches);
+        m_next_simplex_caches.clear();
+        std::sort(m_simplex_caches.begin(), m_simplex_caches.end(),
+                  [](const PairSimplex& x, const PairSimplex& y) { return x.key < y.key; });
+
+        if (cost_attribution_enabled) {
+            m_costs.end_step();
+            if (settings.highlight_expensive) {
+                for (const auto& cost : m_costs.get_last_pairs()) {
+                    for (unsigned id : {cost.id_a, cost.id_b}) {
+                        RigidBody* body(get_body(id));
+                        if (body) {
+                            body->colorize(expensive_color);
+                        }
+                    }
+                }
             }
         }
     }
 
-    if (settings.draw_distance_proxys) {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-        for (auto prox : m_proxys) {
-            render_line(renderer, prox->points.closest_a, prox->points.closest_b);
-        }
-    }
+    m_counters.narrow_phase = narrow_phase_stats();
+    m_counters.allocations = allocation_count() - allocations;
+    m_broad_phase_stale = 1;
 
-    for (auto spring : m_springs) {
-        spring->draw(renderer);
-    }
+    PROFILE_END_FRAME();
 }
 
 RigidBody* World::add_body(const RigidBodyDef& body_def, const Shape& shape) {
@@ -214,7 +221,12 @@ RigidBody* World::add_body(const RigidBodyDef& body_def, const Shape& shape) {
     body = new RigidBody(body_def, shape, body_count);
 
     m_bodies.push_back(body);
-    m_sap.update_list(m_bodies);
+    m_broad_phase->add_body(body);
+    m_bodies_changed = 1;
+    m_broad_phase_stale = 1;
+    if (!body->is_enabled()) {
+        m_disabled.push_back(body);
+    }
     ++body_count;
 
     return body;
@@ -225,33 +237,33 @@ RigidBody* World::add_body(const RigidBodyDef& body_def, Shape* shape) {
     body = new RigidBody(body_def, shape, body_count);
 
     m_bodies.push_back(body);
-    m_sap.update_list(m_bodies);
+    m_broad_phase->add_body(body);
+    m_bodies_changed = 1;
+    m_broad_phase_stale = 1;
+    if (!body->is_enabled()) {
+        m_disabled.push_back(body);
+    }
     ++body_count;
 
     return body;
 }
 
 void World::add_spring(Vector2 p1, Vector2 p2, Spring::DampingType damping, float stiffness) {
-    RigidBody* a(nullptr);
-    RigidBody* b(nullptr);
-    for (auto body : m_bodies) {
-        if (body->get_shape()->contains_point(p1)) {
-            a = body;
-            continue;
-        }
-        if (body->get_shape()->contains_point(p2)) {
-            b = body;
-            continue;
-        }
-        if (a && b) {
-            break;
-        }
+    query_point(p1, m_candidates);
+    if (m_candidates.empty()) {
+        return;
     }
-    if (a && b) {
-        if ((a->is_dynamic() || b->is_dynamic()) && (a->is_enabled() || b->is_enabled())) {
-            const double rest_length((a->get_p() - b->get_p()).norm());
-            m_springs.push_back(new Spring(a, b, rest_length, stiffness, damping));
-        }
+    RigidBody* a(m_candidates.front());
+    query_point(p2, m_candidates);
+    auto it(std::find_if(m_candidates.begin(), m_candidates.end(),
+                         [a](const RigidBody* body) { return body != a; }));
+    if (it == m_candidates.end()) {
+        return;
+    }
+    RigidBody* b(*it);
+    if ((a->is_dynamic() || b->is_dynamic()) && (a->is_enabled() || b->is_enabled())) {
+        const double rest_length((a->get_p() - b->get_p()).norm());
+        m_springs.push_back(new Spring(a, b, rest_length, stiffness, damping));
     }
 }
 
@@ -259,6 +271,11 @@ void World::add_force_field(const Vector2 field) {
     m_force_fields.push_back(field);
 }
 
+void World::update_body(RigidBody* body) {
+    m_broad_phase->update_body(body);
+    m_broad_phase_stale = 1;
+}
+
 void World::destroy_body(RigidBody* body) {
     if (!body || body_count == 0) {
         return;
@@ -274,13 +291,19 @@ void World::destroy_body(RigidBody* body) {
 
     if (idx >= 0) {
         set_body_trail(body->get_id(), false);
+        m_broad_phase->remove_body(body);
+        m_bodies_changed = 1;
+        m_broad_phase_stale = 1;
+        auto it(std::find(m_disabled.begin(), m_disabled.end(), body));
+        if (it != m_disabled.end()) {
+            m_disabled.erase(it);
+        }
         delete body;
         m_bodies.erase(m_bodies.begin() + idx);
         --body_count;
         if (idx <= focus && focus > 0) {
             --focus;
         }
-        m_sap.update_list(m_bodies);
     }
 }
 
@@ -289,39 +312,151 @@ void World::destroy_all() {
         delete body;
     }
     m_bodies.clear();
+    m_disabled.clear();
     body_count = 0;
     focus = -1;
     m_trail_register_id.clear();
 
     destroy_contacts();
     destroy_proxys();
+    // The ids are given again from 0
+    m_simplex_caches.clear();
 
     for (auto spring : m_springs) {
         delete spring;
     }
     m_springs.clear();
 
-    m_sap.update_list(m_bodies);
+    m_broad_phase->clear();
+    m_bodies_changed = 1;
+    m_broad_phase_stale = 1;
+}
+
+void World::set_broad_phase(const BroadPhaseType type) {
+    if (type == m_broad_phase_type) {
+        return;
+    }
+
+    m_broad_phase_type = type;
+    if (type == BROAD_PHASE_AUTO) {
+        use_broad_phase(choose_broad_phase(m_bodies));
+        m_bodies_changed = 0;
+    }else {
+        use_broad_phase(type);
+    }
+}
+
+void World::use_broad_phase(const BroadPhaseType type) {
+    if (type == m_active_broad_phase) {
+        return;
+    }
+
+    // The previous broad phase lets go of the bodies, it would not follow their removal
+    m_broad_phase->clear();
+    m_active_broad_phase = type;
+    switch (type) {
+        case BROAD_PHASE_TREE:
+            m_broad_phase = &m_tree;
+            break;
+        case BROAD_PHASE_INCREMENTAL_SAP:
+            m_broad_phase = &m_incremental_sap;
+            break;
+        case BROAD_PHASE_SPATIAL_HASH:
+            m_broad_phase = &m_spatial_hash;
+            break;
+        case BROAD_PHASE_HIERARCHICAL_GRID:
+            m_broad_phase = &m_hierarchical_grid;
+            break;
+        default:
+            m_broad_phase = &m_sap;
+            break;
+    }
+    for (auto body : m_bodies) {
+        m_broad_phase->add_body(body);
+    }
+    m_broad_phase_stale = 1;
+}
+
+void World::gather_candidates(const AABB& aabb, std::vector<RigidBody*>& bodies) {
+    if (m_broad_phase_stale) {
+        m_broad_phase->update();
+        m_broad_phase_stale = 0;
+    }
+    bodies.clear();
+    m_broad_phase->query(aabb, bodies);
+    bodies.insert(bodies.end(), m_disabled.begin(), m_disabled.end());
+}
+
+void World::query_aabb(const AABB& aabb, std::vector<RigidBody*>& bodies) {
+    gather_candidates(aabb, bodies);
+    // The broad phases may return a superset, with enlarged or rounded boxes
+    bodies.erase(std::remove_if(bodies.begin(), bodies.end(), [&aabb](const RigidBody* body) {
+        return !AABB_overlap(body->get_shape()->get_aabb(), aabb);
+    }), bodies.end());
+    std::sort(bodies.begin(), bodies.end(), [](const RigidBody* a, const RigidBody* b) { return a->get_id() < b->get_id(); });
+}
+
+void World::query_point(const Vector2 p, std::vector<RigidBody*>& bodies) {
+    gather_candidates({p, p}, bodies);
+    bodies.erase(std::remove_if(bodies.begin(), bodies.end(), [p](const RigidBody* body) {
+        return !body->get_shape()->contains_point(p);
+    }), bodies.end());
+    std::sort(bodies.begin(), bodies.end(), [](const RigidBody* a, const RigidBody* b) { return a->get_id() < b->get_id(); });
+}
+
+bool World::raycast(const Vector2 p1, const Vector2 p2, CastHit& hit) {
+    const AABB aabb{{std::min(p1.x, p2.x), std::min(p1.y, p2.y)}, {std::max(p1.x, p2.x), std::max(p1.y, p2.y)}};
+    gather_candidates(aabb, m_candidates);
+
+    hit.body = nullptr;
+    CastOutput output;
+    for (auto body : m_candidates) {
+        if (::raycast(body->get_shape(), p1, p2, output) && (!hit.body || output.fraction < hit.fraction)) {
+            hit = {body, output.point, output.normal, output.fraction};
+        }
+    }
+    return hit.body;
+}
+
+void World::raycast_all(const Vector2 p1, const Vector2 p2, std::vector<CastHit>& hits) {
+    const AABB aabb{{std::min(p1.x, p2.x), std::min(p1.y, p2.y)}, {std::max(p1.x, p2.x), std::max(p1.y, p2.y)}};
+    gather_candidates(aabb, m_candidates);
+
+    hits.clear();
+    CastOutput output;
+    for (auto body : m_candidates) {
+        if (::raycast(body->get_shape(), p1, p2, output)) {
+            hits.push_back({body, output.point, output.normal, output.fraction});
+        }
+    }
+    std::sort(hits.begin(), hits.end(), [](const CastHit& a, const CastHit& b) { return a.fraction < b.fraction; });
+}
+
+bool World::shape_cast(const Shape& shape, const Vector2 translation, CastHit& hit) {
+    // Bounds of the swept shape, from its support points rather than its AABB,
+    // which the shape only updates when transformed
+    AABB aabb{{support(&shape, -vector2_x).x, support(&shape, -vector2_y).y},
+              {support(&shape, vector2_x).x, support(&shape, vector2_y).y}};
+    aabb.min += {std::min(translation.x, 0.0), std::min(translation.y, 0.0)};
+    aabb.max += {std::max(translation.x, 0.0), std::max(translation.y, 0.0)};
+    gather_candidates(aabb, m_candidates);
+
+    hit.body = nullptr;
+    CastOutput output;
+    for (auto body : m_candidates) {
+        if (::shape_cast(&shape, translation, body->get_shape(), output) && (!hit.body || output.fraction < hit.fraction)) {
+            hit = {body, output.point, output.normal, output.fraction};
+        }
+    }
+    return hit.body;
 }
 
 std::string World::dump_profile() const {
-    std::string perf;
-    perf += ("Time per step : " + truncate_to_string(m_profile.step / 1e3) + " ms\n")
-          + ("ODE solve time : " + truncate_to_string(m_profile.ode / 1e3) + " ms\n")
-          + ("Collisions time : " + truncate_to_string(m_profile.collisions / 1e3) + " ms\n")
-          + ("  > Broad phase : " + truncate_to_string(m_profile.broad_phase / 1e3) + " ms\n")
-          + ("    > Pairs : " + truncate_to_string(m_profile.pairs / 1e3) + " ms\n")
-          + ("    > AABBs : " + truncate_to_string(m_profile.AABBs / 1e3) + " ms\n")
-          + ("  > Narrow phase : " + truncate_to_string(m_profile.narrow_phase / 1e3) + " ms\n")
-#ifdef GJK_EPA
-          + ("    > GJK : " + truncate_to_string(m_profile.gjk_collide / 1e3) + " ms\n")
-          + ("    > EPA : " + truncate_to_string(m_profile.epa / 1e3) + " ms\n")
+#ifdef PROFILER
+    return profiler().dump();
+#else
+    return "Profiler disabled (see PROFILER in config.h)\n";
 #endif
-          + ("    > Clip : " + truncate_to_string(m_profile.clip / 1e3) + " ms\n")
-          + ("  > Response phase : " + truncate_to_string(m_profile.response_phase / 1e3) + " ms\n")
-          + ("Walls : " + truncate_to_string(m_profile.walls / 1e3) + " ms\n");
-
-    return perf;
 }
 
 std::string World::dump_body(const unsigned id) const {
@@ -383,12 +518,13 @@ bool World::focus_on_position(Vector2 p) {
         m_bodies[focus]->reset_color();
     }
     const int previous_focus(focus);
-    for (size_t i(0); i < body_count; ++i) {
-        if (m_bodies[i]->get_shape()->contains_point(p)) {
-            focus = i;
-            m_bodies[i]->colorize(focus_color);
-            break;
-        }
+
+    // The first body added under the point
+    query_point(p, m_candidates);
+    if (!m_candidates.empty()) {
+        RigidBody* body(m_candidates.front());
+        focus = std::find(m_bodies.begin(), m_bodies.end(), body) - m_bodies.begin();
+        body->colorize(focus_color);
     }
 
     return previous_focus != focus;
@@ -461,20 +597,16 @@ RigidBody* World::get_body(const unsigned id) const {
 }
 
 Spring* World::get_spring_from_mouse(Vector2 p) {
+    const double w(0.125); // 20 pixels wide hitbox
     for (auto spring : m_springs) {
-        const Vector2 axis(spring->get_axis());
-        const Vector2 n(axis.normal());
+        // Distance from the point to the segment of the spring
         const Vector2 p1(spring->get_anchor());
-        const Vector2 p2(p1 - axis);
-        const double w(0.125); // 20 pixels wide hitbox
-        Vertices points = {
-            p1 - n * w,
-            p2 - n * w,
-            p2 + n * w,
-            p1 + n * w
-        };
-        Polygon hitbox({points, 4});
-        if (hitbox.contains_point(p)) {
+        const Vector2 axis(-spring->get_axis());
+        const double length2(dot2(axis, axis));
+        double t(length2 > 0 ? dot2(p - p1, axis) / length2 : 0);
+        t = std::clamp(t, 0.0, 1.0);
+        const Vector2 d(p - (p1 + axis * t));
+        if (dot2(d, d) <= w * w) {
             return spring;
         }
     }
@@ -506,54 +638,52 @@ void World::apply_forces() {
     }
 }
 
-Manifold World::collide(RigidBody* body_a, RigidBody* body_b) {
-    Manifold result;
+void World::pair_bodies(const double duration, const bool all) {
+    // The margin bounds the displacement due to gravity and the force fields
+    double acceleration(std::abs(m_gravity));
+    for (auto field : m_force_fields) {
+        acceleration += field.norm();
+    }
+    const double margin(acceleration * duration * duration + swept_aabb_margin);
+    for (auto body : m_bodies) {
+        if (all || body->left_sweep()) {
+            body->sweep(duration, margin);
+        }
+    }
+    m_broad_phase->process(m_pairs);
+    m_pair_sorter.sort(m_pairs);
+    m_counters.broad_phase_pairs = m_pairs.size();
+    ++m_counters.broad_phase_runs;
+}
 
+Manifold World::collide(RigidBody* body_a, RigidBody* body_b) {
     Shape* shape_a(body_a->get_shape());
     Shape* shape_b(body_b->get_shape());
-    const ShapeType shape_type_a(shape_a->get_type());
-    const ShapeType shape_type_b(shape_b->get_type());
-
-    if (shape_type_a == POLYGON || shape_type_b == POLYGON) {
-        Timer gjk, epa, clip;
+    const CollideKernel& kernel(get_collide_kernel(shape_a->get_type(), shape_b->get_type()));
 
-        result = collide_convex(shape_a, shape_b, gjk, epa, clip);
-
-        m_profile.gjk_collide += gjk.get_microseconds();
-        m_profile.epa += epa.get_microseconds();
-        m_profile.clip += clip.get_microseconds();
-    }else {
-        result = collide_circle_circle(shape_a, shape_b);
-    }
+    PROFILE_ZONE("narrow_phase");
+    PROFILE_ZONE(kernel.name);
+    return kernel.collide(shape_a, shape_b);
+}
 
-    return result;
+SimplexCache& World::simplex_cache(RigidBody* body_a, RigidBody* body_b) {
+    const uint64_t key((uint64_t)body_a->get_id() << 32 | body_b->get_id());
+    auto it(std::lower_bound(m_simplex_caches.begin(), m_simplex_caches.end(), key,
+                             [](const PairSimplex& pair, const uint64_t k) { return pair.key < k; }));
+    PairSimplex pair;
+    pair.key = key;
+    if (it != m_simplex_caches.end() && it->key == key) {
+        pair.cache = it->cache;
+    }
+    m_next_simplex_caches.push_back(pair);
+    return m_next_simplex_caches.back().cache;
 }
 
+// Contacts and proxies live in the frame arena, only the lists are cleared
 void World::destroy_contacts() {
-    for (auto contact : m_contacts) {
-        delete contact;
-    }
     m_contacts.clear();
 }
 
 void World::destroy_proxys() {
-    for (auto prox : m_proxys) {
-        delete prox;
-    }
     m_proxys.clear();
 }
-
-void World::Profile::reset() {
-    this->step = 0;
-    this->ode = 0;
-    this->collisions = 0;
-    this->broad_phase = 0;
-    this->pairs = 0;
-    this->AABBs = 0;
-    this->narrow_phase = 0;
-    this->gjk_collide = 0;
-    this->epa = 0;
-    this->clip = 0;
-    this->response_phase = 0;
-    this->walls = 0;
-}
@@ -2,15 +2,24 @@
 #define WORLD_H
 
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <array>
 #include <string>
-#include "broad_phase.h" // SweepAndPrune
+#include "broad_phase.h" // SweepAndPrune, BroadPhaseType
 #include "config.h"
+#include "cost_attribution.h"
+#include "dynamic_tree.h"
+#include "frame_arena.h"
+#include "hierarchical_grid.h"
+#include "incremental_sap.h"
 #include "link.h"        // Spring::DampingType
+#include "narrow_phase.h" // NarrowPhaseStats
 #include "rigid_body.h"
+#include "spatial_hash.h"
 #include "vector2.h"
 
+struct SDL_Renderer;
 struct Settings;
 struct DistanceInfo;
 struct Manifold;
@@ -19,10 +28,32 @@ class Shape;
 
 class World {
 public:
+    // Engine counters of the last step, summed over its substeps
+    struct Counters {
+        unsigned broad_phase_pairs = 0; // Candidate pairs from the last broad phase pass
+        unsigned broad_phase_runs = 0;  // Passes, more than one when bodies left their swept boxes
+        unsigned aabb_tests = 0;        // Candidate pairs tested with AABB_overlap
+        unsigned aabb_overlaps = 0;     // Pairs passed to the narrow phase
+        unsigned collisions = 0;        // Intersecting pairs
+        unsigned contacts = 0;          // Contact points solved
+        unsigned wall_hits = 0;
+        uint64_t allocations = 0;       // Heap allocations during the step (see allocation_counter.h)
+        NarrowPhaseStats narrow_phase;  // GJK/EPA iterations, polytope size, clip outcomes
+    };
+
+    // Hit of a ray or shape cast
+    struct CastHit {
+        RigidBody* body = nullptr;
+        Vector2 point;
+        Vector2 normal;         // Surface normal of the body, against the cast
+        double fraction = 0;    // Of the ray or translation covered at the hit
+    };
+
     World();
     virtual ~World();
 
     void step(double dt, int steps, Settings& settings, bool perft = false);
+    // Rendering, only defined by the demo application (see draw.cc)
     void render(SDL_Renderer* renderer, bool running, Settings& settings);
 
     RigidBody* add_body(const RigidBodyDef& body_def, const Shape& shape);
@@ -30,9 +61,27 @@ public:
     void add_spring(Vector2 p1, Vector2 p2, Spring::DampingType damping, float stiffness);
     void add_force_field(const Vector2 field);
 
+    /**
+     * @brief To be called after changing the type of a body, or moving a body outside of step
+     */
+    void update_body(RigidBody* body);
     void destroy_body(RigidBody* body);
     void destroy_all();
     
+    /**
+     * @brief Spatial queries, accelerated by the broad phase in use.
+     * The output vectors are cleared first, the bodies come in the order they were added.
+     * The disabled bodies, left out of the broad phase, are tested one by one.
+     */
+    void query_aabb(const AABB& aabb, std::vector<RigidBody*>& bodies);
+    void query_point(const Vector2 p, std::vector<RigidBody*>& bodies);
+    // Closest body hit by the segment from p1 to p2
+    bool raycast(const Vector2 p1, const Vector2 p2, CastHit& hit);
+    // Every body hit by the segment, sorted by fraction
+    void raycast_all(const Vector2 p1, const Vector2 p2, std::vector<CastHit>& hits);
+    // First body hit by the shape, placed at its start, moving along the translation
+    bool shape_cast(const Shape& shape, const Vector2 translation, CastHit& hit);
+
     std::string dump_profile() const;
     std::string dump_body(const unsigned id) const;
     double total_energy() const;
@@ -53,50 +102,85 @@ public:
     Spring* get_spring_at(const size_t index) const;
 
     inline unsigned get_body_count() const { return body_count; }
+    inline const Counters& get_counters() const { return m_counters; }
+    inline const FrameArena& get_frame_arena() const { return m_arena; }
+    void set_broad_phase(const BroadPhaseType type);
+    inline BroadPhaseType get_broad_phase() const { return m_broad_phase_type; }
+    // The broad phase in use, never BROAD_PHASE_AUTO
+    inline BroadPhaseType get_active_broad_phase() const { return m_active_broad_phase; }
+    inline const DynamicTree& get_tree() const { return m_tree; }
+    inline const IncrementalSweepAndPrune& get_incremental_sap() const { return m_incremental_sap; }
+    inline const SpatialHash& get_spatial_hash() const { return m_spatial_hash; }
+    inline const HierarchicalGrid& get_hierarchical_grid() const { return m_hierarchical_grid; }
+    // Optional per pair timing of the narrow phase and response (see cost_attribution.h)
+    inline void enable_cost_attribution(const bool enable) { cost_attribution_enabled = enable; }
+    inline bool is_cost_attribution_enabled() const { return cost_attribution_enabled; }
+    inline CostAttribution& get_cost_attribution() { return m_costs; }
     inline void set_gravity(const double gravity = g) { m_gravity = gravity; }
     inline double get_gravity() const { return m_gravity; }
     inline void enable_walls() { walls_enabled = 1; }
     inline void disable_walls() { walls_enabled = 0; }
+    inline void set_scene_size(const double width, const double height) { m_scene_width = width; m_scene_height = height; }
+    inline double get_scene_width() const { return m_scene_width; }
+    inline double get_scene_height() const { return m_scene_height; }
     
 private:
-    // Struct to store performance metrics
-    struct Profile {
-        double step;
-        double ode;
-        double collisions;
-        double broad_phase;
-        double pairs;
-        double AABBs;
-        double narrow_phase;
-        double gjk_collide;
-        double epa;
-        double clip;
-        double response_phase;
-        double walls;
-
-        void reset();
-    };
-
     double m_gravity;
+    double m_scene_width;
+    double m_scene_height;
     bool walls_enabled;
     bool air_friction_enabled;
 
     std::vector<RigidBody*> m_bodies;
+    std::vector<RigidBody*> m_disabled; // Not in the broad phases
     unsigned body_count;
     int focus;
     std::vector<unsigned> m_trail_register_id;
 
-    std::vector<Manifold*> m_contacts;
+    std::vector<BodyPair> m_pairs;      // Broad phase output, kept for its capacity
+    PairSorter m_pair_sorter;           // Same order of the pairs whatever the broad phase
+    FrameArena m_arena;                 // Temporaries of a step, of this world only
+    std::vector<Manifold*> m_contacts;  // In m_arena, until the next step
     std::vector<DistanceInfo*> m_proxys;
+    // Last GJK simplex of the pairs given a proxy, keyed by the ids of their bodies in pair order
+    struct PairSimplex {
+        uint64_t key;
+        SimplexCache cache;
+    };
+    std::vector<PairSimplex> m_simplex_caches;      // Sorted by key, from the previous step
+    std::vector<PairSimplex> m_next_simplex_caches; // Of this step, kept for its capacity
 
     std::vector<Spring*> m_springs;
     std::vector<Vector2> m_force_fields;
     // std::vector<Constraint*> m_constraints;
     SweepAndPrune m_sap;
-    Profile m_profile;
+    DynamicTree m_tree;
+    IncrementalSweepAndPrune m_incremental_sap;
+    SpatialHash m_spatial_hash;
+    HierarchicalGrid m_hierarchical_grid;
+    BroadPhase* m_broad_phase;      // One of the above, the only one kept up to date
+    BroadPhaseType m_broad_phase_type;
+    BroadPhaseType m_active_broad_phase;
+    bool m_bodies_changed;          // Since the last choice of BROAD_PHASE_AUTO
+    bool m_broad_phase_stale;       // Bodies moved or changed since the last broad phase update
+    std::vector<RigidBody*> m_candidates;   // Scratch buffer of the queries
+    Counters m_counters;
+    bool cost_attribution_enabled;
+    CostAttribution m_costs;
     
+    void use_broad_phase(const BroadPhaseType type);
+    // Candidates of a query, from the broad phase and the disabled bodies
+    void gather_candidates(const AABB& aabb, std::vector<RigidBody*>& bodies);
     void apply_forces();
+    /**
+     * @brief Sweeps the bounding boxes of the bodies over the duration and runs the broad
+     * phase on them, into m_pairs sorted by body ids
+     * @param all Whether to sweep all the bodies or only those that left their box
+     */
+    void pair_bodies(const double duration, const bool all);
     Manifold collide(RigidBody* body_a, RigidBody* body_b);
+    // Cache of the pair for this step, started from the one of the previous step if any
+    SimplexCache& simplex_cache(RigidBody* body_a, RigidBody* body_b);
 
     void destroy_contacts();
     void destroy_proxys();
@@ -0,0 +1,268 @@
+// Headless batch runner: steps a scene as fast as possible, without window nor renderer
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "profiler.h"
+#include "scenes.h"
+#include "settings.h"
+#include "utils.h"
+#include "world.h"
+#include "config.h"
+
+namespace {
+    struct Options {
+        std::string scene = "stacking";
+        std::string scene_file;
+        unsigned frames = 1000;
+        double dt = 1.0 / 60.0;
+        int substeps = 20;
+        unsigned seed = 0;
+        std::string trace;
+        bool costs = false;
+        BroadPhaseType broad_phase = BROAD_PHASE_SAP;
+    };
+
+    void print_usage(const char* program) {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "  --scene <name>      Demo scene to run (default: stacking)\n"
+                  << "  --file <path>       Load the scene from a scene file instead\n"
+                  << "  --frames <n>        Number of World::step calls (default: 1000)\n"
+                  << "  --dt <seconds>      Time step of a frame (default: 1/60)\n"
+                  << "  --substeps <n>      Substeps per frame (default: 20)\n"
+                  << "  --seed <n>          Seed of the scene random generator (default: 0)\n"
+                  << "  --trace <path>      Record the profiled zones and write them as a Chrome trace\n"
+                  << "  --costs             Print the most expensive body pairs and bodies\n"
+                  << "  --broad-phase <name> Broad phase: sap (default), tree,\n"
+                  << "                      incremental_sap, spatial_hash,\n"
+                  << "                      hierarchical_grid or auto\n"
+                  << "  --list              List the available demo scenes\n";
+    }
+
+    /**
+     * @brief Parses the command line arguments
+     * @return 0 to proceed, 1 on error, -1 when the program should exit successfully
+     */
+    int parse_options(int argc, char* argv[], Options& options) {
+        for (int i(1); i < argc; ++i) {
+            const std::string arg(argv[i]);
+            const bool has_value(i + 1 < argc);
+
+            if (arg == "--help" || arg == "-h") {
+                print_usage(argv[0]);
+                return -1;
+            }else if (arg == "--list") {
+                for (const auto& entry : get_scenes()) {
+                    std::cout << entry.name << "\n";
+                }
+                return -1;
+            }else if (arg == "--scene" && has_value) {
+                options.scene = argv[++i];
+            }else if (arg == "--file" && has_value) {
+                options.scene_file = argv[++i];
+            }else if (arg == "--frames" && has_value) {
+                options.frames = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--dt" && has_value) {
+                options.dt = std::strtod(argv[++i], nullptr);
+            }else if (arg == "--substeps" && has_value) {
+                options.substeps = std::atoi(argv[++i]);
+            }else if (arg == "--seed" && has_value) {
+                options.seed = std::strtoul(argv[++i], nullptr, 10);
+            }else if (arg == "--trace" && has_value) {
+                options.trace = argv[++i];
+            }else if (arg == "--costs") {
+                options.costs = true;
+            }else if (arg == "--broad-phase" && has_value) {
+                const std::string name(argv[++i]);
+                unsigned type(0);
+                while (type < BROAD_PHASE_COUNT && name != broad_phase_names[type]) {
+                    ++type;
+                }
+                if (type == BROAD_PHASE_COUNT) {
+                    std::cerr << "Unknown broad phase: " << name << "\n";
+                    return 1;
+                }
+                options.broad_phase = static_cast<BroadPhaseType>(type);
+            }else {
+                std::cerr << "Unknown or incomplete option: " << arg << "\n";
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (options.frames == 0 || options.dt <= 0 || options.dt > max_time_step
+         || options.substeps < (int)min_substeps || options.substeps > (int)max_substeps) {
+            std::cerr << "Invalid simulation parameters: frames > 0, 0 < dt <= " << max_time_step
+                      << ", " << min_substeps << " <= substeps <= " << max_substeps << "\n";
+            return 1;
+        }
+
+        return 0;
+    }
+
+    double percentile(const std::vector<double>& sorted, const double p) {
+        const size_t index(std::min(sorted.size() - 1, (size_t)(p * sorted.size())));
+        return sorted[index];
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    const int status(parse_options(argc, argv, options));
+    if (status != 0) {
+        return status < 0 ? 0 : status;
+    }
+
+    srand(options.seed);
+
+    World world;
+    Settings settings;
+    if (!options.scene_file.empty()) {
+        if (!load_scene_file(options.scene_file, world, settings)) {
+            return 1;
+        }
+    }else if (!load_scene(options.scene, world, settings)) {
+        std::cerr << "Unknown scene: " << options.scene << " (see --list)\n";
+        return 1;
+    }
+    world.set_gravity(g * settings.enable_gravity);
+    world.enable_cost_attribution(options.costs);
+    world.set_broad_phase(options.broad_phase);
+
+    std::vector<double> step_times;
+    step_times.reserve(options.frames);
+    double body_steps(0);
+    World::Counters totals;
+#ifdef ALLOCATION_COUNTER
+    unsigned allocating_steps(0);
+    int last_allocating_step(-1);
+#endif
+    uint64_t begin_events(0);
+    uint64_t end_events(0);
+    uint64_t swaps(0);
+
+    if (!options.trace.empty() && !profiler().start_trace(options.trace)) {
+        return 1;
+    }
+
+    Timer total_timer;
+    Timer step_timer;
+    for (unsigned i(0); i < options.frames; ++i) {
+        step_timer.reset();
+        world.step(options.dt, options.substeps, settings);
+        step_times.push_back(step_timer.get_microseconds());
+        body_steps += world.get_body_count();
+
+        const World::Counters& counters(world.get_counters());
+        totals.broad_phase_pairs += counters.broad_phase_pairs;
+        totals.broad_phase_runs += counters.broad_phase_runs;
+        totals.aabb_overlaps += counters.aabb_overlaps;
+        totals.contacts += counters.contacts;
+        totals.narrow_phase.gjk_calls += counters.narrow_phase.gjk_calls;
+        totals.narrow_phase.sat_calls += counters.narrow_phase.sat_calls;
+        totals.narrow_phase.clip_two += counters.narrow_phase.clip_two;
+        totals.narrow_phase.clip_one += counters.narrow_phase.clip_one;
+        totals.narrow_phase.clip_failed += counters.narrow_phase.clip_failed;
+        totals.narrow_phase.clip_curved += counters.narrow_phase.clip_curved;
+        totals.narrow_phase.distance_calls += counters.narrow_phase.distance_calls;
+        totals.narrow_phase.distance_iterations += counters.narrow_phase.distance_iterations;
+        totals.narrow_phase.gjk_warm_starts += counters.narrow_phase.gjk_warm_starts;
+#ifdef ALLOCATION_COUNTER
+        totals.allocations += counters.allocations;
+        if (counters.allocations) {
+            ++allocating_steps;
+            last_allocating_step = i;
+        }
+#endif
+
+        if (world.get_active_broad_phase() == BROAD_PHASE_INCREMENTAL_SAP) {
+            const IncrementalSweepAndPrune& sap(world.get_incremental_sap());
+            begin_events += sap.get_begin_events().size();
+            end_events += sap.get_end_events().size();
+            swaps += sap.get_swaps();
+        }
+    }
+    const double total(total_timer.get_seconds());
+
+    if (!options.trace.empty()) {
+        if (!profiler().stop_trace()) {
+            return 1;
+        }
+        const size_t events(profiler().get_trace_size());
+        std::cout << "Trace : " << events << " events written to " << options.trace << "\n";
+    }
+
+    std::sort(step_times.begin(), step_times.end());
+
+    const std::string name(options.scene_file.empty() ? options.scene : options.scene_file);
+    std::cout << "Scene : " << name << "\n"
+              << "Broad phase : " << broad_phase_names[options.broad_phase];
+    if (options.broad_phase == BROAD_PHASE_AUTO) {
+        std::cout << " (" << broad_phase_names[world.get_active_broad_phase()] << ")";
+    }
+    std::cout << "\n"
+              << "Bodies : " << world.get_body_count() << "\n"
+              << "Frames : " << options.frames << " (dt = " << options.dt << " s, "
+              << options.substeps << " substeps)\n"
+              << "Wall time : " << total << " s\n"
+              << "Simulated time : " << options.frames * options.dt << " s ("
+              << options.frames * options.dt / total << "x real time)\n"
+              << "Steps/s : " << options.frames / total << "\n"
+              << "Bodies.steps/s : " << body_steps / total << "\n"
+              << "Step time p50 : " << percentile(step_times, 0.5) << " us\n"
+              << "Step time p99 : " << percentile(step_times, 0.99) << " us\n"
+              << "Broad phase pairs/step : " << (double)totals.broad_phase_pairs / options.frames << "\n"
+              << "Broad phase runs/step : " << (double)totals.broad_phase_runs / options.frames << "\n"
+              << "AABB overlaps/step : " << (double)totals.aabb_overlaps / options.frames << "\n"
+              << "Contacts/step : " << (double)totals.contacts / options.frames << "\n"
+              << "SAT calls/step : " << (double)totals.narrow_phase.sat_calls / options.frames << "\n"
+              << "Clip outcomes/step : " << (double)totals.narrow_phase.clip_two / options.frames << " two, "
+              << (double)totals.narrow_phase.clip_one / options.frames << " one, "
+              << (double)totals.narrow_phase.clip_failed / options.frames << " failed, "
+              << (double)totals.narrow_phase.clip_curved / options.frames << " curved\n"
+              << "Distance iterations/call : " << (double)totals.narrow_phase.distance_iterations
+                                                  / std::max<uint64_t>(1, totals.narrow_phase.distance_calls) << "\n"
+              << "Warm started GJK : " << 100.0 * totals.narrow_phase.gjk_warm_starts
+                                          / std::max<uint64_t>(1, totals.narrow_phase.gjk_calls
+                                                                  + totals.narrow_phase.distance_calls) << " %\n";
+#ifdef ALLOCATION_COUNTER
+    std::cout << "Heap allocations/step : " << (double)totals.allocations / options.frames
+              << " (" << allocating_steps << " steps allocated, last one " << last_allocating_step << ")\n";
+#else
+    std::cout << "Heap allocations/step : not counted (see PHYSICS2D_ALLOCATION_COUNTER)\n";
+#endif
+
+    if (world.get_active_broad_phase() == BROAD_PHASE_INCREMENTAL_SAP) {
+        std::cout << "Overlap events/step : " << (double)begin_events / options.frames << " begin, "
+                  << (double)end_events / options.frames << " end\n"
+                  << "Endpoint swaps/step : " << (double)swaps / options.frames << "\n";
+    }else if (world.get_active_broad_phase() == BROAD_PHASE_SPATIAL_HASH) {
+        const SpatialHash& hash(world.get_spatial_hash());
+        std::cout << "Grid cell size : " << hash.get_cell_size() << " m ("
+                  << hash.get_large_count() << " bodies out of the grid)\n";
+    }else if (world.get_active_broad_phase() == BROAD_PHASE_HIERARCHICAL_GRID) {
+        std::cout << "Grid levels : " << world.get_hierarchical_grid().get_level_count() << "\n";
+    }
+
+    if (options.costs) {
+        const CostAttribution& costs(world.get_cost_attribution());
+        std::cout << "Most expensive pairs (worst step) :\n";
+        for (const auto& cost : costs.get_top_pairs()) {
+            std::cout << "  " << cost.id_a << " - " << cost.id_b
+                      << " (" << cost.vertices_a << "/" << cost.vertices_b << " vertices) : "
+                      << cost.time << " us, " << cost.calls << " calls, " << cost.sat_calls << " SAT, clip "
+                      << cost.clip_two << " two/" << cost.clip_one << " one/" << cost.clip_failed
+                      << " failed, step " << cost.step << "\n";
+        }
+        std::cout << "Most expensive bodies (worst step) :\n";
+        for (const auto& cost : costs.get_top_bodies()) {
+            std::cout << "  " << cost.id << " (" << cost.vertices << " vertices) : " << cost.time
+                      << " us, " << cost.pairs << " pairs, step " << cost.step << "\n";
+        }
+    }
+
+    return 0;
+}